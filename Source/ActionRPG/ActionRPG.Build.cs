@@ -13,7 +13,8 @@ public class ActionRPG : ModuleRules
 			new string[] {
 				"Core",
 				"CoreUObject",
-				"Engine"
+				"Engine",
+				"NetCore"
 			}
 		);
 
@@ -27,7 +28,10 @@ public class ActionRPG : ModuleRules
 				"GameplayAbilities",
 				"GameplayTags",
 				"GameplayTasks",
-				"AIModule"
+				"AIModule",
+				"Json",
+				"HTTP",
+				"HTTPServer"
 			}
 		);
 
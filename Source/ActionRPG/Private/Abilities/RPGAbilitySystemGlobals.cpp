@@ -0,0 +1,39 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "Abilities/RPGAbilitySystemGlobals.h"
+#include "RPGStartupProfiler.h"
+
+void URPGAbilitySystemGlobals::InitGlobalData()
+{
+	RPG_STARTUP_PHASE_SCOPE(GlobalData);
+
+	Super::InitGlobalData();
+}
+
+void URPGAbilitySystemGlobals::InitGlobalTags()
+{
+	RPG_STARTUP_PHASE_SCOPE(GlobalTags);
+
+	Super::InitGlobalTags();
+}
+
+UGameplayCueManager* URPGAbilitySystemGlobals::GetGameplayCueManager()
+{
+	// 只有第一次调用会创建 cue manager 并读取 cue 的路径，之后只是返回
+	// Only the first call creates the cue manager and scans the cue paths, later calls just return it
+	if (GlobalGameplayCueManager == nullptr)
+	{
+		RPG_STARTUP_PHASE_SCOPE(GameplayCueManager);
+
+		return Super::GetGameplayCueManager();
+	}
+
+	return Super::GetGameplayCueManager();
+}
+
+void URPGAbilitySystemGlobals::InitAttributeDefaults()
+{
+	RPG_STARTUP_PHASE_SCOPE(AttributeDefaults);
+
+	Super::InitAttributeDefaults();
+}
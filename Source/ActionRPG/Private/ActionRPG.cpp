@@ -1,8 +1,35 @@
 ﻿// Copyright Epic Games, Inc. All Rights Reserved.
 
 #include "ActionRPG.h"
+#include "ActionRPGLoadingScreen.h"
+#include "RPGStartupProfiler.h"
+#include "ProfilingDebugging/MiscTrace.h"
 
-IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, ActionRPG, "UES_ActionRPG" );
+class FActionRPGModule : public FDefaultGameModuleImpl
+{
+public:
+	virtual void StartupModule() override
+	{
+		FDefaultGameModuleImpl::StartupModule();
+
+		// 模块加载从进程启动开始计算，包括引擎初始化和加载界面模块
+		// Module load counts from process start, covering engine init and the loading screen module
+		FRPGStartupProfiler::RecordPhase(ERPGStartupPhase::ModuleLoad, GStartTime, FPlatformTime::Seconds());
+		TRACE_BOOKMARK(TEXT("RPGStartup ModuleLoad end"));
+
+		// 加载界面模块在 PreLoadingScreen 阶段加载，比这个模块早很多，它自己输出 trace ，服务器上不加载
+		// The loading screen module loads at PreLoadingScreen, well before this module, and emits its own trace events. It is not loaded on servers
+		if (const IActionRPGLoadingScreenModule* LoadingScreenModule = FModuleManager::GetModulePtr<IActionRPGLoadingScreenModule>("ActionRPGLoadingScreen"))
+		{
+			double StartTime = 0.0;
+			double EndTime = 0.0;
+			LoadingScreenModule->GetStartupTiming(StartTime, EndTime);
+			FRPGStartupProfiler::RecordPhase(ERPGStartupPhase::LoadingScreenModule, StartTime, EndTime);
+		}
+	}
+};
+
+IMPLEMENT_PRIMARY_GAME_MODULE( FActionRPGModule, ActionRPG, "UES_ActionRPG" );
 
 /** Logging definitions */
 DEFINE_LOG_CATEGORY(LogActionRPG);
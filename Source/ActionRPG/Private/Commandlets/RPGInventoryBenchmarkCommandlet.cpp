@@ -0,0 +1,537 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "Commandlets/RPGInventoryBenchmarkCommandlet.h"
+#include "RPGAssetManager.h"
+#include "RPGGameInstanceBase.h"
+#include "RPGPlayerControllerBase.h"
+#include "Items/RPGPotionItem.h"
+#include "Items/RPGSkillItem.h"
+#include "Items/RPGTokenItem.h"
+#include "Items/RPGWeaponItem.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonSerializer.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "HAL/PlatformTLS.h"
+
+namespace RPGInventoryBenchmark
+{
+	/**
+	 * 统计分配次数的 FMalloc 代理，只统计运行测试的线程上的分配，其余调用直接转发
+	 * 代理对象不会被销毁，因为其他线程可能还持有它的指针
+	 */
+	/**
+	 * FMalloc proxy that counts allocations made on the benchmark thread and forwards everything to the real allocator
+	 * The proxy is never destroyed because other threads may still hold the pointer after GMalloc is restored
+	 */
+	class FCountingMalloc final : public FMalloc
+	{
+	public:
+		explicit FCountingMalloc(FMalloc* InInner)
+			: Inner(InInner)
+			, CountingThreadId(FPlatformTLS::GetCurrentThreadId())
+		{}
+
+		virtual void* Malloc(SIZE_T Count, uint32 Alignment) override
+		{
+			CountAllocation();
+			return Inner->Malloc(Count, Alignment);
+		}
+
+		virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override
+		{
+			if (Count > 0)
+			{
+				CountAllocation();
+			}
+			return Inner->Realloc(Original, Count, Alignment);
+		}
+
+		virtual void Free(void* Original) override
+		{
+			Inner->Free(Original);
+		}
+
+		virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override
+		{
+			return Inner->GetAllocationSize(Original, SizeOut);
+		}
+
+		virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override
+		{
+			return Inner->QuantizeSize(Count, Alignment);
+		}
+
+		virtual void Trim(bool bTrimThreadCaches) override
+		{
+			Inner->Trim(bTrimThreadCaches);
+		}
+
+		virtual void SetupTLSCachesOnCurrentThread() override
+		{
+			Inner->SetupTLSCachesOnCurrentThread();
+		}
+
+		virtual void ClearAndDisableTLSCachesOnCurrentThread() override
+		{
+			Inner->ClearAndDisableTLSCachesOnCurrentThread();
+		}
+
+		virtual bool IsInternallyThreadSafe() const override
+		{
+			return Inner->IsInternallyThreadSafe();
+		}
+
+		virtual bool ValidateHeap() override
+		{
+			return Inner->ValidateHeap();
+		}
+
+		virtual void UpdateStats() override
+		{
+			Inner->UpdateStats();
+		}
+
+		virtual void GetAllocatorStats(FGenericMemoryStats& OutStats) override
+		{
+			Inner->GetAllocatorStats(OutStats);
+		}
+
+		virtual void DumpAllocatorStats(FOutputDevice& Ar) override
+		{
+			Inner->DumpAllocatorStats(Ar);
+		}
+
+		virtual const TCHAR* GetDescriptiveName() override
+		{
+			return TEXT("RPGCountingMalloc");
+		}
+
+		FMalloc* GetInner() const
+		{
+			return Inner;
+		}
+
+		uint64 GetNumAllocations() const
+		{
+			return NumAllocations;
+		}
+
+	private:
+		void CountAllocation()
+		{
+			// 只有测试线程会修改计数，不需要原子操作
+			// Only the benchmark thread writes the counter, so it does not need to be atomic
+			if (FPlatformTLS::GetCurrentThreadId() == CountingThreadId)
+			{
+				NumAllocations++;
+			}
+		}
+
+		FMalloc* Inner;
+		uint32 CountingThreadId;
+		uint64 NumAllocations = 0;
+	};
+
+	/** 在作用域内用 FCountingMalloc 替换 GMalloc */
+	/** Installs a FCountingMalloc as GMalloc for the lifetime of this object */
+	struct FScopedCountingMalloc
+	{
+		FScopedCountingMalloc()
+		{
+			static FCountingMalloc* Proxy = new FCountingMalloc(GMalloc);
+			Counter = Proxy;
+			GMalloc = Counter;
+		}
+
+		~FScopedCountingMalloc()
+		{
+			GMalloc = Counter->GetInner();
+		}
+
+		FCountingMalloc* Counter;
+	};
+
+	/** 累计一组操作的耗时和分配次数 */
+	/** Accumulates time and allocations over a group of operations */
+	struct FOperationTimer
+	{
+		explicit FOperationTimer(const FCountingMalloc& InCounter)
+			: Counter(InCounter)
+		{}
+
+		void Start()
+		{
+			StartAllocations = Counter.GetNumAllocations();
+			StartCycles = FPlatformTime::Cycles64();
+		}
+
+		void Stop()
+		{
+			Cycles += FPlatformTime::Cycles64() - StartCycles;
+			Allocations += Counter.GetNumAllocations() - StartAllocations;
+			NumOps++;
+		}
+
+		/** Returns a JSON record and logs a summary line */
+		TSharedPtr<FJsonValue> ToJson(const TCHAR* Operation, int32 Scale) const
+		{
+			const double NsPerOp = NumOps > 0 ? FPlatformTime::ToSeconds64(Cycles) * 1.0e9 / NumOps : 0.0;
+			const double AllocsPerOp = NumOps > 0 ? double(Allocations) / NumOps : 0.0;
+
+			UE_LOG(LogActionRPG, Display, TEXT("RPGInventoryBenchmark: %-24s scale=%-6d ops=%-6d %12.1f ns/op %8.2f allocs/op"), Operation, Scale, NumOps, NsPerOp, AllocsPerOp);
+
+			TSharedRef<FJsonObject> Result = MakeShared<FJsonObject>();
+			Result->SetStringField(TEXT("operation"), Operation);
+			Result->SetNumberField(TEXT("scale"), Scale);
+			Result->SetNumberField(TEXT("ops"), NumOps);
+			Result->SetNumberField(TEXT("ns_per_op"), NsPerOp);
+			Result->SetNumberField(TEXT("allocs_per_op"), AllocsPerOp);
+			return MakeShared<FJsonValueObject>(Result);
+		}
+
+		const FCountingMalloc& Counter;
+		uint64 StartCycles = 0;
+		uint64 StartAllocations = 0;
+		uint64 Cycles = 0;
+		uint64 Allocations = 0;
+		int32 NumOps = 0;
+	};
+
+	/** 测试使用的道具类型，和 URPGAssetManager 中的类型一致 */
+	/** Item types used by the benchmark, item i has type i % NumTypes */
+	static const FPrimaryAssetType ItemTypes[] =
+	{
+		URPGAssetManager::PotionItemType,
+		URPGAssetManager::SkillItemType,
+		URPGAssetManager::TokenItemType,
+		URPGAssetManager::WeaponItemType
+	};
+	static constexpr int32 NumTypes = UE_ARRAY_COUNT(ItemTypes);
+}
+
+URPGInventoryBenchmarkCommandlet::URPGInventoryBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 URPGInventoryBenchmarkCommandlet::Main(const FString& Params)
+{
+	using namespace RPGInventoryBenchmark;
+
+	TArray<int32> Scales = { 10, 1000, 50000 };
+	FString ScalesString;
+	if (FParse::Value(*Params, TEXT("Scales="), ScalesString))
+	{
+		TArray<FString> ScaleStrings;
+		ScalesString.ParseIntoArray(ScaleStrings, TEXT(","));
+
+		Scales.Reset();
+		for (const FString& ScaleString : ScaleStrings)
+		{
+			Scales.Add(FMath::Max(1, FCString::Atoi(*ScaleString)));
+		}
+	}
+
+	int32 NumOps = 2000;
+	FParse::Value(*Params, TEXT("Ops="), NumOps);
+	NumOps = FMath::Max(1, NumOps);
+
+	int32 Seed = 1;
+	FParse::Value(*Params, TEXT("Seed="), Seed);
+
+	FString OutputPath = FPaths::ProjectSavedDir() / TEXT("Benchmarks") / TEXT("InventoryBenchmark.json");
+	FParse::Value(*Params, TEXT("Output="), OutputPath);
+
+	// 保持合成的道具不被回收
+	// Keep the synthetic items referenced through this commandlet
+	AddToRoot();
+
+	// 使用独立的 GameInstance 和世界，不需要加载地图
+	// Standalone game instance and dummy world, no map is loaded
+	GameInstance = NewObject<URPGGameInstanceBase>(GEngine);
+	GameInstance->InitializeStandalone();
+	GameInstance->SetSavingEnabled(false);
+	GameInstance->ItemSlotsPerType.Add(URPGAssetManager::PotionItemType, 2);
+	GameInstance->ItemSlotsPerType.Add(URPGAssetManager::SkillItemType, 3);
+	GameInstance->ItemSlotsPerType.Add(URPGAssetManager::WeaponItemType, 1);
+
+	Controller = GameInstance->GetWorld()->SpawnActor<ARPGPlayerControllerBase>();
+	check(Controller);
+
+	TArray<TSharedPtr<FJsonValue>> Results;
+	for (const int32 Scale : Scales)
+	{
+		RunScale(Scale, NumOps, Seed, Results);
+	}
+
+	TSharedRef<FJsonObject> Report = MakeShared<FJsonObject>();
+	Report->SetStringField(TEXT("benchmark"), TEXT("RPGInventory"));
+	Report->SetNumberField(TEXT("seed"), Seed);
+	Report->SetArrayField(TEXT("results"), Results);
+
+	FString ReportString;
+	const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&ReportString);
+	FJsonSerializer::Serialize(Report, Writer);
+
+	const bool bWritten = FFileHelper::SaveStringToFile(ReportString, *OutputPath);
+	UE_LOG(LogActionRPG, Display, TEXT("RPGInventoryBenchmark: Wrote %s%s"), *OutputPath, bWritten ? TEXT("") : TEXT(" FAILED"));
+
+	Controller->Destroy();
+	GameInstance->Shutdown();
+	RemoveFromRoot();
+
+	return bWritten ? 0 : 1;
+}
+
+void URPGInventoryBenchmarkCommandlet::CreateSyntheticItems(int32 NumItems)
+{
+	using namespace RPGInventoryBenchmark;
+
+	URPGAssetManager& AssetManager = URPGAssetManager::Get();
+
+	for (int32 ItemIndex = SyntheticItems.Num(); ItemIndex < NumItems; ItemIndex++)
+	{
+		const FPrimaryAssetType& ItemType = ItemTypes[ItemIndex % NumTypes];
+		const FName ItemName(*FString::Printf(TEXT("Benchmark_%s_%d"), *ItemType.ToString(), ItemIndex));
+
+		URPGItem* Item = nullptr;
+		if (ItemType == URPGAssetManager::PotionItemType)
+		{
+			Item = NewObject<URPGPotionItem>(GetTransientPackage(), ItemName, RF_Transient);
+		}
+		else if (ItemType == URPGAssetManager::SkillItemType)
+		{
+			Item = NewObject<URPGSkillItem>(GetTransientPackage(), ItemName, RF_Transient);
+		}
+		else if (ItemType == URPGAssetManager::TokenItemType)
+		{
+			Item = NewObject<URPGTokenItem>(GetTransientPackage(), ItemName, RF_Transient);
+		}
+		else
+		{
+			Item = NewObject<URPGWeaponItem>(GetTransientPackage(), ItemName, RF_Transient);
+		}
+
+		// 不限数量，保证 Add / Remove 在整个测试中都会改变数据
+		// Unlimited count so every Add/Remove changes data for the whole run
+		Item->MaxCount = 0;
+		Item->Price = ItemIndex * 7919 % 1000;
+		Item->ItemName = FText::FromName(ItemName);
+
+		// 动态资产没有磁盘上的文件，ForceLoadItem 会直接解析到内存中的对象
+		// Dynamic assets have no file on disk, ForceLoadItem resolves them to the in-memory object
+		AssetManager.AddDynamicAsset(Item->GetPrimaryAssetId(), FSoftObjectPath(Item), FAssetBundleData());
+
+		SyntheticItems.Add(Item);
+	}
+}
+
+void URPGInventoryBenchmarkCommandlet::RunScale(int32 Scale, int32 NumOps, int32 Seed, TArray<TSharedPtr<FJsonValue>>& OutResults)
+{
+	using namespace RPGInventoryBenchmark;
+
+	CreateSyntheticItems(Scale);
+
+	// 重置存档会通过 HandleSaveGameLoaded 重新加载一个空的背包
+	// Resetting the save reloads an empty inventory through HandleSaveGameLoaded
+	GameInstance->ResetSaveGame();
+	Controller->LoadInventory();
+
+	// 准备 Scale 个道具，这部分不计时
+	// Populate the inventory with Scale stacks, this is not timed
+	{
+		FRPGScopedInventoryTransaction Transaction(Controller);
+		for (int32 ItemIndex = 0; ItemIndex < Scale; ItemIndex++)
+		{
+			Controller->AddInventoryItem(SyntheticItems[ItemIndex], 1000, 1, false);
+		}
+	}
+	Controller->FillEmptySlots();
+	Controller->SaveInventory();
+
+	TArray<FRPGItemSlot> Slots;
+	for (const TPair<FPrimaryAssetType, int32>& Pair : GameInstance->ItemSlotsPerType)
+	{
+		for (int32 SlotNumber = 0; SlotNumber < Pair.Value; SlotNumber++)
+		{
+			Slots.Add(FRPGItemSlot(Pair.Key, SlotNumber));
+		}
+	}
+
+	FRandomStream Random(Seed);
+	auto RandomItem = [this, &Random, Scale]()
+	{
+		return SyntheticItems[Random.RandHelper(Scale)];
+	};
+
+	// 返回一个指定类型的随机道具，道具 i 的类型是 i % NumTypes
+	// Returns a random item of a type, item i has type i % NumTypes
+	auto RandomItemOfType = [this, &Random, Scale](const FPrimaryAssetType& ItemType) -> URPGItem*
+	{
+		for (int32 TypeIndex = 0; TypeIndex < NumTypes; TypeIndex++)
+		{
+			if (ItemTypes[TypeIndex] == ItemType && TypeIndex < Scale)
+			{
+				const int32 NumOfType = (Scale - TypeIndex + NumTypes - 1) / NumTypes;
+				return SyntheticItems[Random.RandHelper(NumOfType) * NumTypes + TypeIndex];
+			}
+		}
+		return nullptr;
+	};
+
+	MeasureStorage(Scale, OutResults);
+
+	FScopedCountingMalloc CountingMalloc;
+	TArray<URPGItem*> QueryResults;
+
+	{
+		FOperationTimer Timer(*CountingMalloc.Counter);
+		for (int32 OpIndex = 0; OpIndex < NumOps; OpIndex++)
+		{
+			URPGItem* Item = RandomItem();
+			Timer.Start();
+			Controller->AddInventoryItem(Item, 1, 1, true);
+			Timer.Stop();
+		}
+		OutResults.Add(Timer.ToJson(TEXT("AddInventoryItem"), Scale));
+	}
+
+	{
+		FOperationTimer Timer(*CountingMalloc.Counter);
+		for (int32 OpIndex = 0; OpIndex < NumOps; OpIndex++)
+		{
+			URPGItem* Item = RandomItem();
+			Timer.Start();
+			Controller->RemoveInventoryItem(Item, 1);
+			Timer.Stop();
+		}
+		OutResults.Add(Timer.ToJson(TEXT("RemoveInventoryItem"), Scale));
+	}
+
+	{
+		FOperationTimer Timer(*CountingMalloc.Counter);
+		for (int32 OpIndex = 0; OpIndex < NumOps; OpIndex++)
+		{
+			const FRPGItemSlot& ItemSlot = Slots[OpIndex % Slots.Num()];
+			URPGItem* Item = RandomItemOfType(ItemSlot.ItemType);
+			Timer.Start();
+			Controller->SetSlottedItem(ItemSlot, Item);
+			Timer.Stop();
+		}
+		OutResults.Add(Timer.ToJson(TEXT("SetSlottedItem"), Scale));
+	}
+
+	{
+		FOperationTimer Timer(*CountingMalloc.Counter);
+		for (int32 OpIndex = 0; OpIndex < NumOps; OpIndex++)
+		{
+			const FPrimaryAssetType& ItemType = ItemTypes[OpIndex % NumTypes];
+			QueryResults.Reset();
+			Timer.Start();
+			Controller->GetInventoryItems(QueryResults, ItemType);
+			Timer.Stop();
+		}
+		OutResults.Add(Timer.ToJson(TEXT("GetInventoryItems"), Scale));
+	}
+
+	{
+		FOperationTimer Timer(*CountingMalloc.Counter);
+		for (int32 OpIndex = 0; OpIndex < NumOps; OpIndex++)
+		{
+			const FPrimaryAssetType& ItemType = ItemTypes[OpIndex % NumTypes];
+			QueryResults.Reset();
+			Timer.Start();
+			Controller->GetSortedInventoryItems(QueryResults, ItemType, ERPGInventorySortOrder::Price);
+			Timer.Stop();
+		}
+		OutResults.Add(Timer.ToJson(TEXT("GetSortedInventoryItems"), Scale));
+	}
+
+	{
+		// 没有改变时的保存，只有固定的开销
+		// Save with nothing dirty, this is the fixed overhead of a save
+		FOperationTimer Timer(*CountingMalloc.Counter);
+		for (int32 OpIndex = 0; OpIndex < NumOps; OpIndex++)
+		{
+			Timer.Start();
+			Controller->SaveInventory();
+			Timer.Stop();
+		}
+		OutResults.Add(Timer.ToJson(TEXT("SaveInventory"), Scale));
+	}
+
+	{
+		// 加载会替换整个背包，之后的第一次保存是完整重建，两者分别计时
+		// A load replaces the whole inventory and the first save after it is a full rebuild, both are timed separately
+		const int32 NumLoadOps = FMath::Clamp(200000 / Scale, 1, NumOps);
+		FOperationTimer LoadTimer(*CountingMalloc.Counter);
+		FOperationTimer FullSaveTimer(*CountingMalloc.Counter);
+		for (int32 OpIndex = 0; OpIndex < NumLoadOps; OpIndex++)
+		{
+			LoadTimer.Start();
+			Controller->LoadInventory();
+			LoadTimer.Stop();
+
+			FullSaveTimer.Start();
+			Controller->SaveInventory();
+			FullSaveTimer.Stop();
+		}
+		OutResults.Add(LoadTimer.ToJson(TEXT("LoadInventory"), Scale));
+		OutResults.Add(FullSaveTimer.ToJson(TEXT("SaveInventoryFull"), Scale));
+	}
+}
+
+void URPGInventoryBenchmarkCommandlet::MeasureStorage(int32 Scale, TArray<TSharedPtr<FJsonValue>>& OutResults)
+{
+	URPGInventoryBenchmarkMapHolder* MapHolder = NewObject<URPGInventoryBenchmarkMapHolder>();
+	MapHolder->InventoryData.Reserve(Controller->GetInventoryItemNum());
+	for (FRPGCompactInventory::FConstIterator It = Controller->CreateInventoryIterator(); It; ++It)
+	{
+		MapHolder->InventoryData.Add(It.GetItem(), It.GetItemData());
+	}
+
+	// 用 FReferenceFinder 遍历对象的引用，和 GC 标记阶段对单个对象做的工作相同
+	// FReferenceFinder visits an object's references the same way the GC mark phase does for one object
+	auto TraceReferences = [](UObject* Object, int32& OutNumReferences) -> double
+	{
+		constexpr int32 NumTraces = 20;
+		TArray<UObject*> References;
+		const double StartTime = FPlatformTime::Seconds();
+		for (int32 TraceIndex = 0; TraceIndex < NumTraces; TraceIndex++)
+		{
+			References.Reset();
+			FReferenceFinder Finder(References, nullptr, false);
+			Finder.FindReferences(Object);
+		}
+		OutNumReferences = References.Num();
+		return (FPlatformTime::Seconds() - StartTime) * 1.0e9 / NumTraces;
+	};
+
+	int32 MapReferences = 0;
+	int32 ControllerReferences = 0;
+	const double MapTraceNs = TraceReferences(MapHolder, MapReferences);
+	const double ControllerTraceNs = TraceReferences(Controller, ControllerReferences);
+
+	const SIZE_T MapBytes = MapHolder->InventoryData.GetAllocatedSize();
+	const SIZE_T StoreBytes = Controller->InventoryStore.GetAllocatedSize();
+
+	UE_LOG(LogActionRPG, Display, TEXT("RPGInventoryBenchmark: %-24s scale=%-6d map=%llu bytes store=%llu bytes"), TEXT("Memory"), Scale, uint64(MapBytes), uint64(StoreBytes));
+	UE_LOG(LogActionRPG, Display, TEXT("RPGInventoryBenchmark: %-24s scale=%-6d map=%.1f ns (%d refs) controller=%.1f ns (%d refs)"), TEXT("GCTrace"), Scale, MapTraceNs, MapReferences, ControllerTraceNs, ControllerReferences);
+
+	TSharedRef<FJsonObject> Result = MakeShared<FJsonObject>();
+	Result->SetStringField(TEXT("operation"), TEXT("Storage"));
+	Result->SetNumberField(TEXT("scale"), Scale);
+	Result->SetNumberField(TEXT("map_bytes"), double(MapBytes));
+	Result->SetNumberField(TEXT("store_bytes"), double(StoreBytes));
+	Result->SetNumberField(TEXT("map_gc_trace_ns"), MapTraceNs);
+	Result->SetNumberField(TEXT("map_gc_references"), MapReferences);
+	Result->SetNumberField(TEXT("controller_gc_trace_ns"), ControllerTraceNs);
+	Result->SetNumberField(TEXT("controller_gc_references"), ControllerReferences);
+	OutResults.Add(MakeShared<FJsonValueObject>(Result));
+
+	MapHolder->MarkAsGarbage();
+}
@@ -0,0 +1,343 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "Commandlets/RPGSaveBenchmarkCommandlet.h"
+#include "RPGAssetManager.h"
+#include "RPGSaveGame.h"
+#include "RPGSaveGameArchive.h"
+#include "Kismet/GameplayStatics.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonSerializer.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace RPGSaveBenchmark
+{
+	/** 测试使用的道具类型，道具 i 的类型是 i % NumTypes */
+	/** Item types used by the benchmark, item i has type i % NumTypes */
+	static const FPrimaryAssetType ItemTypes[] =
+	{
+		URPGAssetManager::PotionItemType,
+		URPGAssetManager::SkillItemType,
+		URPGAssetManager::TokenItemType,
+		URPGAssetManager::WeaponItemType
+	};
+	static constexpr int32 NumTypes = UE_ARRAY_COUNT(ItemTypes);
+
+	static double ToMegabytesPerSecond(int64 Bytes, double Seconds)
+	{
+		return Seconds > 0.0 ? Bytes / (1024.0 * 1024.0) / Seconds : 0.0;
+	}
+
+	/** 返回合成的道具 Id */
+	/** Returns the id of synthetic item ItemIndex */
+	static FPrimaryAssetId MakeItemId(int32 ItemIndex)
+	{
+		const FPrimaryAssetType& ItemType = ItemTypes[ItemIndex % NumTypes];
+		return FPrimaryAssetId(ItemType, FName(*FString::Printf(TEXT("Benchmark_%s_%d"), *ItemType.ToString(), ItemIndex)));
+	}
+
+	/** 返回一个操作的 JSON 记录，并输出一行日志 */
+	/** Returns a JSON record of one operation and logs a summary line */
+	static TSharedPtr<FJsonValue> MakeResult(const TCHAR* Operation, int64 Bytes, double SecondsPerSave, bool bValid)
+	{
+		UE_LOG(LogActionRPG, Display, TEXT("RPGSaveBenchmark: %-24s bytes=%-9lld %8.3f ms/save %8.1f MB/s%s"),
+			Operation, Bytes, SecondsPerSave * 1000.0, ToMegabytesPerSecond(Bytes, SecondsPerSave), bValid ? TEXT("") : TEXT(" ROUND TRIP FAILED"));
+
+		TSharedRef<FJsonObject> Result = MakeShared<FJsonObject>();
+		Result->SetStringField(TEXT("operation"), Operation);
+		Result->SetNumberField(TEXT("bytes"), double(Bytes));
+		Result->SetNumberField(TEXT("ms_per_save"), SecondsPerSave * 1000.0);
+		Result->SetNumberField(TEXT("mb_per_s"), ToMegabytesPerSecond(Bytes, SecondsPerSave));
+		Result->SetBoolField(TEXT("round_trip"), bValid);
+		return MakeShared<FJsonValueObject>(Result);
+	}
+}
+
+URPGSaveBenchmarkCommandlet::URPGSaveBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 URPGSaveBenchmarkCommandlet::Main(const FString& Params)
+{
+	int32 NumItems = 10000;
+	FParse::Value(*Params, TEXT("Items="), NumItems);
+	NumItems = FMath::Max(1, NumItems);
+
+	int32 SlotsPerType = 3;
+	FParse::Value(*Params, TEXT("SlotsPerType="), SlotsPerType);
+	SlotsPerType = FMath::Max(0, SlotsPerType);
+
+	int32 NumIterations = 20;
+	FParse::Value(*Params, TEXT("Iterations="), NumIterations);
+	NumIterations = FMath::Max(1, NumIterations);
+
+	FString OutputPath = FPaths::ProjectSavedDir() / TEXT("Benchmarks") / TEXT("SaveBenchmark.json");
+	FParse::Value(*Params, TEXT("Output="), OutputPath);
+
+	URPGSaveGame* SaveGame = CreateSyntheticSaveGame(NumItems, SlotsPerType);
+	SaveGame->AddToRoot();
+
+	TArray<TSharedPtr<FJsonValue>> Results;
+	MeasureSaveGame(SaveGame, NumIterations, Results);
+	MeasureVersionFixUp(NumItems, ERPGSaveGameVersion::Initial, NumIterations, Results);
+	MeasureVersionFixUp(NumItems, ERPGSaveGameVersion::AddedInventory, NumIterations, Results);
+
+	TArray<TSharedPtr<FJsonValue>> FormatResults;
+	for (const bool bSnapshot : { false, true })
+	{
+		for (const ERPGSaveCompression Compression : { ERPGSaveCompression::None, ERPGSaveCompression::Zlib, ERPGSaveCompression::Oodle })
+		{
+			MeasureFormat(SaveGame, bSnapshot, Compression, NumIterations, FormatResults);
+		}
+	}
+
+	SaveGame->RemoveFromRoot();
+
+	TSharedRef<FJsonObject> Report = MakeShared<FJsonObject>();
+	Report->SetStringField(TEXT("benchmark"), TEXT("RPGSave"));
+	Report->SetNumberField(TEXT("items"), NumItems);
+	Report->SetNumberField(TEXT("slots_per_type"), SlotsPerType);
+	Report->SetNumberField(TEXT("save_version"), ERPGSaveGameVersion::LatestVersion);
+	Report->SetNumberField(TEXT("iterations"), NumIterations);
+	Report->SetArrayField(TEXT("results"), Results);
+	Report->SetArrayField(TEXT("formats"), FormatResults);
+
+	FString ReportString;
+	const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&ReportString);
+	FJsonSerializer::Serialize(Report, Writer);
+
+	const bool bWritten = FFileHelper::SaveStringToFile(ReportString, *OutputPath);
+	UE_LOG(LogActionRPG, Display, TEXT("RPGSaveBenchmark: Wrote %s%s"), *OutputPath, bWritten ? TEXT("") : TEXT(" FAILED"));
+
+	return bWritten ? 0 : 1;
+}
+
+URPGSaveGame* URPGSaveBenchmarkCommandlet::CreateSyntheticSaveGame(int32 NumItems, int32 SlotsPerType) const
+{
+	using namespace RPGSaveBenchmark;
+
+	URPGSaveGame* SaveGame = Cast<URPGSaveGame>(UGameplayStatics::CreateSaveGameObject(URPGSaveGame::StaticClass()));
+	SaveGame->UserId = TEXT("Benchmark");
+	SaveGame->InventoryData.Reserve(NumItems);
+
+	for (int32 ItemIndex = 0; ItemIndex < NumItems; ItemIndex++)
+	{
+		SaveGame->InventoryData.Add(MakeItemId(ItemIndex), FRPGItemData(1 + ItemIndex % 99, 1 + ItemIndex % 10));
+	}
+
+	// slot i 放入同类型的第 i 个道具，道具不够时为空
+	// Slot i of a type holds the i-th item of that type, or nothing if there are fewer items
+	for (int32 TypeIndex = 0; TypeIndex < NumTypes; TypeIndex++)
+	{
+		for (int32 SlotNumber = 0; SlotNumber < SlotsPerType; SlotNumber++)
+		{
+			const int32 ItemIndex = SlotNumber * NumTypes + TypeIndex;
+			SaveGame->SlottedItems.Add(FRPGItemSlot(ItemTypes[TypeIndex], SlotNumber), ItemIndex < NumItems ? MakeItemId(ItemIndex) : FPrimaryAssetId());
+		}
+	}
+	return SaveGame;
+}
+
+URPGSaveGame* URPGSaveBenchmarkCommandlet::CreateLegacySaveGame(int32 NumItems, int32 Version) const
+{
+	using namespace RPGSaveBenchmark;
+
+	URPGSaveGame* SaveGame = Cast<URPGSaveGame>(UGameplayStatics::CreateSaveGameObject(URPGSaveGame::StaticClass()));
+	SaveGame->UserId = TEXT("Benchmark");
+	SaveGame->SavedDataVersion = Version;
+	SaveGame->InventoryItems_DEPRECATED.Reserve(NumItems);
+
+	for (int32 ItemIndex = 0; ItemIndex < NumItems; ItemIndex++)
+	{
+		SaveGame->InventoryItems_DEPRECATED.Add(MakeItemId(ItemIndex));
+	}
+	return SaveGame;
+}
+
+void URPGSaveBenchmarkCommandlet::MeasureSaveGame(URPGSaveGame* SaveGame, int32 NumIterations, TArray<TSharedPtr<FJsonValue>>& OutResults)
+{
+	using namespace RPGSaveBenchmark;
+
+	TArray<uint8> Bytes;
+	const double SerializeStart = FPlatformTime::Seconds();
+	for (int32 Iteration = 0; Iteration < NumIterations; Iteration++)
+	{
+		Bytes.Reset();
+		UGameplayStatics::SaveGameToMemory(SaveGame, Bytes);
+	}
+	const double SerializeSeconds = (FPlatformTime::Seconds() - SerializeStart) / NumIterations;
+	OutResults.Add(MakeResult(TEXT("Serialize"), Bytes.Num(), SerializeSeconds, true));
+
+	bool bValid = true;
+	const double DeserializeStart = FPlatformTime::Seconds();
+	for (int32 Iteration = 0; Iteration < NumIterations; Iteration++)
+	{
+		const URPGSaveGame* Loaded = Cast<URPGSaveGame>(UGameplayStatics::LoadGameFromMemory(Bytes));
+		bValid &= Loaded && Loaded->InventoryData.Num() == SaveGame->InventoryData.Num() && Loaded->SlottedItems.Num() == SaveGame->SlottedItems.Num();
+	}
+	const double DeserializeSeconds = (FPlatformTime::Seconds() - DeserializeStart) / NumIterations;
+	OutResults.Add(MakeResult(TEXT("Deserialize"), Bytes.Num(), DeserializeSeconds, bValid));
+
+	// 完整的硬盘读写：序列化、写入 slot 、读取 slot 、反序列化
+	// Full disk round trip: serialize, write the slot, read it back and deserialize
+	const FString SlotName = TEXT("RPGSaveBenchmark");
+	bValid = true;
+	const double RoundTripStart = FPlatformTime::Seconds();
+	for (int32 Iteration = 0; Iteration < NumIterations; Iteration++)
+	{
+		Bytes.Reset();
+		UGameplayStatics::SaveGameToMemory(SaveGame, Bytes);
+		bValid &= UGameplayStatics::SaveDataToSlot(Bytes, SlotName, 0);
+
+		const URPGSaveGame* Loaded = FRPGSaveGameArchive::LoadFromSlot(SlotName, 0);
+		bValid &= Loaded && Loaded->InventoryData.Num() == SaveGame->InventoryData.Num();
+	}
+	const double RoundTripSeconds = (FPlatformTime::Seconds() - RoundTripStart) / NumIterations;
+	OutResults.Add(MakeResult(TEXT("DiskRoundTrip"), Bytes.Num(), RoundTripSeconds, bValid));
+
+	UGameplayStatics::DeleteGameInSlot(SlotName, 0);
+	CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+}
+
+void URPGSaveBenchmarkCommandlet::MeasureVersionFixUp(int32 NumItems, int32 Version, int32 NumIterations, TArray<TSharedPtr<FJsonValue>>& OutResults)
+{
+	using namespace RPGSaveBenchmark;
+
+	TArray<uint8> Bytes;
+	{
+		URPGSaveGame* LegacySave = CreateLegacySaveGame(NumItems, Version);
+		UGameplayStatics::SaveGameToMemory(LegacySave, Bytes);
+		LegacySave->MarkAsGarbage();
+	}
+
+	// 读取会经过 URPGSaveGame::Serialize 中的升级逻辑
+	// Loading runs the fix-up in URPGSaveGame::Serialize
+	bool bValid = true;
+	double MigrationSeconds = 0.0;
+	URPGSaveGame* Migrated = nullptr;
+	const double StartTime = FPlatformTime::Seconds();
+	for (int32 Iteration = 0; Iteration < NumIterations; Iteration++)
+	{
+		Migrated = Cast<URPGSaveGame>(UGameplayStatics::LoadGameFromMemory(Bytes));
+		bValid &= Migrated && Migrated->InventoryData.Num() == NumItems && Migrated->InventoryItems_DEPRECATED.Num() == 0 && Migrated->GetMigratedFromVersion() == Version;
+		MigrationSeconds += Migrated ? Migrated->GetMigrationSeconds() : 0.0;
+	}
+	const double SecondsPerSave = (FPlatformTime::Seconds() - StartTime) / NumIterations;
+
+	const FString Operation = FString::Printf(TEXT("FixUpFromVersion%d"), Version);
+	OutResults.Add(MakeResult(*Operation, Bytes.Num(), SecondsPerSave, bValid));
+
+	// 只有升级步骤本身的时间，不包括反序列化
+	// The migration steps alone, without deserialization
+	const FString MigrateOperation = FString::Printf(TEXT("MigrateFromVersion%d"), Version);
+	OutResults.Add(MakeResult(*MigrateOperation, Bytes.Num(), MigrationSeconds / NumIterations, bValid));
+
+	// 升级后的存档写回之后，再次加载不应该再升级
+	// Once the migrated save is written back, loading it again must not migrate
+	if (Migrated)
+	{
+		TArray<uint8> UpgradedBytes;
+		UGameplayStatics::SaveGameToMemory(Migrated, UpgradedBytes);
+
+		bool bReloadValid = true;
+		const double ReloadStart = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < NumIterations; Iteration++)
+		{
+			const URPGSaveGame* Loaded = Cast<URPGSaveGame>(UGameplayStatics::LoadGameFromMemory(UpgradedBytes));
+			bReloadValid &= Loaded && Loaded->InventoryData.Num() == NumItems && Loaded->GetMigratedFromVersion() == INDEX_NONE;
+		}
+		const double ReloadSecondsPerSave = (FPlatformTime::Seconds() - ReloadStart) / NumIterations;
+
+		const FString ReloadOperation = FString::Printf(TEXT("ReloadAfterVersion%d"), Version);
+		OutResults.Add(MakeResult(*ReloadOperation, UpgradedBytes.Num(), ReloadSecondsPerSave, bReloadValid));
+	}
+
+	CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+}
+
+void URPGSaveBenchmarkCommandlet::MeasureFormat(URPGSaveGame* SaveGame, bool bSnapshot, ERPGSaveCompression Compression, int32 NumIterations, TArray<TSharedPtr<FJsonValue>>& OutResults)
+{
+	using namespace RPGSaveBenchmark;
+
+	// USaveGame 格式不压缩时不加文件头，和旧的存档完全相同
+	// Uncompressed tagged property data is written without the header, exactly like a legacy save
+	const bool bLegacy = !bSnapshot && Compression == ERPGSaveCompression::None;
+
+	TArray<uint8> Bytes;
+	TArray<uint8> SaveGameData;
+	int64 PayloadBytes = 0;
+
+	const double EncodeStart = FPlatformTime::Seconds();
+	for (int32 Iteration = 0; Iteration < NumIterations; Iteration++)
+	{
+		Bytes.Reset();
+		if (bSnapshot)
+		{
+			TSharedRef<const FRPGSaveGameSnapshot> Snapshot = FRPGSaveGameSnapshot::Capture(*SaveGame);
+			FRPGSaveGameArchive::Write(*Snapshot, Compression, Bytes);
+		}
+		else if (bLegacy)
+		{
+			UGameplayStatics::SaveGameToMemory(SaveGame, Bytes);
+		}
+		else
+		{
+			SaveGameData.Reset();
+			UGameplayStatics::SaveGameToMemory(SaveGame, SaveGameData);
+			FRPGSaveGameArchive::WriteSaveGameData(SaveGameData, Compression, Bytes);
+		}
+	}
+	const double EncodeSeconds = (FPlatformTime::Seconds() - EncodeStart) / NumIterations;
+
+	FRPGSaveArchiveHeader Header;
+	TArray<uint8> Payload;
+	if (FRPGSaveGameArchive::Decode(Bytes, Header, Payload))
+	{
+		PayloadBytes = Header.UncompressedSize;
+	}
+	else
+	{
+		PayloadBytes = Bytes.Num();
+	}
+
+	int32 NumLoadedItems = 0;
+	const double DecodeStart = FPlatformTime::Seconds();
+	for (int32 Iteration = 0; Iteration < NumIterations; Iteration++)
+	{
+		URPGSaveGame* Loaded = FRPGSaveGameArchive::LoadFromMemory(Bytes);
+		NumLoadedItems = Loaded ? Loaded->InventoryData.Num() : 0;
+	}
+	const double DecodeSeconds = (FPlatformTime::Seconds() - DecodeStart) / NumIterations;
+
+	// 释放读取时创建的存档对象
+	// Release the save games created by the decode loop
+	CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+
+	const FString Format = bSnapshot ? TEXT("Snapshot") : TEXT("SaveGame");
+	const FString CompressionName = StaticEnum<ERPGSaveCompression>()->GetNameStringByValue(int64(Compression));
+	const bool bValid = NumLoadedItems == SaveGame->InventoryData.Num();
+
+	UE_LOG(LogActionRPG, Display, TEXT("RPGSaveBenchmark: %-8s %-5s %s bytes=%-9d payload=%-9lld encode=%8.3f ms (%7.1f MB/s) decode=%8.3f ms (%7.1f MB/s)%s"),
+		*Format, *CompressionName, bLegacy ? TEXT("legacy") : TEXT("header"), Bytes.Num(), PayloadBytes,
+		EncodeSeconds * 1000.0, ToMegabytesPerSecond(PayloadBytes, EncodeSeconds),
+		DecodeSeconds * 1000.0, ToMegabytesPerSecond(PayloadBytes, DecodeSeconds),
+		bValid ? TEXT("") : TEXT(" ROUND TRIP FAILED"));
+
+	TSharedRef<FJsonObject> Result = MakeShared<FJsonObject>();
+	Result->SetStringField(TEXT("format"), Format);
+	Result->SetStringField(TEXT("compression"), CompressionName);
+	Result->SetBoolField(TEXT("legacy"), bLegacy);
+	Result->SetNumberField(TEXT("bytes"), Bytes.Num());
+	Result->SetNumberField(TEXT("payload_bytes"), double(PayloadBytes));
+	Result->SetNumberField(TEXT("ratio"), Bytes.Num() > 0 ? double(PayloadBytes) / Bytes.Num() : 0.0);
+	Result->SetNumberField(TEXT("encode_ms"), EncodeSeconds * 1000.0);
+	Result->SetNumberField(TEXT("encode_mb_per_s"), ToMegabytesPerSecond(PayloadBytes, EncodeSeconds));
+	Result->SetNumberField(TEXT("decode_ms"), DecodeSeconds * 1000.0);
+	Result->SetNumberField(TEXT("decode_mb_per_s"), ToMegabytesPerSecond(PayloadBytes, DecodeSeconds));
+	Result->SetBoolField(TEXT("round_trip"), bValid);
+	OutResults.Add(MakeShared<FJsonValueObject>(Result));
+}
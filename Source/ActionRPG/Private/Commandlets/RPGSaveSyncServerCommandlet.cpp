@@ -0,0 +1,180 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "Commandlets/RPGSaveSyncServerCommandlet.h"
+#include "RPGSaveGameArchive.h"
+#include "HttpServerModule.h"
+#include "HttpServerRequest.h"
+#include "HttpServerResponse.h"
+#include "IHttpRouter.h"
+#include "GenericPlatform/GenericPlatformHttp.h"
+#include "Containers/Ticker.h"
+#include "Misc/Compression.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace RPGSaveSyncServer
+{
+	/** Returns the first value of a header, empty if it is missing */
+	static FString GetHeader(const FHttpServerRequest& Request, const TCHAR* Name)
+	{
+		const TArray<FString>* Values = Request.Headers.Find(Name);
+		return Values && Values->Num() > 0 ? (*Values)[0] : FString();
+	}
+
+	static TUniquePtr<FHttpServerResponse> MakeResponse(EHttpServerResponseCodes Code, const FString& Text)
+	{
+		TUniquePtr<FHttpServerResponse> Response = FHttpServerResponse::Create(Text, TEXT("text/plain"));
+		Response->Code = Code;
+		return Response;
+	}
+
+	/** 检查一批数据能否解码 */
+	/** Returns true if the body of a batch decodes */
+	static bool ValidateBatch(bool bFull, int32 UncompressedSize, const TArray<uint8>& Body)
+	{
+		if (bFull)
+		{
+			FRPGSaveGameSnapshot Snapshot;
+			return FRPGSaveGameArchive::Read(Body, Snapshot);
+		}
+
+		if (UncompressedSize <= 0 || Body.Num() == 0)
+		{
+			return false;
+		}
+		TArray<uint8> Payload;
+		Payload.SetNumUninitialized(UncompressedSize);
+		return FCompression::UncompressMemory(NAME_Zlib, Payload.GetData(), UncompressedSize, Body.GetData(), Body.Num());
+	}
+}
+
+URPGSaveSyncServerCommandlet::URPGSaveSyncServerCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 URPGSaveSyncServerCommandlet::Main(const FString& Params)
+{
+	int32 Port = 8787;
+	FParse::Value(*Params, TEXT("Port="), Port);
+
+	float Duration = 0.0f;
+	FParse::Value(*Params, TEXT("Duration="), Duration);
+
+	FParse::Value(*Params, TEXT("FailRate="), FailRate);
+	FailRate = FMath::Clamp(FailRate, 0.0f, 1.0f);
+
+	FHttpServerModule& HttpServerModule = FHttpServerModule::Get();
+	TSharedPtr<IHttpRouter> Router = HttpServerModule.GetHttpRouter(Port);
+	if (!Router)
+	{
+		UE_LOG(LogActionRPG, Error, TEXT("RPGSaveSyncServer: Failed to create a router on port %d"), Port);
+		return 1;
+	}
+
+	const FString StorageDir = FPaths::ProjectSavedDir() / TEXT("SaveSync");
+
+	FHttpRouteHandle RouteHandle = Router->BindRoute(FHttpPath(TEXT("/saves")), EHttpServerRequestVerbs::VERB_POST,
+		FHttpRequestHandler::CreateLambda([this, StorageDir](const FHttpServerRequest& Request, const FHttpResultCallback& OnComplete)
+	{
+		// 路径的最后两段是用户和 slot
+		// The last two path segments are the user and the slot
+		TArray<FString> Segments;
+		Request.RelativePath.GetPath().ParseIntoArray(Segments, TEXT("/"));
+		if (Segments.Num() < 2)
+		{
+			OnComplete(RPGSaveSyncServer::MakeResponse(EHttpServerResponseCodes::BadRequest, TEXT("expected /saves/<UserId>/<SlotName>")));
+			return true;
+		}
+		const FString UserId = FGenericPlatformHttp::UrlDecode(Segments[Segments.Num() - 2]);
+		const FString SlotName = FGenericPlatformHttp::UrlDecode(Segments.Last());
+
+		if (FailRate > 0.0f && FMath::FRand() < FailRate)
+		{
+			NumRejected++;
+			OnComplete(RPGSaveSyncServer::MakeResponse(EHttpServerResponseCodes::ServiceUnavail, TEXT("injected failure")));
+			return true;
+		}
+
+		const bool bFull = RPGSaveSyncServer::GetHeader(Request, TEXT("X-RPG-Sync-Kind")) == TEXT("full");
+		int64 BaseRevision = 0;
+		int64 Revision = 0;
+		int32 UncompressedSize = 0;
+		LexFromString(BaseRevision, *RPGSaveSyncServer::GetHeader(Request, TEXT("X-RPG-Sync-Base-Revision")));
+		LexFromString(Revision, *RPGSaveSyncServer::GetHeader(Request, TEXT("X-RPG-Sync-Revision")));
+		LexFromString(UncompressedSize, *RPGSaveSyncServer::GetHeader(Request, TEXT("X-RPG-Sync-Uncompressed-Size")));
+
+		const FString Key = UserId / SlotName;
+		const int64* CurrentRevision = Revisions.Find(Key);
+		if (!bFull)
+		{
+			// 重发已经应用的增量时直接确认
+			// A resent delta that was already applied is acknowledged again
+			if (CurrentRevision && *CurrentRevision == Revision)
+			{
+				OnComplete(RPGSaveSyncServer::MakeResponse(EHttpServerResponseCodes::Ok, TEXT("duplicate")));
+				return true;
+			}
+			if (!CurrentRevision || *CurrentRevision != BaseRevision)
+			{
+				NumRejected++;
+				OnComplete(RPGSaveSyncServer::MakeResponse(EHttpServerResponseCodes::Conflict, TEXT("base revision mismatch")));
+				return true;
+			}
+		}
+
+		if (!RPGSaveSyncServer::ValidateBatch(bFull, UncompressedSize, Request.Body))
+		{
+			NumRejected++;
+			UE_LOG(LogActionRPG, Warning, TEXT("RPGSaveSyncServer: Rejected a malformed %s batch for %s"), bFull ? TEXT("full") : TEXT("delta"), *Key);
+			OnComplete(RPGSaveSyncServer::MakeResponse(EHttpServerResponseCodes::BadRequest, TEXT("malformed batch")));
+			return true;
+		}
+
+		const FString BatchPath = StorageDir / FPaths::MakeValidFileName(UserId) / FPaths::MakeValidFileName(SlotName)
+			/ FString::Printf(TEXT("%06lld.%s"), Revision, bFull ? TEXT("full") : TEXT("delta"));
+		if (!FFileHelper::SaveArrayToFile(Request.Body, *BatchPath))
+		{
+			OnComplete(RPGSaveSyncServer::MakeResponse(EHttpServerResponseCodes::ServerError, TEXT("failed to store batch")));
+			return true;
+		}
+
+		Revisions.Add(Key, Revision);
+		NumAccepted++;
+		NumBytesReceived += Request.Body.Num();
+		UE_LOG(LogActionRPG, Display, TEXT("RPGSaveSyncServer: %s revision %lld of %s, %d bytes"), bFull ? TEXT("full") : TEXT("delta"), Revision, *Key, Request.Body.Num());
+
+		OnComplete(RPGSaveSyncServer::MakeResponse(EHttpServerResponseCodes::Ok, TEXT("ok")));
+		return true;
+	}));
+
+	if (!RouteHandle)
+	{
+		UE_LOG(LogActionRPG, Error, TEXT("RPGSaveSyncServer: Failed to bind /saves on port %d"), Port);
+		return 1;
+	}
+
+	HttpServerModule.StartAllListeners();
+	UE_LOG(LogActionRPG, Display, TEXT("RPGSaveSyncServer: Listening on http://127.0.0.1:%d/saves, storing batches in %s"), Port, *StorageDir);
+
+	// HTTP 服务器在 core ticker 上处理请求
+	// The HTTP server processes requests on the core ticker
+	const double StartTime = FPlatformTime::Seconds();
+	double LastTime = StartTime;
+	while (!IsEngineExitRequested() && (Duration <= 0.0f || FPlatformTime::Seconds() - StartTime < Duration))
+	{
+		const double Now = FPlatformTime::Seconds();
+		FTSTicker::GetCoreTicker().Tick(float(Now - LastTime));
+		LastTime = Now;
+		FPlatformProcess::Sleep(0.005f);
+	}
+
+	Router->UnbindRoute(RouteHandle);
+	HttpServerModule.StopAllListeners();
+
+	UE_LOG(LogActionRPG, Display, TEXT("RPGSaveSyncServer: Accepted %d batches (%lld bytes), rejected %d"), NumAccepted, NumBytesReceived, NumRejected);
+	return 0;
+}
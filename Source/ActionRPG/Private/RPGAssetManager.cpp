@@ -5,12 +5,66 @@
 #include "AbilitySystemGlobals.h"
 #include "AssetRegistry/AssetData.h"
 #include "Items/RPGWeaponItem.h"
+#include "Algo/BinarySearch.h"
+#include "Engine/Texture.h"
+#include "Sound/SoundBase.h"
+#include "RPGStartupProfiler.h"
+#include "RPGInventoryInterface.h"
+#include "RPGInventoryTypes.h"
+#include "RPGGameInstanceBase.h"
+#include "RPGGameModeBase.h"
+#include "RPGSaveGame.h"
 
 const FPrimaryAssetType	URPGAssetManager::PotionItemType = TEXT("Potion");
 const FPrimaryAssetType	URPGAssetManager::SkillItemType = TEXT("Skill");
 const FPrimaryAssetType	URPGAssetManager::TokenItemType = TEXT("Token");
 const FPrimaryAssetType	URPGAssetManager::WeaponItemType = TEXT("Weapon");
 
+const FName URPGAssetManager::MenuBundle = TEXT("Menu");
+const FName URPGAssetManager::GameBundle = TEXT("Game");
+
+DECLARE_CYCLE_STAT(TEXT("Build Item Catalog"), STAT_BuildItemCatalog, STATGROUP_RPGInventory);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Item Load Batches"), STAT_ItemLoadBatches, STATGROUP_RPGInventory);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Item Loads Shared"), STAT_ItemLoadsShared, STATGROUP_RPGInventory);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Last Item Load Latency (ms)"), STAT_ItemLoadLatency, STATGROUP_RPGInventory);
+DECLARE_CYCLE_STAT(TEXT("Update Item Residency"), STAT_UpdateItemResidency, STATGROUP_RPGInventory);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Resident Items"), STAT_ResidentItems, STATGROUP_RPGInventory);
+DECLARE_MEMORY_STAT(TEXT("Resident Item Memory"), STAT_ResidentItemMemory, STATGROUP_RPGInventory);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Item Evictions"), STAT_ItemEvictions, STATGROUP_RPGInventory);
+
+namespace RPGItemCatalog
+{
+	/** Primary asset types of every item class */
+	static TArray<FPrimaryAssetType> GetItemTypes()
+	{
+		return { URPGAssetManager::PotionItemType, URPGAssetManager::SkillItemType, URPGAssetManager::TokenItemType, URPGAssetManager::WeaponItemType };
+	}
+
+	/** 目录的顺序：类型，然后名称 */
+	/** Catalog order: type, then name */
+	static bool IdLess(const FPrimaryAssetId& A, const FPrimaryAssetId& B)
+	{
+		if (A.PrimaryAssetType != B.PrimaryAssetType)
+		{
+			return A.PrimaryAssetType.GetName().LexicalLess(B.PrimaryAssetType.GetName());
+		}
+		return A.PrimaryAssetName.LexicalLess(B.PrimaryAssetName);
+	}
+
+	/** 读取一个整数标签，没有时保留原来的值 */
+	/** Reads an integer tag, keeps the current value if it is missing. Returns true if the tag was found */
+	static bool ReadIntTag(const FAssetData& AssetData, FName Tag, int32& InOutValue)
+	{
+		FString Value;
+		if (AssetData.GetTagValue(Tag, Value) && Value.IsNumeric())
+		{
+			LexFromString(InOutValue, *Value);
+			return true;
+		}
+		return false;
+	}
+}
+
 URPGAssetManager& URPGAssetManager::Get()
 {
 	URPGAssetManager* This = Cast<URPGAssetManager>(GEngine->AssetManager);
@@ -30,31 +84,693 @@ URPGAssetManager& URPGAssetManager::Get()
  */
 void URPGAssetManager::StartInitialLoading()
 {
-	Super::StartInitialLoading();
+	{
+		RPG_STARTUP_PHASE_SCOPE(AssetManagerScan);
+
+		Super::StartInitialLoading();
+	}
 
 	// UAbilitySystemGlobals 是一个单例类，Get() 返回唯一的实例，保存了 Gameplay Ability System 的全局数据，可通过配置文件配置。
 	// InitGlobalData() 是负责执行初始化的函数，Should be called once as part of project setup to load global data tables and tags
+	// URPGAbilitySystemGlobals 记录这个函数各部分的时间
+	// URPGAbilitySystemGlobals times the parts of this call for the startup profiler
 	UAbilitySystemGlobals::Get().InitGlobalData();
+
+	// 编辑器中资产注册表是异步扫描的，扫描完成后再构建道具目录
+	// The editor scans the asset registry asynchronously, build the item catalog once the scan completed
+	CallOrRegister_OnCompletedInitialScan(FSimpleMulticastDelegate::FDelegate::CreateUObject(this, &URPGAssetManager::RebuildItemCatalog));
+
+	PostGarbageCollectHandle = FCoreUObjectDelegates::GetPostGarbageCollect().AddUObject(this, &URPGAssetManager::HandlePostGarbageCollect);
+	FGameModeEvents::GameModeInitializedEvent.AddUObject(this, &URPGAssetManager::HandleGameModeInitialized);
 }
 
 
-URPGItem* URPGAssetManager::ForceLoadItem(const FPrimaryAssetId& PrimaryAssetId, bool bLogWarning) const
+URPGItem* URPGAssetManager::ForceLoadItem(const FPrimaryAssetId& PrimaryAssetId, bool bLogWarning)
 {
-	// FSoftObjectPath 内部有一个 FName 用来保存 top level asset （就是 Primary Assets） 的路径，还有一个 FString 用来保存 subobject 的路径
-	// 软引用的资产可以按需加载
-	const FSoftObjectPath ItemPath = GetPrimaryAssetPath(PrimaryAssetId);
+	// 通过资产管理器加载，道具和 LoadItemsAsync 加载的道具一样计入常驻预算，也可以被换出。
+	// 正在异步加载的道具等待那个请求，否则只加载道具本身，Bundle 在下一次阶段切换时加载
+	// Load through the asset manager so the item is tracked by the residency budget and can be evicted like LoadItemsAsync items.
+	// An item already streaming waits for that request, otherwise only the item itself is loaded and its bundles follow with the next phase transition
+	TSharedPtr<FStreamableHandle> Handle = GetPrimaryAssetHandle(PrimaryAssetId);
+	if (!Handle.IsValid())
+	{
+		Handle = LoadPrimaryAsset(PrimaryAssetId);
+	}
 
 	// This does a synchronous load and may hitch
-	URPGItem* LoadedItem = Cast<URPGItem>(ItemPath.TryLoad());
+	if (Handle.IsValid())
+	{
+		Handle->WaitUntilComplete();
+	}
+	URPGItem* LoadedItem = GetPrimaryAssetObject<URPGItem>(PrimaryAssetId);
 
 	if (bLogWarning && LoadedItem == nullptr)
 	{
 		UE_LOG(LogActionRPG, Warning, TEXT("Failed to load item for identifier %s!"), *PrimaryAssetId.ToString());
 	}
 
+	if (LoadedItem)
+	{
+		TouchItem(PrimaryAssetId);
+	}
+
 	return LoadedItem;
 }
 
+TSharedPtr<FStreamableHandle> URPGAssetManager::LoadItemsAsync(const TArray<FPrimaryAssetId>& ItemIds, const TArray<FName>& LoadBundles, FRPGItemsLoadedDelegate OnLoaded)
+{
+	const double StartTime = FPlatformTime::Seconds();
+
+	TArray<FPrimaryAssetId> BatchIds;
+	TSet<FPrimaryAssetId> UniqueIds;
+	BatchIds.Reserve(ItemIds.Num());
+	UniqueIds.Reserve(ItemIds.Num());
+	for (const FPrimaryAssetId& ItemId : ItemIds)
+	{
+		bool bAlreadyInBatch = false;
+		if (ItemId.IsValid())
+		{
+			UniqueIds.Add(ItemId, &bAlreadyInBatch);
+			if (!bAlreadyInBatch)
+			{
+				BatchIds.Add(ItemId);
+				TouchItem(ItemId);
+			}
+		}
+	}
+
+	ItemLoadStats.BatchesRequested++;
+	ItemLoadStats.ItemsRequested += BatchIds.Num();
+	INC_DWORD_STAT(STAT_ItemLoadBatches);
+
+	// 正在被其他批次加载、并且包含需要的 Bundle 的道具等待那个请求，剩下的道具用一个新请求加载。
+	// 新请求会把道具的 Bundle 改成这次请求的 Bundle
+	// Items already streaming with every requested bundle wait for the request that loads them, the rest go into one new request,
+	// which also moves items streaming with other bundles to the requested ones
+	TArray<TSharedPtr<FStreamableHandle>> Handles;
+	TArray<FPrimaryAssetId> IdsToLoad;
+	for (const FPrimaryAssetId& ItemId : BatchIds)
+	{
+		if (const FInFlightItemLoad* InFlight = InFlightItemLoads.Find(ItemId))
+		{
+			TSharedPtr<FStreamableHandle> Handle = InFlight->Handle.Pin();
+			if (Handle.IsValid() && Handle->IsLoadingInProgress())
+			{
+				const bool bHasBundles = !LoadBundles.ContainsByPredicate([InFlight](const FName& Bundle)
+				{
+					return !InFlight->Bundles.Contains(Bundle);
+				});
+				if (bHasBundles)
+				{
+					Handles.AddUnique(Handle);
+					ItemLoadStats.ItemsShared++;
+					INC_DWORD_STAT(STAT_ItemLoadsShared);
+					continue;
+				}
+			}
+			InFlightItemLoads.Remove(ItemId);
+		}
+		IdsToLoad.Add(ItemId);
+	}
+
+	if (IdsToLoad.Num() > 0)
+	{
+		TSharedPtr<FStreamableHandle> Handle = LoadPrimaryAssets(IdsToLoad, LoadBundles);
+		if (Handle.IsValid() && Handle->IsLoadingInProgress())
+		{
+			for (const FPrimaryAssetId& ItemId : IdsToLoad)
+			{
+				InFlightItemLoads.Add(ItemId, { Handle, LoadBundles });
+			}
+			Handles.Add(Handle);
+		}
+	}
+
+	// 一个句柄只能绑定一个回调，所以总是创建组合句柄，即使只有一个子句柄
+	// A handle only holds one complete delegate, so the batch always gets its own combined handle, even around a single request
+	TSharedPtr<FStreamableHandle> BatchHandle;
+	if (Handles.Num() > 0)
+	{
+		BatchHandle = GetStreamableManager().CreateCombinedHandle(Handles, TEXT("LoadItemsAsync"));
+	}
+
+	if (!BatchHandle.IsValid() || BatchHandle->HasLoadCompleted())
+	{
+		FinishItemLoadBatch(BatchIds, StartTime, MoveTemp(OnLoaded));
+		return nullptr;
+	}
+
+	BatchHandle->BindCompleteDelegate(FStreamableDelegate::CreateWeakLambda(this, [this, BatchIds = MoveTemp(BatchIds), StartTime, OnLoaded = MoveTemp(OnLoaded)]()
+	{
+		FinishItemLoadBatch(BatchIds, StartTime, OnLoaded);
+	}));
+	return BatchHandle;
+}
+
+void URPGAssetManager::FinishItemLoadBatch(const TArray<FPrimaryAssetId>& ItemIds, double StartTime, FRPGItemsLoadedDelegate OnLoaded)
+{
+	TArray<URPGItem*> LoadedItems;
+	LoadedItems.Reserve(ItemIds.Num());
+	for (const FPrimaryAssetId& ItemId : ItemIds)
+	{
+		// 加载它的请求已经完成了
+		// The request loading this item is done
+		if (const FInFlightItemLoad* InFlight = InFlightItemLoads.Find(ItemId))
+		{
+			const TSharedPtr<FStreamableHandle> Handle = InFlight->Handle.Pin();
+			if (!Handle.IsValid() || !Handle->IsLoadingInProgress())
+			{
+				InFlightItemLoads.Remove(ItemId);
+			}
+		}
+
+		if (URPGItem* LoadedItem = GetPrimaryAssetObject<URPGItem>(ItemId))
+		{
+			LoadedItems.Add(LoadedItem);
+		}
+		else
+		{
+			UE_LOG(LogActionRPG, Warning, TEXT("Failed to load item for identifier %s!"), *ItemId.ToString());
+		}
+	}
+
+	const float LatencyMs = float((FPlatformTime::Seconds() - StartTime) * 1000.0);
+	ItemLoadStats.BatchesCompleted++;
+	ItemLoadStats.LastLatencyMs = LatencyMs;
+	ItemLoadStats.MaxLatencyMs = FMath::Max(ItemLoadStats.MaxLatencyMs, LatencyMs);
+	SET_FLOAT_STAT(STAT_ItemLoadLatency, LatencyMs);
+	UE_LOG(LogActionRPG, Verbose, TEXT("Loaded %d of %d items in %.2f ms"), LoadedItems.Num(), ItemIds.Num(), LatencyMs);
+
+	OnLoaded.ExecuteIfBound(LoadedItems);
+
+	// 回调之后再检查预算，回调通常会把道具放进背包，之后它们不会被换出
+	// Check the budget after the delegate, which usually puts the items into an inventory where they are safe from eviction
+	UpdateItemResidency();
+}
+
+void URPGAssetManager::SetGamePhase(ERPGGamePhase NewPhase)
+{
+	if (NewPhase == GamePhase)
+	{
+		return;
+	}
+
+	const TArray<FName> OldBundles = GetBundlesForPhase(GamePhase);
+	const TArray<FName> NewBundles = GetBundlesForPhase(NewPhase);
+	GamePhase = NewPhase;
+
+	TArray<FName> RemoveBundles;
+	for (const FName& Bundle : OldBundles)
+	{
+		if (!NewBundles.Contains(Bundle))
+		{
+			RemoveBundles.Add(Bundle);
+		}
+	}
+
+	// 只改变已经加载的道具，之后加载的道具请求新阶段的 Bundle
+	// Only loaded items change, items loaded later request the bundles of the new phase
+	TArray<FPrimaryAssetId> LoadedItemIds;
+	GetPrimaryAssetsWithBundleState(LoadedItemIds, RPGItemCatalog::GetItemTypes(), TArray<FName>());
+
+	const double StartTime = FPlatformTime::Seconds();
+	auto FinishTransition = [this, NewPhase, StartTime, NumItems = LoadedItemIds.Num()]()
+	{
+		if (GamePhase != NewPhase)
+		{
+			return;
+		}
+		PhaseTransitionHandle.Reset();
+		UpdatePhaseMemoryReport();
+		UpdateItemResidency();
+
+		const FRPGPhaseMemoryReport& Report = PhaseMemoryReports.FindChecked(NewPhase);
+		UE_LOG(LogActionRPG, Log, TEXT("Game phase %s: changed bundles of %d items in %.2f ms, Menu bundle %d assets %.1f KB, Game bundle %d assets %.1f KB resident"),
+			*UEnum::GetValueAsString(NewPhase), NumItems, (FPlatformTime::Seconds() - StartTime) * 1000.0,
+			Report.NumMenuAssets, Report.MenuBytes / 1024.0, Report.NumGameAssets, Report.GameBytes / 1024.0);
+	};
+
+	// 上一次切换还没完成的加载已经没有意义，它的完成回调不会再被调用
+	// The load of an unfinished previous transition is obsolete, its complete delegate will not fire anymore
+	if (PhaseTransitionHandle.IsValid())
+	{
+		PhaseTransitionHandle->CancelHandle();
+		PhaseTransitionHandle.Reset();
+	}
+
+	if (LoadedItemIds.Num() > 0)
+	{
+		PhaseTransitionHandle = ChangeBundleStateForPrimaryAssets(LoadedItemIds, NewBundles, RemoveBundles);
+	}
+
+	if (PhaseTransitionHandle.IsValid() && PhaseTransitionHandle->IsLoadingInProgress())
+	{
+		PhaseTransitionHandle->BindCompleteDelegate(FStreamableDelegate::CreateWeakLambda(this, FinishTransition));
+
+		// 被其他代码取消的切换不会完成，不能让它一直阻止测量
+		// A transition cancelled by other code never completes and must not block the measurements forever
+		PhaseTransitionHandle->BindCancelDelegate(FStreamableDelegate::CreateWeakLambda(this, [this, WeakHandle = TWeakPtr<FStreamableHandle>(PhaseTransitionHandle)]()
+		{
+			if (PhaseTransitionHandle.IsValid() && PhaseTransitionHandle == WeakHandle.Pin())
+			{
+				PhaseTransitionHandle.Reset();
+			}
+		}));
+	}
+	else
+	{
+		FinishTransition();
+	}
+}
+
+void URPGAssetManager::HandleGameModeInitialized(AGameModeBase* GameMode)
+{
+	// ARPGGameModeBase 在 StartPlay 中切换到自己的阶段，其他的 GameMode 按配置进入主菜单
+	// ARPGGameModeBase switches to its own phase in StartPlay, other game modes enter the main menu if configured as one
+	if (!GameMode || GameMode->IsA<ARPGGameModeBase>())
+	{
+		return;
+	}
+
+	const FSoftClassPath GameModeClass(GameMode->GetClass());
+	for (const FSoftClassPath& MainMenuGameMode : MainMenuGameModes)
+	{
+		if (MainMenuGameMode == GameModeClass)
+		{
+			SetGamePhase(ERPGGamePhase::MainMenu);
+			return;
+		}
+	}
+}
+
+TArray<FName> URPGAssetManager::GetBundlesForPhase(ERPGGamePhase Phase) const
+{
+	switch (Phase)
+	{
+	case ERPGGamePhase::MainMenu:
+		return { MenuBundle };
+	case ERPGGamePhase::InventoryOpen:
+		// 背包在战斗中打开，保留声音避免关闭背包时重新加载
+		// The inventory opens mid-game, keep the sounds so closing it does not stream them again
+		return { MenuBundle, GameBundle };
+	case ERPGGamePhase::Gameplay:
+	default:
+		return { GameBundle };
+	}
+}
+
+FRPGPhaseMemoryReport URPGAssetManager::GetPhaseMemoryReport(ERPGGamePhase Phase) const
+{
+	const FRPGPhaseMemoryReport* Report = PhaseMemoryReports.Find(Phase);
+	return Report ? *Report : FRPGPhaseMemoryReport();
+}
+
+void URPGAssetManager::UpdatePhaseMemoryReport()
+{
+	TArray<UObject*> LoadedObjects;
+	for (const FPrimaryAssetType& ItemType : RPGItemCatalog::GetItemTypes())
+	{
+		GetPrimaryAssetObjectList(ItemType, LoadedObjects);
+	}
+
+	// 多个道具可能引用同一个资产，只计算一次
+	// Several items may share an asset, count it once
+	FRPGPhaseMemoryReport Report;
+	TSet<const UObject*> CountedAssets;
+	for (const UObject* Object : LoadedObjects)
+	{
+		const URPGItem* Item = Cast<URPGItem>(Object);
+		if (!Item)
+		{
+			continue;
+		}
+		Report.NumItems++;
+
+		UTexture* Texture = Item->InventoryTexture.Get();
+		if (Texture && !CountedAssets.Contains(Texture))
+		{
+			CountedAssets.Add(Texture);
+			Report.NumMenuAssets++;
+			Report.MenuBytes += Texture->GetResourceSizeBytes(EResourceSizeMode::EstimatedTotal);
+		}
+
+		USoundBase* Sound = Item->PickupSound.Get();
+		if (Sound && !CountedAssets.Contains(Sound))
+		{
+			CountedAssets.Add(Sound);
+			Report.NumGameAssets++;
+			Report.GameBytes += Sound->GetResourceSizeBytes(EResourceSizeMode::EstimatedTotal);
+		}
+	}
+
+	PhaseMemoryReports.Add(GamePhase, Report);
+}
+
+void URPGAssetManager::HandlePostGarbageCollect()
+{
+	ConfirmEvictions();
+
+	// 已经不在加载的句柄没有通过回调清除，比如被释放了
+	// A handle that stopped loading without calling back, e.g. because it was released, no longer counts as a transition
+	if (PhaseTransitionHandle.IsValid() && !PhaseTransitionHandle->IsLoadingInProgress())
+	{
+		PhaseTransitionHandle.Reset();
+	}
+
+	// 切换还在加载时测量的结果没有意义
+	// Measurements during a transition that is still loading are meaningless
+	if (!PhaseTransitionHandle.IsValid())
+	{
+		UpdatePhaseMemoryReport();
+		UpdateItemResidency();
+	}
+}
+
+void URPGAssetManager::UpdateItemResidency()
+{
+	SCOPE_CYCLE_COUNTER(STAT_UpdateItemResidency);
+
+	// 道具可能被其他代码加载或卸载，Bundle 也可能在阶段切换时改变，所以每次重新收集
+	// Items may be loaded or unloaded by other code and their bundles change with the phase, so gather them again every time
+	TArray<FPrimaryAssetId> LoadedItemIds;
+	GetPrimaryAssetsWithBundleState(LoadedItemIds, RPGItemCatalog::GetItemTypes(), TArray<FName>());
+
+	// 资产的大小不变，沿用上次的测量
+	// Asset sizes do not change, reuse the previous measurements
+	TMap<FObjectKey, FResidentAsset> PreviousAssets = MoveTemp(ResidentAssets);
+	ResidentAssets.Reset();
+	ResidentItems.Reset();
+	ItemResidencyStats.ResidentBytes = 0;
+
+	for (const FPrimaryAssetId& ItemId : LoadedItemIds)
+	{
+		TArray<UObject*> LoadedAssets;
+		if (const TSharedPtr<FStreamableHandle> Handle = GetPrimaryAssetHandle(ItemId))
+		{
+			Handle->GetLoadedAssets(LoadedAssets);
+		}
+		if (UObject* Item = GetPrimaryAssetObject(ItemId))
+		{
+			LoadedAssets.AddUnique(Item);
+		}
+		if (LoadedAssets.Num() == 0)
+		{
+			// 还在加载
+			// Still streaming
+			continue;
+		}
+
+		FResidentItem& ResidentItem = ResidentItems.Add(ItemId);
+		for (UObject* Asset : LoadedAssets)
+		{
+			const FObjectKey AssetKey(Asset);
+			FResidentAsset& ResidentAsset = ResidentAssets.FindOrAdd(AssetKey);
+			if (ResidentAsset.NumItems++ == 0)
+			{
+				const FResidentAsset* Previous = PreviousAssets.Find(AssetKey);
+				ResidentAsset.Bytes = Previous ? Previous->Bytes : Asset->GetResourceSizeBytes(EResourceSizeMode::EstimatedTotal);
+				ItemResidencyStats.ResidentBytes += ResidentAsset.Bytes;
+			}
+			ResidentItem.Assets.Add(AssetKey);
+		}
+
+		// 其他代码加载的道具从现在开始算作使用过
+		// Items loaded by other code count as used from now on
+		if (!ItemLastUse.Contains(ItemId))
+		{
+			ItemLastUse.Add(ItemId, ++ItemUseSerial);
+		}
+	}
+
+	// 不再常驻的道具不需要记录
+	// Forget the use of items that are no longer resident
+	for (auto It = ItemLastUse.CreateIterator(); It; ++It)
+	{
+		if (!ResidentItems.Contains(It.Key()) && !InFlightItemLoads.Contains(It.Key()))
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	EvictItems();
+
+	ItemResidencyStats.ResidentItems = ResidentItems.Num();
+	SET_DWORD_STAT(STAT_ResidentItems, ItemResidencyStats.ResidentItems);
+	SET_MEMORY_STAT(STAT_ResidentItemMemory, ItemResidencyStats.ResidentBytes);
+}
+
+void URPGAssetManager::TouchItem(const FPrimaryAssetId& ItemId) const
+{
+	ItemLastUse.Add(ItemId, ++ItemUseSerial);
+}
+
+void URPGAssetManager::GatherItemsInUse(TSet<FPrimaryAssetId>& OutItemIds) const
+{
+	if (!GEngine)
+	{
+		return;
+	}
+
+	// 服务器上有所有玩家的背包，客户端上只有本地玩家的
+	// Servers see the inventory of every player, clients only their local ones
+	for (const FWorldContext& WorldContext : GEngine->GetWorldContexts())
+	{
+		const UWorld* World = WorldContext.World();
+		if (!World)
+		{
+			continue;
+		}
+
+		for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It)
+		{
+			const IRPGInventoryInterface* Inventory = Cast<IRPGInventoryInterface>(It->Get());
+			if (!Inventory)
+			{
+				continue;
+			}
+
+			for (const TPair<URPGItem*, FRPGItemData>& Pair : Inventory->GetInventoryDataMap())
+			{
+				if (Pair.Key)
+				{
+					OutItemIds.Add(Pair.Key->GetPrimaryAssetId());
+				}
+			}
+			for (const TPair<FRPGItemSlot, URPGItem*>& Pair : Inventory->GetSlottedItemMap())
+			{
+				if (Pair.Value)
+				{
+					OutItemIds.Add(Pair.Value->GetPrimaryAssetId());
+				}
+			}
+		}
+
+		// 存档中的道具即将被加载到背包中
+		// Items of the save game are about to be loaded into an inventory
+		if (URPGGameInstanceBase* GameInstance = Cast<URPGGameInstanceBase>(WorldContext.OwningGameInstance))
+		{
+			if (const URPGSaveGame* SaveGame = GameInstance->GetCurrentSaveGame())
+			{
+				for (const TPair<FPrimaryAssetId, FRPGItemData>& Pair : SaveGame->InventoryData)
+				{
+					OutItemIds.Add(Pair.Key);
+				}
+				for (const TPair<FRPGItemSlot, FPrimaryAssetId>& Pair : SaveGame->SlottedItems)
+				{
+					OutItemIds.Add(Pair.Value);
+				}
+			}
+		}
+	}
+}
+
+void URPGAssetManager::EvictItems()
+{
+	const int64 BudgetBytes = int64(ItemResidencyBudgetMB) * 1024 * 1024;
+	ItemResidencyStats.ProtectedItems = 0;
+	if (BudgetBytes <= 0 || ItemResidencyStats.ResidentBytes <= BudgetBytes)
+	{
+		return;
+	}
+
+	TSet<FPrimaryAssetId> ItemsInUse;
+	GatherItemsInUse(ItemsInUse);
+
+	TArray<FPrimaryAssetId> Candidates;
+	Candidates.Reserve(ResidentItems.Num());
+	for (const TPair<FPrimaryAssetId, FResidentItem>& Pair : ResidentItems)
+	{
+		// 道具目录引用的道具在某个背包中（也可能是客户端的复制背包），卸载不会释放它们
+		// Items the catalog holds are in some inventory, a replicated one on clients included, unloading them would free nothing
+		const URPGItem* Item = GetPrimaryAssetObject<URPGItem>(Pair.Key);
+		if (ItemsInUse.Contains(Pair.Key) || (Item && FRPGItemCatalog::Get().Find(Item) != INDEX_NONE))
+		{
+			ItemResidencyStats.ProtectedItems++;
+		}
+		else
+		{
+			Candidates.Add(Pair.Key);
+		}
+	}
+
+	// 最近最少使用的道具在前
+	// Least recently used first
+	Candidates.Sort([this](const FPrimaryAssetId& A, const FPrimaryAssetId& B)
+	{
+		return ItemLastUse.FindRef(A) < ItemLastUse.FindRef(B);
+	});
+
+	int32 NumEvicted = 0;
+	int64 ReleasedBytes = 0;
+	for (const FPrimaryAssetId& ItemId : Candidates)
+	{
+		if (ItemResidencyStats.ResidentBytes <= BudgetBytes)
+		{
+			break;
+		}
+
+		// 只有这个道具引用的资产会被释放，其他代码仍然引用的资产在垃圾回收后才能确定
+		// Only the assets no other resident item holds are released. Whether other code still references them is only known after the next collection
+		FResidentItem ResidentItem;
+		ResidentItems.RemoveAndCopyValue(ItemId, ResidentItem);
+		for (const FObjectKey& AssetKey : ResidentItem.Assets)
+		{
+			FResidentAsset& ResidentAsset = ResidentAssets.FindChecked(AssetKey);
+			if (--ResidentAsset.NumItems == 0)
+			{
+				ItemResidencyStats.ResidentBytes -= ResidentAsset.Bytes;
+				ReleasedBytes += ResidentAsset.Bytes;
+				PendingEvictedAssets.Add(AssetKey, ResidentAsset.Bytes);
+				ResidentAssets.Remove(AssetKey);
+			}
+		}
+
+		ItemLastUse.Remove(ItemId);
+		UnloadPrimaryAsset(ItemId);
+		NumEvicted++;
+	}
+
+	ItemResidencyStats.Evictions += NumEvicted;
+	INC_DWORD_STAT_BY(STAT_ItemEvictions, NumEvicted);
+
+	UE_CLOG(NumEvicted > 0, LogActionRPG, Log, TEXT("Evicted %d items (%.1f KB released), %d items (%.1f KB) remain resident"),
+		NumEvicted, ReleasedBytes / 1024.0, ResidentItems.Num(), ItemResidencyStats.ResidentBytes / 1024.0);
+	UE_CLOG(ItemResidencyStats.ResidentBytes > BudgetBytes, LogActionRPG, Verbose, TEXT("Resident items exceed the budget of %d MB, %d of them are in use"),
+		ItemResidencyBudgetMB, ItemResidencyStats.ProtectedItems);
+}
+
+void URPGAssetManager::ConfirmEvictions()
+{
+	if (PendingEvictedAssets.Num() == 0)
+	{
+		return;
+	}
+
+	// 只计算真正离开内存的资产，仍然存在的资产被其他代码引用
+	// Only count assets that actually left memory, the ones still alive are referenced by other code
+	int32 NumRetained = 0;
+	int64 FreedBytes = 0;
+	for (const TPair<FObjectKey, int64>& Pair : PendingEvictedAssets)
+	{
+		if (Pair.Key.ResolveObjectPtr() == nullptr)
+		{
+			FreedBytes += Pair.Value;
+		}
+		else
+		{
+			NumRetained++;
+		}
+	}
+	PendingEvictedAssets.Reset();
+
+	ItemResidencyStats.EvictedBytes += FreedBytes;
+	UE_CLOG(NumRetained > 0, LogActionRPG, Verbose, TEXT("%d evicted item assets are still referenced elsewhere and stay in memory"), NumRetained);
+}
+
+const FRPGItemInfo* URPGAssetManager::FindItemInfo(const FPrimaryAssetId& ItemId) const
+{
+	const int32 Index = Algo::LowerBound(ItemInfos, ItemId, [](const FRPGItemInfo& Info, const FPrimaryAssetId& Id)
+	{
+		return RPGItemCatalog::IdLess(Info.ItemId, Id);
+	});
+	return ItemInfos.IsValidIndex(Index) && ItemInfos[Index].ItemId == ItemId ? &ItemInfos[Index] : nullptr;
+}
+
+TArrayView<const FRPGItemInfo> URPGAssetManager::GetItemInfosOfType(const FPrimaryAssetType& ItemType) const
+{
+	// 只比较类型，同一类型的道具是连续的
+	// Compare the type only, the items of a type are contiguous
+	auto TypeProjection = [](const FRPGItemInfo& Info) -> FName
+	{
+		return Info.ItemId.PrimaryAssetType.GetName();
+	};
+	auto TypeLess = [](const FName& A, const FName& B)
+	{
+		return A.LexicalLess(B);
+	};
+
+	const int32 Begin = Algo::LowerBoundBy(ItemInfos, ItemType.GetName(), TypeProjection, TypeLess);
+	const int32 End = Algo::UpperBoundBy(ItemInfos, ItemType.GetName(), TypeProjection, TypeLess);
+	return TArrayView<const FRPGItemInfo>(ItemInfos.GetData() + Begin, End - Begin);
+}
+
+void URPGAssetManager::RebuildItemCatalog()
+{
+	SCOPE_CYCLE_COUNTER(STAT_BuildItemCatalog);
+	const double StartTime = FPlatformTime::Seconds();
+
+	ItemInfos.Reset();
+	int32 NumMissingTags = 0;
+
+	for (const FPrimaryAssetType& ItemType : RPGItemCatalog::GetItemTypes())
+	{
+		TArray<FAssetData> AssetDataList;
+		GetPrimaryAssetDataList(ItemType, AssetDataList);
+		ItemInfos.Reserve(ItemInfos.Num() + AssetDataList.Num());
+
+		for (const FAssetData& AssetData : AssetDataList)
+		{
+			FRPGItemInfo& Info = ItemInfos.AddDefaulted_GetRef();
+			Info.ItemId = FPrimaryAssetId(ItemType, AssetData.AssetName);
+
+			// 没有标签的值使用道具类的默认值，原生类总是已经加载的
+			// Values without a tag fall back to the defaults of the item class, native classes are always loaded
+			if (const UClass* ItemClass = AssetData.GetClass())
+			{
+				if (const URPGItem* Defaults = Cast<URPGItem>(ItemClass->GetDefaultObject(false)))
+				{
+					Info.Price = Defaults->Price;
+					Info.MaxCount = Defaults->MaxCount;
+					Info.MaxLevel = Defaults->MaxLevel;
+				}
+			}
+
+			bool bFound = RPGItemCatalog::ReadIntTag(AssetData, GET_MEMBER_NAME_CHECKED(URPGItem, Price), Info.Price);
+			bFound &= RPGItemCatalog::ReadIntTag(AssetData, GET_MEMBER_NAME_CHECKED(URPGItem, MaxCount), Info.MaxCount);
+			bFound &= RPGItemCatalog::ReadIntTag(AssetData, GET_MEMBER_NAME_CHECKED(URPGItem, MaxLevel), Info.MaxLevel);
+
+			FString LinkedItem;
+			if (AssetData.GetTagValue(GET_MEMBER_NAME_CHECKED(URPGItem, LinkedItem), LinkedItem))
+			{
+				Info.LinkedItem = FPrimaryAssetId(LinkedItem);
+			}
+			AssetData.GetTagValue(GET_MEMBER_NAME_CHECKED(URPGItem, ExampleRegistryTag), Info.ExampleRegistryTag);
+
+			Info.bFromRegistryTags = bFound;
+			NumMissingTags += bFound ? 0 : 1;
+		}
+	}
+
+	ItemInfos.Sort([](const FRPGItemInfo& A, const FRPGItemInfo& B)
+	{
+		return RPGItemCatalog::IdLess(A.ItemId, B.ItemId);
+	});
+	ItemInfos.Shrink();
+
+	UE_LOG(LogActionRPG, Log, TEXT("Built item catalog of %d items in %.2f ms"), ItemInfos.Num(), (FPlatformTime::Seconds() - StartTime) * 1000.0);
+	UE_CLOG(NumMissingTags > 0, LogActionRPG, Warning, TEXT("%d items have no catalog tags and use class defaults, resave them to add the tags"), NumMissingTags);
+}
+
 void URPGAssetManager::AssetManagerSample()
 {
 	// Get the global Asset Manager 获取资产管理器
@@ -76,9 +792,8 @@ void URPGAssetManager::AssetManagerSample()
 		UE_LOG(LogTemp, Log, TEXT("Read ExampleRegistryTag %s from Weapon %s"), *QueryExample.ToString(), *AssetDataToParse.AssetName.ToString());
 	}
 
-	// Permanently load a single item
-	TArray<FName> CurrentLoadState;
-	CurrentLoadState.Add(FName("Game"));
+	// Permanently load a single item, with the bundles of the current game phase
+	TArray<FName> CurrentLoadState = AssetManager.GetPhaseBundles();
 
 	FName WeaponName = FName("Weapon_Hammer_3");
 	FPrimaryAssetId WeaponId = FPrimaryAssetId(WeaponItemType, WeaponName);
@@ -2,6 +2,7 @@
 
 #include "RPGBlueprintLibrary.h"
 #include "ActionRPGLoadingScreen.h"
+#include "RPGAssetManager.h"
 
 
 URPGBlueprintLibrary::URPGBlueprintLibrary(const FObjectInitializer& ObjectInitializer)
@@ -90,3 +91,23 @@ FString URPGBlueprintLibrary::GetProjectVersion()
 
 	return ProjectVersion;
 }
+
+void URPGBlueprintLibrary::SetGamePhase(ERPGGamePhase NewPhase)
+{
+	URPGAssetManager::Get().SetGamePhase(NewPhase);
+}
+
+ERPGGamePhase URPGBlueprintLibrary::GetGamePhase()
+{
+	return URPGAssetManager::Get().GetGamePhase();
+}
+
+FRPGPhaseMemoryReport URPGBlueprintLibrary::GetPhaseMemoryReport(ERPGGamePhase Phase)
+{
+	return URPGAssetManager::Get().GetPhaseMemoryReport(Phase);
+}
+
+FRPGItemResidencyStats URPGBlueprintLibrary::GetItemResidencyStats()
+{
+	return URPGAssetManager::Get().GetItemResidencyStats();
+}
@@ -143,6 +143,14 @@ void ARPGCharacterBase::OnItemSlotChanged(FRPGItemSlot ItemSlot, URPGItem* Item)
 	RefreshSlottedGameplayAbilities();
 }
 
+void ARPGCharacterBase::OnInventoryChangeSet(const FRPGInventoryChangeSet& ChangeSet)
+{
+	if (ChangeSet.ChangedSlots.Num() > 0)
+	{
+		RefreshSlottedGameplayAbilities();
+	}
+}
+
 void ARPGCharacterBase::RefreshSlottedGameplayAbilities()
 {
 	if (bAbilitiesInitialized)
@@ -295,6 +303,7 @@ void ARPGCharacterBase::PossessedBy(AController* NewController)
 		{
 			InventoryUpdateHandle = InventorySource->GetSlottedItemChangedDelegate().AddUObject(this, &ARPGCharacterBase::OnItemSlotChanged);
 			InventoryLoadedHandle = InventorySource->GetInventoryLoadedDelegate().AddUObject(this, &ARPGCharacterBase::RefreshSlottedGameplayAbilities);
+			InventoryChangeSetHandle = InventorySource->GetInventoryChangeSetDelegate().AddUObject(this, &ARPGCharacterBase::OnInventoryChangeSet);
 		}
 
 		// Initialize our abilities
@@ -324,6 +333,9 @@ void ARPGCharacterBase::UnPossessed()
 
 		InventorySource->GetInventoryLoadedDelegate().Remove(InventoryLoadedHandle);
 		InventoryLoadedHandle.Reset();
+
+		InventorySource->GetInventoryChangeSetDelegate().Remove(InventoryChangeSetHandle);
+		InventoryChangeSetHandle.Reset();
 	}
 
 	InventorySource = nullptr;
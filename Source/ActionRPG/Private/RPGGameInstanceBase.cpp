@@ -2,7 +2,14 @@
 
 #include "RPGGameInstanceBase.h"
 #include "RPGAssetManager.h"
+#include "RPGCharacterBase.h"
 #include "RPGSaveGame.h"
+#include "RPGSaveGameArchive.h"
+#include "RPGSaveSlotManager.h"
+#include "RPGSaveSubsystem.h"
+#include "RPGSaveSync.h"
+#include "RPGSaveSyncSubsystem.h"
+#include "RPGStartupProfiler.h"
 #include "Items/RPGItem.h"
 #include "Kismet/GameplayStatics.h"
 
@@ -11,6 +18,46 @@ URPGGameInstanceBase::URPGGameInstanceBase()
 	, SaveUserIndex(0)
 {}
 
+void URPGGameInstanceBase::Init()
+{
+	Super::Init();
+
+	FString SyncUrl = SaveSyncUrl;
+	FParse::Value(FCommandLine::Get(), TEXT("SaveSyncUrl="), SyncUrl);
+	if (!SyncUrl.IsEmpty())
+	{
+		SetSaveSyncBackend(MakeShared<FRPGHttpSaveSyncBackend>(SyncUrl));
+	}
+
+	// 启动时的加载画面显示期间读取存档
+	// Read the save slot while the startup loading screen is up
+	if (bPrefetchSaveGame)
+	{
+		LoadOrCreateSaveGameAsync();
+	}
+}
+
+void URPGGameInstanceBase::Shutdown()
+{
+	// 退出时保证等待的保存写入硬盘，并把日志压缩进完整存档
+	// Make sure pending saves reach the disk on exit, and fold the journal into a snapshot
+	if (URPGSaveSubsystem* SaveSubsystem = GetSubsystem<URPGSaveSubsystem>())
+	{
+		if (IsSaveJournalEnabled() && CurrentSaveGame)
+		{
+			FRPGSaveJournal& Journal = GetSaveJournal();
+			if (Journal.HasPendingRecords() || Journal.GetNumRecords() > 0)
+			{
+				SaveSubsystem->RequestSave(ERPGSavePriority::Immediate);
+			}
+		}
+		SaveSubsystem->FlushBlocking();
+	}
+	SaveJournal.Reset();
+
+	Super::Shutdown();
+}
+
 void URPGGameInstanceBase::AddDefaultInventory(URPGSaveGame* SaveGame, bool bRemoveExtra)
 {
 	// 相当于把 inventory 重置为 default inventory
@@ -58,37 +105,124 @@ void URPGGameInstanceBase::SetSavingEnabled(bool bEnabled)
 
 bool URPGGameInstanceBase::LoadOrCreateSaveGame()
 {
+	FRPGStartupProfiler::BeginPhase(ERPGStartupPhase::SaveLoad);
+
 	URPGSaveGame* LoadedSave = nullptr;
 
-	if (UGameplayStatics::DoesSaveGameExist(SaveSlot, SaveUserIndex) && bSavingEnabled)
+	if (bSavingEnabled)
+	{
+		// 同时支持快照格式和 USaveGame 格式，slot 不存在时返回 null
+		// Reads both snapshot archives and regular save games, null if the slot does not exist
+		LoadedSave = FRPGSaveGameArchive::LoadFromSlot(SaveSlot, SaveUserIndex);
+	}
+
+	return ApplySaveGame(LoadedSave);
+}
+
+void URPGGameInstanceBase::LoadOrCreateSaveGameAsync()
+{
+	FRPGStartupProfiler::BeginPhase(ERPGStartupPhase::SaveLoad);
+
+	URPGSaveSubsystem* SaveSubsystem = GetSubsystem<URPGSaveSubsystem>();
+	if (!bSavingEnabled || !SaveSubsystem)
+	{
+		ApplySaveGame(nullptr);
+		return;
+	}
+
+	// 已经在读取时不需要再开始一次
+	// A load that is already running will deliver the same slot
+	if (!SaveSubsystem->IsLoading())
+	{
+		SaveSubsystem->StartLoad();
+	}
+}
+
+bool URPGGameInstanceBase::WaitForSaveGame(float TimeoutSeconds)
+{
+	URPGSaveSubsystem* SaveSubsystem = GetSubsystem<URPGSaveSubsystem>();
+	if (SaveSubsystem && !SaveSubsystem->WaitForLoad(TimeoutSeconds))
 	{
-		LoadedSave = Cast<URPGSaveGame>(UGameplayStatics::LoadGameFromSlot(SaveSlot, SaveUserIndex));
+		return false;
 	}
+	return CurrentSaveGame != nullptr;
+}
 
-	return HandleSaveGameLoaded(LoadedSave);
+bool URPGGameInstanceBase::IsSaveGameLoading() const
+{
+	const URPGSaveSubsystem* SaveSubsystem = GetSubsystem<URPGSaveSubsystem>();
+	return SaveSubsystem && SaveSubsystem->IsLoading();
 }
 
 bool URPGGameInstanceBase::HandleSaveGameLoaded(USaveGame* SaveGameObject)
+{
+	// 蓝图的 Async Load Game From Slot 不能读取 FRPGSaveGameArchive 格式，读取失败时返回 null 。
+	// 如果不在这里重新读取，就会创建一个新的存档并在下一次保存时覆盖玩家的存档。
+	// Blueprint Async Load Game From Slot cannot read the FRPGSaveGameArchive format and hands us null for it.
+	// Without reading the slot again here a new character would be created and overwrite the player's save on the next write
+	if (bSavingEnabled && !Cast<URPGSaveGame>(SaveGameObject) && UGameplayStatics::DoesSaveGameExist(SaveSlot, SaveUserIndex))
+	{
+		SaveGameObject = FRPGSaveGameArchive::LoadFromSlot(SaveSlot, SaveUserIndex);
+		UE_CLOG(SaveGameObject != nullptr, LogActionRPG, Log, TEXT("Read save slot %s through FRPGSaveGameArchive, Async Load Game From Slot cannot decode it"), *SaveSlot);
+		UE_CLOG(SaveGameObject == nullptr, LogActionRPG, Warning, TEXT("Save slot %s exists but could not be read, starting a new character"), *SaveSlot);
+	}
+
+	return ApplySaveGame(Cast<URPGSaveGame>(SaveGameObject));
+}
+
+bool URPGGameInstanceBase::ApplySaveGame(URPGSaveGame* SaveGame)
 {
 	bool bLoaded = false;
 
+	// 这个存档取代还没完成的异步读取
+	// This save game supersedes any asynchronous load still in flight
+	if (URPGSaveSubsystem* SaveSubsystem = GetSubsystem<URPGSaveSubsystem>())
+	{
+		SaveSubsystem->CancelLoad();
+	}
+
 	// 如果没有启用保存到硬盘，就创建新的存档
 	if (!bSavingEnabled)
 	{
 		// If saving is disabled, ignore passed in object
-		SaveGameObject = nullptr;
+		SaveGame = nullptr;
 	}
 
 	// 替换当前的存档
 	// Replace current save, old object will GC out
-	CurrentSaveGame = Cast<URPGSaveGame>(SaveGameObject);
+	CurrentSaveGame = SaveGame;
 
 	if (CurrentSaveGame)
 	{
+		// 存档只是上次压缩时的快照，之后的改变在日志中
+		// The loaded save is the last compacted snapshot, later changes are in the journal
+		if (IsSaveJournalEnabled())
+		{
+			const int32 NumReplayed = GetSaveJournal().Replay(CurrentSaveGame);
+			UE_CLOG(NumReplayed > 0, LogActionRPG, Log, TEXT("Replayed %d save journal records for slot %s"), NumReplayed, *SaveSlot);
+		}
+
 		// 保证存档中包含 default inventory
 		// Make sure it has any newly added default inventory
 		AddDefaultInventory(CurrentSaveGame, false);
 		bLoaded = true;
+
+		// 旧版本的存档在加载时升级，把升级后的存档在后台写回，之后的加载不需要再升级。
+		// 写入成功后存档索引中的版本也会更新。
+		// An old save was migrated while it was read. Write the upgraded form back in the background so later loads skip the migration,
+		// the slot index records the new version once the write landed
+		const int32 MigratedFromVersion = CurrentSaveGame->GetMigratedFromVersion();
+		if (MigratedFromVersion != INDEX_NONE)
+		{
+			UE_LOG(LogActionRPG, Display, TEXT("Migrated save slot %s from version %d to %d in %.2f ms"),
+				*SaveSlot, MigratedFromVersion, int32(ERPGSaveGameVersion::LatestVersion), CurrentSaveGame->GetMigrationSeconds() * 1000.0);
+
+			if (URPGSaveSubsystem* SaveSubsystem = GetSubsystem<URPGSaveSubsystem>())
+			{
+				SaveSubsystem->RecordMigration(CurrentSaveGame->GetMigrationSeconds());
+			}
+			WriteSaveGame(ERPGSavePriority::Background);
+		}
 	}
 	else
 	{
@@ -99,64 +233,165 @@ bool URPGGameInstanceBase::HandleSaveGameLoaded(USaveGame* SaveGameObject)
 		AddDefaultInventory(CurrentSaveGame, true);
 	}
 
+	// 远程的存档可能是任何版本，从完整的存档开始同步
+	// The remote copy may be of any revision, resync it from the whole save game
+	RequestFullSaveSync();
+
 	OnSaveGameLoaded.Broadcast(CurrentSaveGame);
 	OnSaveGameLoadedNative.Broadcast(CurrentSaveGame);
 
+	// 只有启动时的第一次读取会被记录
+	// Only the first read, at startup, is recorded
+	FRPGStartupProfiler::EndPhase(ERPGStartupPhase::SaveLoad);
+
 	return bLoaded;
 }
 
+int32 URPGGameInstanceBase::GetSaveCharacterLevel_Implementation() const
+{
+	const APlayerController* PlayerController = GetFirstLocalPlayerController();
+	const ARPGCharacterBase* Character = PlayerController ? Cast<ARPGCharacterBase>(PlayerController->GetPawn()) : nullptr;
+	return Character ? Character->GetCharacterLevel() : 0;
+}
+
 void URPGGameInstanceBase::GetSaveSlotInfo(FString& SlotName, int32& UserIndex) const
 {
 	SlotName = SaveSlot;
 	UserIndex = SaveUserIndex;
 }
 
-bool URPGGameInstanceBase::WriteSaveGame()
+bool URPGGameInstanceBase::WriteSaveGame(ERPGSavePriority Priority)
 {
 	if (bSavingEnabled) // 检查是否启用了保存
 	{
-		if (bCurrentlySaving) // 检查当前是否在保存
+		// 交给保存调度器，它会把时间窗口内的请求合并成一次写入
+		// 在游戏线程上序列化，在工作线程上进行实际的写入操作。
+		// The scheduler coalesces requests within their window into one background write
+		if (URPGSaveSubsystem* SaveSubsystem = GetSubsystem<URPGSaveSubsystem>())
 		{
-			// 在当前保存操作结束后再处理，这里直接返回，用一个变量记录，相当于等待保存的队列长度为 1 。
-			// Schedule another save to happen after current one finishes. We only queue one save
-			bPendingSaveRequested = true;
-			return true;
+			return SaveSubsystem->RequestSave(Priority);
 		}
-
-		// 表明正在执行一个异步的保存操作
-		// Indicate that we're currently doing an async save
-		bCurrentlySaving = true;
-
-		// 安排一个异步的保存操作，这里的 Slot 是一个字符串，相当于 Key 。
-		// 这个函数也有蓝图的版本。
-		// 在游戏线程上序列化，在平台相关的工作线程上进行实际的写入操作。
-		// 完成时会在游戏线程上调用委托
-		// 传入的委托会被拷贝到工作线程，所以要保证 Payload 在 copy by value 时是线程安全的（这里没有 Payload）。
-		// This goes off in the background
-		UGameplayStatics::AsyncSaveGameToSlot(GetCurrentSaveGame(), SaveSlot, SaveUserIndex, FAsyncSaveGameToSlotDelegate::CreateUObject(this, &URPGGameInstanceBase::HandleAsyncSave));
-		return true;
 	}
 	return false;
 }
 
 void URPGGameInstanceBase::ResetSaveGame()
 {
-	// 给 HandleSaveGameLoaded 传入一个 nullptr ，它就会创建一个新的存档
-	// Call handle function with no loaded save, this will reset the data
-	HandleSaveGameLoaded(nullptr);
+	// 给 ApplySaveGame 传入一个 nullptr ，它就会创建一个新的存档
+	// Apply no loaded save, this will reset the data
+	ApplySaveGame(nullptr);
 }
 
-void URPGGameInstanceBase::HandleAsyncSave(const FString& SlotName, const int32 UserIndex, bool bSuccess)
+bool URPGGameInstanceBase::IsSaveJournalEnabled() const
+{
+	return bUseSaveJournal && bSavingEnabled;
+}
+
+void URPGGameInstanceBase::JournalInventoryItem(const FPrimaryAssetId& ItemId, const FRPGItemData* ItemData)
 {
-	// 调用到这个函数时 bCurrentlySaving 应该被设为 true 。
-	ensure(bCurrentlySaving);
-	bCurrentlySaving = false;
+	if (IsSaveJournalEnabled() && !IsSaveGameLoading())
+	{
+		GetSaveJournal().RecordItem(ItemId, ItemData);
+	}
 
-	// 在这里处理等待的保存操作
-	if (bPendingSaveRequested)
+	if (URPGSaveSyncSubsystem* SaveSync = GetSubsystem<URPGSaveSyncSubsystem>())
+	{
+		SaveSync->RecordItem(ItemId, ItemData);
+	}
+}
+
+void URPGGameInstanceBase::JournalSlottedItem(const FRPGItemSlot& ItemSlot, const FPrimaryAssetId& ItemId)
+{
+	if (IsSaveJournalEnabled() && !IsSaveGameLoading())
+	{
+		GetSaveJournal().RecordSlot(ItemSlot, ItemId);
+	}
+
+	if (URPGSaveSyncSubsystem* SaveSync = GetSubsystem<URPGSaveSyncSubsystem>())
+	{
+		SaveSync->RecordSlot(ItemSlot, ItemId);
+	}
+}
+
+bool URPGGameInstanceBase::AppendSaveJournal()
+{
+	if (!IsSaveJournalEnabled())
+	{
+		return WriteSaveGame();
+	}
+
+	// 读取完成时会重放日志，读取期间追加的记录属于还没有加载的数据
+	// The journal is replayed when the load completes, records appended before that would describe data that was never loaded
+	if (!CurrentSaveGame || IsSaveGameLoading())
+	{
+		return false;
+	}
+
+	// 文件追加在工作线程上进行，之前的追加失败时写入完整存档，保证改变不会丢失
+	// The file append runs on a worker. If an earlier append failed fall back to a snapshot so no change is lost
+	FRPGSaveJournal& Journal = GetSaveJournal();
+	if (!Journal.Flush())
+	{
+		return WriteSaveGame();
+	}
+
+	if (URPGSaveSlotManager* SlotManager = GetSubsystem<URPGSaveSlotManager>())
+	{
+		SlotManager->HandleJournalAppended(SaveSlot, SaveUserIndex, CurrentSaveGame->InventoryData.Num(), Journal.GetWriteTask());
+	}
+
+	// 压缩不紧急，可以和其他保存合并
+	// Compaction is not urgent and can batch with other saves
+	if (Journal.GetNumRecords() >= SaveJournalCompactionThreshold)
+	{
+		return WriteSaveGame(ERPGSavePriority::Background);
+	}
+	return true;
+}
+
+void URPGGameInstanceBase::SetSaveSyncBackend(TSharedPtr<IRPGSaveSyncBackend> Backend)
+{
+	if (URPGSaveSyncSubsystem* SaveSync = GetSubsystem<URPGSaveSyncSubsystem>())
+	{
+		SaveSync->SetBackend(MoveTemp(Backend));
+	}
+}
+
+void URPGGameInstanceBase::RequestFullSaveSync()
+{
+	if (URPGSaveSyncSubsystem* SaveSync = GetSubsystem<URPGSaveSyncSubsystem>())
+	{
+		SaveSync->RequestFullUpload();
+	}
+}
+
+FRPGSaveJournal& URPGGameInstanceBase::GetSaveJournal()
+{
+	if (!SaveJournal || SaveJournal->GetSlotName() != SaveSlot)
+	{
+		SaveJournal = MakeUnique<FRPGSaveJournal>(SaveSlot);
+	}
+	return *SaveJournal;
+}
+
+void URPGGameInstanceBase::HandleSaveWriteStarted()
+{
+	// 完整存档包含了日志中的全部改变，开始压缩日志
+	// The snapshot contains everything journaled so far, start compacting
+	if (IsSaveJournalEnabled())
+	{
+		FRPGSaveJournal& Journal = GetSaveJournal();
+		Journal.DiscardPending();
+		Journal.BeginCompaction();
+	}
+}
+
+void URPGGameInstanceBase::HandleAsyncSave(const FString& SlotName, const int32 UserIndex, bool bSuccess)
+{
+	// 存档写入成功后才能删除被压缩的日志
+	// The compacted journal can only go once the snapshot is on disk
+	if (IsSaveJournalEnabled() && SlotName == SaveSlot)
 	{
-		// Start another save as we got a request while saving
-		bPendingSaveRequested = false;
-		WriteSaveGame();
+		GetSaveJournal().EndCompaction(bSuccess);
 	}
 }
@@ -3,6 +3,8 @@
 #include "RPGGameModeBase.h"
 #include "RPGGameStateBase.h"
 #include "RPGPlayerControllerBase.h"
+#include "RPGAssetManager.h"
+#include "RPGStartupProfiler.h"
 
 ARPGGameModeBase::ARPGGameModeBase()
 {
@@ -11,6 +13,17 @@ ARPGGameModeBase::ARPGGameModeBase()
 	bGameOver = false;
 }
 
+void ARPGGameModeBase::StartPlay()
+{
+	URPGAssetManager::Get().SetGamePhase(GamePhase);
+
+	Super::StartPlay();
+
+	// 第一个开始游戏的世界，这一帧结束时输出启动时间的汇总
+	// The first world to start play logs the startup summary at the end of this frame
+	FRPGStartupProfiler::NotifyStartPlay();
+}
+
 void ARPGGameModeBase::ResetLevel() 
 {
 	K2_DoRestart();
@@ -0,0 +1,130 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "RPGInventoryReplication.h"
+#include "RPGPlayerControllerBase.h"
+
+void FRPGReplicatedInventoryEntry::PreReplicatedRemove(const FRPGReplicatedInventory& InArraySerializer) const
+{
+	if (InArraySerializer.Owner)
+	{
+		InArraySerializer.Owner->HandleReplicatedItemRemoved(ItemId);
+	}
+}
+
+void FRPGReplicatedInventoryEntry::PostReplicatedAdd(const FRPGReplicatedInventory& InArraySerializer) const
+{
+	if (InArraySerializer.Owner)
+	{
+		InArraySerializer.Owner->HandleReplicatedItemChanged(ItemId, ItemData);
+	}
+}
+
+void FRPGReplicatedInventoryEntry::PostReplicatedChange(const FRPGReplicatedInventory& InArraySerializer) const
+{
+	if (InArraySerializer.Owner)
+	{
+		InArraySerializer.Owner->HandleReplicatedItemChanged(ItemId, ItemData);
+	}
+}
+
+void FRPGReplicatedInventory::SetItem(const FPrimaryAssetId& ItemId, const FRPGItemData& ItemData)
+{
+	if (const int32* FoundIndex = EntryIndices.Find(ItemId))
+	{
+		FRPGReplicatedInventoryEntry& Entry = Entries[*FoundIndex];
+		if (Entry.ItemData != ItemData)
+		{
+			Entry.ItemData = ItemData;
+			MarkItemDirty(Entry);
+		}
+		return;
+	}
+
+	FRPGReplicatedInventoryEntry& Entry = Entries.AddDefaulted_GetRef();
+	Entry.ItemId = ItemId;
+	Entry.ItemData = ItemData;
+	EntryIndices.Add(ItemId, Entries.Num() - 1);
+	MarkItemDirty(Entry);
+}
+
+void FRPGReplicatedInventory::RemoveItem(const FPrimaryAssetId& ItemId)
+{
+	int32 Index = INDEX_NONE;
+	if (!EntryIndices.RemoveAndCopyValue(ItemId, Index))
+	{
+		return;
+	}
+
+	// 用最后一个条目填补空位，只需要更新它的下标
+	// The last entry fills the hole, so only its index needs fixing
+	Entries.RemoveAtSwap(Index, 1, false);
+	if (Entries.IsValidIndex(Index))
+	{
+		EntryIndices.Add(Entries[Index].ItemId, Index);
+	}
+	MarkArrayDirty();
+}
+
+void FRPGReplicatedInventory::Reset()
+{
+	if (Entries.Num() > 0)
+	{
+		Entries.Reset();
+		EntryIndices.Reset();
+		MarkArrayDirty();
+	}
+}
+
+void FRPGReplicatedSlotEntry::PreReplicatedRemove(const FRPGReplicatedSlots& InArraySerializer) const
+{
+	if (InArraySerializer.Owner)
+	{
+		InArraySerializer.Owner->HandleReplicatedSlotChanged(ItemSlot, FPrimaryAssetId());
+	}
+}
+
+void FRPGReplicatedSlotEntry::PostReplicatedAdd(const FRPGReplicatedSlots& InArraySerializer) const
+{
+	if (InArraySerializer.Owner)
+	{
+		InArraySerializer.Owner->HandleReplicatedSlotChanged(ItemSlot, ItemId);
+	}
+}
+
+void FRPGReplicatedSlotEntry::PostReplicatedChange(const FRPGReplicatedSlots& InArraySerializer) const
+{
+	if (InArraySerializer.Owner)
+	{
+		InArraySerializer.Owner->HandleReplicatedSlotChanged(ItemSlot, ItemId);
+	}
+}
+
+void FRPGReplicatedSlots::SetSlot(const FRPGItemSlot& ItemSlot, const FPrimaryAssetId& ItemId)
+{
+	if (const int32* FoundIndex = EntryIndices.Find(ItemSlot))
+	{
+		FRPGReplicatedSlotEntry& Entry = Entries[*FoundIndex];
+		if (Entry.ItemId != ItemId)
+		{
+			Entry.ItemId = ItemId;
+			MarkItemDirty(Entry);
+		}
+		return;
+	}
+
+	FRPGReplicatedSlotEntry& Entry = Entries.AddDefaulted_GetRef();
+	Entry.ItemSlot = ItemSlot;
+	Entry.ItemId = ItemId;
+	EntryIndices.Add(ItemSlot, Entries.Num() - 1);
+	MarkItemDirty(Entry);
+}
+
+void FRPGReplicatedSlots::Reset()
+{
+	if (Entries.Num() > 0)
+	{
+		Entries.Reset();
+		EntryIndices.Reset();
+		MarkArrayDirty();
+	}
+}
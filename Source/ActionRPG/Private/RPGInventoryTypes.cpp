@@ -0,0 +1,524 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "RPGInventoryTypes.h"
+#include "Items/RPGItem.h"
+#include "Algo/BinarySearch.h"
+
+FRPGItemCatalog& FRPGItemCatalog::Get()
+{
+	static FRPGItemCatalog Catalog;
+	return Catalog;
+}
+
+int32 FRPGItemCatalog::AddRef(URPGItem* Item)
+{
+	check(Item);
+	if (Item->CatalogIndex == INDEX_NONE)
+	{
+		if (FreeIndices.Num() > 0)
+		{
+			Item->CatalogIndex = FreeIndices.Pop(false);
+			Entries[Item->CatalogIndex].Item = Item;
+		}
+		else
+		{
+			Item->CatalogIndex = Entries.Add(FEntry{ Item, 0 });
+		}
+	}
+
+	Entries[Item->CatalogIndex].RefCount++;
+	return Item->CatalogIndex;
+}
+
+void FRPGItemCatalog::Release(int32 CatalogIndex)
+{
+	FEntry& Entry = Entries[CatalogIndex];
+	check(Entry.RefCount > 0);
+	if (--Entry.RefCount > 0)
+	{
+		return;
+	}
+
+	// 没有背包持有这个道具了，释放强引用，之后再加入背包时重新分配下标
+	// No inventory holds the item anymore. Drop the strong reference, it gets a new index if it enters an inventory again
+	if (Entry.Item)
+	{
+		Entry.Item->CatalogIndex = INDEX_NONE;
+	}
+	Entry.Item = nullptr;
+	FreeIndices.Add(CatalogIndex);
+}
+
+int32 FRPGItemCatalog::Find(const URPGItem* Item) const
+{
+	return Item ? Item->CatalogIndex : INDEX_NONE;
+}
+
+void FRPGItemCatalog::AddReferencedObjects(FReferenceCollector& Collector)
+{
+	for (FEntry& Entry : Entries)
+	{
+		if (Entry.Item)
+		{
+			Collector.AddReferencedObject(Entry.Item);
+		}
+	}
+}
+
+FString FRPGItemCatalog::GetReferencerName() const
+{
+	return TEXT("FRPGItemCatalog");
+}
+
+const FRPGItemData* FRPGCompactInventory::Find(const URPGItem* Item) const
+{
+	const int32 CatalogIndex = FRPGItemCatalog::Get().Find(Item);
+	if (EntryIndices.IsValidIndex(CatalogIndex))
+	{
+		const int32 EntryIndex = EntryIndices[CatalogIndex];
+		if (EntryIndex != INDEX_NONE)
+		{
+			return &Entries[EntryIndex].ItemData;
+		}
+	}
+	return nullptr;
+}
+
+bool FRPGCompactInventory::Set(URPGItem* Item, const FRPGItemData& ItemData)
+{
+	FRPGItemCatalog& Catalog = FRPGItemCatalog::Get();
+
+	// 已经在背包中的道具只更新数据
+	// An item already stored only has its data updated
+	int32 CatalogIndex = Catalog.Find(Item);
+	if (EntryIndices.IsValidIndex(CatalogIndex) && EntryIndices[CatalogIndex] != INDEX_NONE)
+	{
+		Entries[EntryIndices[CatalogIndex]].ItemData = ItemData;
+		return false;
+	}
+
+	// 新的条目持有一个目录引用，直到被移除
+	// A new entry holds a catalog reference until it is removed
+	CatalogIndex = Catalog.AddRef(Item);
+	if (CatalogIndex >= EntryIndices.Num())
+	{
+		const int32 OldNum = EntryIndices.Num();
+		EntryIndices.SetNumUninitialized(CatalogIndex + 1);
+		for (int32 Index = OldNum; Index < EntryIndices.Num(); Index++)
+		{
+			EntryIndices[Index] = INDEX_NONE;
+		}
+	}
+
+	EntryIndices[CatalogIndex] = Entries.Add(FEntry{ CatalogIndex, ItemData });
+	return true;
+}
+
+bool FRPGCompactInventory::Remove(const URPGItem* Item)
+{
+	const int32 CatalogIndex = FRPGItemCatalog::Get().Find(Item);
+	if (!EntryIndices.IsValidIndex(CatalogIndex) || EntryIndices[CatalogIndex] == INDEX_NONE)
+	{
+		return false;
+	}
+
+	// 用最后一个条目填补空位
+	// Swap the last entry into the hole and repoint it
+	const int32 EntryIndex = EntryIndices[CatalogIndex];
+	EntryIndices[CatalogIndex] = INDEX_NONE;
+	Entries.RemoveAtSwap(EntryIndex, 1, false);
+	if (Entries.IsValidIndex(EntryIndex))
+	{
+		EntryIndices[Entries[EntryIndex].CatalogIndex] = EntryIndex;
+	}
+
+	FRPGItemCatalog::Get().Release(CatalogIndex);
+	return true;
+}
+
+void FRPGCompactInventory::Reset()
+{
+	if (Entries.Num() > 0)
+	{
+		FRPGItemCatalog& Catalog = FRPGItemCatalog::Get();
+		for (const FEntry& Entry : Entries)
+		{
+			Catalog.Release(Entry.CatalogIndex);
+		}
+	}
+	Entries.Reset();
+	EntryIndices.Reset();
+}
+
+SIZE_T FRPGCompactInventory::GetAllocatedSize() const
+{
+	return Entries.GetAllocatedSize() + EntryIndices.GetAllocatedSize();
+}
+
+void FRPGItemSlotTable::Initialize(const TMap<FPrimaryAssetType, int32>& SlotsPerType)
+{
+	Reset();
+
+	// 按 ItemSlotsPerType 的顺序排列，和之前 SlottedItems 的遍历顺序一致
+	// Lay out in ItemSlotsPerType order, which matches the old SlottedItems iteration order
+	for (const TPair<FPrimaryAssetType, int32>& Pair : SlotsPerType)
+	{
+		if (!Pair.Key.IsValid() || Pair.Value <= 0)
+		{
+			continue;
+		}
+
+		FTypeRange& Range = TypeRanges.Add(Pair.Key);
+		Range.FirstIndex = Items.Num();
+		Range.NumSlots = Pair.Value;
+		Range.FreeSlots.Init(true, Pair.Value);
+
+		Items.AddZeroed(Pair.Value);
+	}
+}
+
+void FRPGItemSlotTable::Reset()
+{
+	TypeRanges.Reset();
+	Items.Reset();
+	ItemSlots.Reset();
+}
+
+int32 FRPGItemSlotTable::GetSlotIndex(const FRPGItemSlot& ItemSlot) const
+{
+	const FTypeRange* Range = TypeRanges.Find(ItemSlot.ItemType);
+
+	if (Range && ItemSlot.SlotNumber >= 0 && ItemSlot.SlotNumber < Range->NumSlots)
+	{
+		return Range->FirstIndex + ItemSlot.SlotNumber;
+	}
+	return INDEX_NONE;
+}
+
+URPGItem* FRPGItemSlotTable::GetItem(const FRPGItemSlot& ItemSlot) const
+{
+	const int32 SlotIndex = GetSlotIndex(ItemSlot);
+	return SlotIndex != INDEX_NONE ? Items[SlotIndex] : nullptr;
+}
+
+URPGItem* FRPGItemSlotTable::SetItem(const FRPGItemSlot& ItemSlot, URPGItem* Item)
+{
+	FTypeRange* Range = TypeRanges.Find(ItemSlot.ItemType);
+	check(Range && ItemSlot.SlotNumber >= 0 && ItemSlot.SlotNumber < Range->NumSlots);
+
+	URPGItem*& SlotItem = Items[Range->FirstIndex + ItemSlot.SlotNumber];
+	URPGItem* OldItem = SlotItem;
+
+	if (OldItem == Item)
+	{
+		return OldItem;
+	}
+
+	if (OldItem)
+	{
+		TArray<FRPGItemSlot, TInlineAllocator<1>>& OldItemSlots = ItemSlots.FindChecked(OldItem);
+		OldItemSlots.RemoveSingleSwap(ItemSlot, false);
+		if (OldItemSlots.Num() == 0)
+		{
+			ItemSlots.Remove(OldItem);
+		}
+	}
+
+	if (Item)
+	{
+		ItemSlots.FindOrAdd(Item).Add(ItemSlot);
+	}
+
+	SlotItem = Item;
+	Range->FreeSlots[ItemSlot.SlotNumber] = (Item == nullptr);
+	return OldItem;
+}
+
+FRPGItemSlot FRPGItemSlotTable::FindFreeSlot(const FPrimaryAssetType& ItemType) const
+{
+	if (const FTypeRange* Range = TypeRanges.Find(ItemType))
+	{
+		const int32 SlotNumber = Range->FreeSlots.Find(true);
+		if (SlotNumber != INDEX_NONE)
+		{
+			return FRPGItemSlot(ItemType, SlotNumber);
+		}
+	}
+	return FRPGItemSlot();
+}
+
+void FRPGItemSlotTable::FindSlotsWithItem(const URPGItem* Item, TArray<FRPGItemSlot>& OutSlots) const
+{
+	if (const TArray<FRPGItemSlot, TInlineAllocator<1>>* FoundSlots = Item ? ItemSlots.Find(Item) : nullptr)
+	{
+		OutSlots.Append(*FoundSlots);
+	}
+}
+
+bool FRPGItemSlotTable::IsConsistentWith(const TMap<FRPGItemSlot, URPGItem*>& SlottedItems) const
+{
+	if (SlottedItems.Num() != Items.Num())
+	{
+		return false;
+	}
+
+	int32 NumSlottedItems = 0;
+	for (const TPair<FRPGItemSlot, URPGItem*>& Pair : SlottedItems)
+	{
+		const int32 SlotIndex = GetSlotIndex(Pair.Key);
+		if (SlotIndex == INDEX_NONE || Items[SlotIndex] != Pair.Value)
+		{
+			return false;
+		}
+
+		const FTypeRange& Range = TypeRanges.FindChecked(Pair.Key.ItemType);
+		if (Range.FreeSlots[Pair.Key.SlotNumber] != (Pair.Value == nullptr))
+		{
+			return false;
+		}
+
+		if (Pair.Value)
+		{
+			const TArray<FRPGItemSlot, TInlineAllocator<1>>* FoundSlots = ItemSlots.Find(Pair.Value);
+			if (!FoundSlots || !FoundSlots->Contains(Pair.Key))
+			{
+				return false;
+			}
+			NumSlottedItems++;
+		}
+	}
+
+	// 反向索引中不能有多余的插槽
+	// The reverse index must not hold extra slots
+	int32 NumIndexedSlots = 0;
+	for (const TPair<const URPGItem*, TArray<FRPGItemSlot, TInlineAllocator<1>>>& Pair : ItemSlots)
+	{
+		NumIndexedSlots += Pair.Value.Num();
+	}
+	return NumIndexedSlots == NumSlottedItems;
+}
+
+void FRPGItemSlotTable::GetItems(const FPrimaryAssetType& ItemType, TArray<URPGItem*>& OutItems) const
+{
+	if (!ItemType.IsValid())
+	{
+		OutItems.Append(Items);
+		return;
+	}
+
+	if (const FTypeRange* Range = TypeRanges.Find(ItemType))
+	{
+		OutItems.Append(Items.GetData() + Range->FirstIndex, Range->NumSlots);
+	}
+}
+
+namespace RPGInventoryItemIndex
+{
+	/** 按价格排序，价格相同时按资产名称，保证顺序稳定 */
+	/** Orders by price, ties broken by asset name so the order is stable */
+	static bool PriceLess(int32 PriceA, const URPGItem* A, int32 PriceB, const URPGItem* B)
+	{
+		if (PriceA != PriceB)
+		{
+			return PriceA < PriceB;
+		}
+		return A->GetFName().LexicalLess(B->GetFName());
+	}
+
+	/** Orders by user-visible name, ties broken by asset name */
+	static bool NameLess(const FText& NameA, const URPGItem* A, const FText& NameB, const URPGItem* B)
+	{
+		const int32 Result = NameA.CompareTo(NameB);
+		if (Result != 0)
+		{
+			return Result < 0;
+		}
+		return A->GetFName().LexicalLess(B->GetFName());
+	}
+
+	/** 合并多个有序数组，比较函数同时收到两个道具所在的数组的下标 */
+	/**
+	 * Merges already sorted arrays, there is one per item type so this is a short k-way merge
+	 * The predicate also receives the source index of each item, so it can compare on the keys the source was sorted by
+	 */
+	template <typename PredicateType>
+	static void MergeSorted(const TArray<const TArray<URPGItem*>*>& Sources, TArray<URPGItem*>& OutItems, PredicateType Predicate)
+	{
+		TArray<int32, TInlineAllocator<8>> Cursors;
+		Cursors.AddZeroed(Sources.Num());
+
+		for (;;)
+		{
+			int32 BestSource = INDEX_NONE;
+			for (int32 SourceIndex = 0; SourceIndex < Sources.Num(); SourceIndex++)
+			{
+				const TArray<URPGItem*>& Source = *Sources[SourceIndex];
+				if (Cursors[SourceIndex] < Source.Num()
+					&& (BestSource == INDEX_NONE || Predicate(SourceIndex, Source[Cursors[SourceIndex]], BestSource, (*Sources[BestSource])[Cursors[BestSource]])))
+				{
+					BestSource = SourceIndex;
+				}
+			}
+
+			if (BestSource == INDEX_NONE)
+			{
+				return;
+			}
+
+			OutItems.Add((*Sources[BestSource])[Cursors[BestSource]++]);
+		}
+	}
+}
+
+const TArray<URPGItem*>& FRPGInventoryItemIndex::FBucket::GetOrder(ERPGInventorySortOrder SortOrder) const
+{
+	switch (SortOrder)
+	{
+	case ERPGInventorySortOrder::Price:
+		return ByPrice;
+	case ERPGInventorySortOrder::Name:
+		return ByName;
+	default:
+		return Items;
+	}
+}
+
+bool FRPGInventoryItemIndex::FBucket::PriceLess(const URPGItem* A, const URPGItem* B) const
+{
+	return RPGInventoryItemIndex::PriceLess(Entries.FindChecked(A).Price, A, Entries.FindChecked(B).Price, B);
+}
+
+bool FRPGInventoryItemIndex::FBucket::NameLess(const URPGItem* A, const URPGItem* B) const
+{
+	return RPGInventoryItemIndex::NameLess(Entries.FindChecked(A).ItemName, A, Entries.FindChecked(B).ItemName, B);
+}
+
+void FRPGInventoryItemIndex::Add(URPGItem* Item)
+{
+	check(Item);
+	FBucket& Bucket = Buckets.FindOrAdd(Item->GetPrimaryAssetId().PrimaryAssetType);
+	check(!Bucket.Entries.Contains(Item));
+
+	FBucket::FEntry& Entry = Bucket.Entries.Add(Item);
+	Entry.Position = Bucket.Items.Add(Item);
+	Entry.Price = Item->Price;
+	Entry.ItemName = Item->ItemName;
+
+	Bucket.ByPrice.Insert(Item, Algo::LowerBound(Bucket.ByPrice, Item, [&Bucket](const URPGItem* A, const URPGItem* B)
+	{
+		return Bucket.PriceLess(A, B);
+	}));
+	Bucket.ByName.Insert(Item, Algo::LowerBound(Bucket.ByName, Item, [&Bucket](const URPGItem* A, const URPGItem* B)
+	{
+		return Bucket.NameLess(A, B);
+	}));
+}
+
+void FRPGInventoryItemIndex::Remove(URPGItem* Item)
+{
+	check(Item);
+	FBucket* Bucket = Buckets.Find(Item->GetPrimaryAssetId().PrimaryAssetType);
+	const FBucket::FEntry* Entry = Bucket ? Bucket->Entries.Find(Item) : nullptr;
+	if (!Entry)
+	{
+		return;
+	}
+
+	// 最后一个道具移到空出的位置
+	// The last item moves into the freed position
+	const int32 Position = Entry->Position;
+	Bucket->Items.RemoveAtSwap(Position, 1, false);
+	if (Bucket->Items.IsValidIndex(Position))
+	{
+		Bucket->Entries.FindChecked(Bucket->Items[Position]).Position = Position;
+	}
+
+	// 有序数组用加入时的价格和名称查找，即使道具的数据之后被修改过也能找到
+	// The sorted arrays are searched with the price and name recorded on insertion, so the item is found even if its data changed since
+	const int32 PriceIndex = Algo::LowerBound(Bucket->ByPrice, Item, [Bucket](const URPGItem* A, const URPGItem* B)
+	{
+		return Bucket->PriceLess(A, B);
+	});
+	check(Bucket->ByPrice[PriceIndex] == Item);
+	Bucket->ByPrice.RemoveAt(PriceIndex, 1, false);
+
+	const int32 NameIndex = Algo::LowerBound(Bucket->ByName, Item, [Bucket](const URPGItem* A, const URPGItem* B)
+	{
+		return Bucket->NameLess(A, B);
+	});
+	check(Bucket->ByName[NameIndex] == Item);
+	Bucket->ByName.RemoveAt(NameIndex, 1, false);
+
+	Bucket->Entries.Remove(Item);
+}
+
+void FRPGInventoryItemIndex::Reset()
+{
+	Buckets.Reset();
+}
+
+void FRPGInventoryItemIndex::GetItems(const FPrimaryAssetType& ItemType, ERPGInventorySortOrder SortOrder, TArray<URPGItem*>& OutItems) const
+{
+	if (ItemType.IsValid())
+	{
+		if (const FBucket* Bucket = Buckets.Find(ItemType))
+		{
+			OutItems.Append(Bucket->GetOrder(SortOrder));
+		}
+		return;
+	}
+
+	OutItems.Reserve(OutItems.Num() + Num(ItemType));
+
+	// 没有排序时直接按类型拼接，有排序时需要合并各个桶
+	// Unsorted queries concatenate the buckets, sorted ones merge them
+	if (SortOrder == ERPGInventorySortOrder::None)
+	{
+		for (const TPair<FPrimaryAssetType, FBucket>& Pair : Buckets)
+		{
+			OutItems.Append(Pair.Value.Items);
+		}
+		return;
+	}
+
+	TArray<const TArray<URPGItem*>*> Sources;
+	TArray<const FBucket*, TInlineAllocator<8>> SourceBuckets;
+	for (const TPair<FPrimaryAssetType, FBucket>& Pair : Buckets)
+	{
+		Sources.Add(&Pair.Value.GetOrder(SortOrder));
+		SourceBuckets.Add(&Pair.Value);
+	}
+
+	// 和桶内的排序一样使用加入时记录的数据，道具的数据在运行时改变也不会打乱顺序
+	// Compare on the keys recorded in each item's bucket like the bucket orders do, so runtime changes to an item cannot break the merge
+	if (SortOrder == ERPGInventorySortOrder::Price)
+	{
+		RPGInventoryItemIndex::MergeSorted(Sources, OutItems, [&SourceBuckets](int32 SourceA, const URPGItem* A, int32 SourceB, const URPGItem* B)
+		{
+			return RPGInventoryItemIndex::PriceLess(SourceBuckets[SourceA]->Entries.FindChecked(A).Price, A, SourceBuckets[SourceB]->Entries.FindChecked(B).Price, B);
+		});
+	}
+	else
+	{
+		RPGInventoryItemIndex::MergeSorted(Sources, OutItems, [&SourceBuckets](int32 SourceA, const URPGItem* A, int32 SourceB, const URPGItem* B)
+		{
+			return RPGInventoryItemIndex::NameLess(SourceBuckets[SourceA]->Entries.FindChecked(A).ItemName, A, SourceBuckets[SourceB]->Entries.FindChecked(B).ItemName, B);
+		});
+	}
+}
+
+int32 FRPGInventoryItemIndex::Num(const FPrimaryAssetType& ItemType) const
+{
+	if (ItemType.IsValid())
+	{
+		const FBucket* Bucket = Buckets.Find(ItemType);
+		return Bucket ? Bucket->Items.Num() : 0;
+	}
+
+	int32 Count = 0;
+	for (const TPair<FPrimaryAssetType, FBucket>& Pair : Buckets)
+	{
+		Count += Pair.Value.Items.Num();
+	}
+	return Count;
+}
@@ -5,6 +5,10 @@
 #include "RPGGameInstanceBase.h"
 #include "RPGSaveGame.h"
 #include "Items/RPGItem.h"
+#include "Misc/CoreDelegates.h"
+
+DECLARE_CYCLE_STAT(TEXT("SaveInventory"), STAT_SaveInventory, STATGROUP_RPGInventory);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Saved Inventory Entries"), STAT_SavedInventoryEntries, STATGROUP_RPGInventory);
 
 bool ARPGPlayerControllerBase::AddInventoryItem(URPGItem* NewItem, int32 ItemCount, int32 ItemLevel, bool bAutoSlot)
 {
@@ -21,6 +25,28 @@ bool ARPGPlayerControllerBase::AddInventoryItem(URPGItem* NewItem, int32 ItemCou
 		return false;
 	}
 
+	// 客户端把请求发给服务器，结果通过复制返回
+	// Clients forward the request to the server, the result comes back through replication
+	if (!CanModifyInventory())
+	{
+		ServerAddInventoryItem(NewItem->GetPrimaryAssetId(), ItemCount, ItemLevel, bAutoSlot);
+		return true;
+	}
+
+	// 异步加载期间的修改在加载完成后应用到加载的背包上
+	// Changes requested during an async load are applied on top of the loaded inventory once it was filled
+	if (bInventoryLoading)
+	{
+		FRPGQueuedInventoryChange Change;
+		Change.Type = FRPGQueuedInventoryChange::EType::Add;
+		Change.Item = NewItem;
+		Change.ItemCount = ItemCount;
+		Change.ItemLevel = ItemLevel;
+		Change.bAutoSlot = bAutoSlot;
+		QueueInventoryChange(Change);
+		return true;
+	}
+
 	// 获得原来的道具数据
 	// Find current item data, which may be empty
 	FRPGItemData OldData;
@@ -35,7 +61,7 @@ bool ARPGPlayerControllerBase::AddInventoryItem(URPGItem* NewItem, int32 ItemCou
 	if (OldData != NewData)
 	{
 		// If data changed, need to update storage and call callback
-		InventoryData.Add(NewItem, NewData);
+		SetInventoryItemData(NewItem, NewData);
 		NotifyInventoryItemChanged(true, NewItem);
 		bChanged = true;
 	}
@@ -64,6 +90,24 @@ bool ARPGPlayerControllerBase::RemoveInventoryItem(URPGItem* RemovedItem, int32
 		return false;
 	}
 
+	if (!CanModifyInventory())
+	{
+		ServerRemoveInventoryItem(RemovedItem->GetPrimaryAssetId(), RemoveCount);
+		return true;
+	}
+
+	// 要移除的道具可能还在加载中
+	// The item to remove may still be loading
+	if (bInventoryLoading)
+	{
+		FRPGQueuedInventoryChange Change;
+		Change.Type = FRPGQueuedInventoryChange::EType::Remove;
+		Change.Item = RemovedItem;
+		Change.ItemCount = RemoveCount;
+		QueueInventoryChange(Change);
+		return true;
+	}
+
 	// Find current item data, which may be empty
 	FRPGItemData NewData;
 	GetInventoryItemData(RemovedItem, NewData);
@@ -87,22 +131,22 @@ bool ARPGPlayerControllerBase::RemoveInventoryItem(URPGItem* RemovedItem, int32
 	if (NewData.ItemCount > 0)
 	{
 		// Update data with new count
-		InventoryData.Add(RemovedItem, NewData);
+		SetInventoryItemData(RemovedItem, NewData);
 	}
 	else
 	{
 		// 把道具从背包中移除
 		// Remove item entirely, make sure it is unslotted
-		InventoryData.Remove(RemovedItem);
+		RemoveInventoryItemData(RemovedItem);
 
-		// 把道具从装备的插槽中移除
-		for (TPair<FRPGItemSlot, URPGItem*>& Pair : SlottedItems)
+		// 把道具从装备的插槽中移除，没有装备时不需要遍历插槽
+		// Only slots holding the item are visited, nothing is scanned if it was not slotted
+		TArray<FRPGItemSlot> OldSlots;
+		SlotTable.FindSlotsWithItem(RemovedItem, OldSlots);
+		for (const FRPGItemSlot& OldSlot : OldSlots)
 		{
-			if (Pair.Value == RemovedItem)
-			{
-				Pair.Value = nullptr;
-				NotifySlottedItemChanged(Pair.Key, Pair.Value);
-			}
+			SetSlottedItemData(OldSlot, nullptr);
+			NotifySlottedItemChanged(OldSlot, nullptr);
 		}
 	}
 
@@ -115,56 +159,64 @@ bool ARPGPlayerControllerBase::RemoveInventoryItem(URPGItem* RemovedItem, int32
 
 void ARPGPlayerControllerBase::GetInventoryItems(TArray<URPGItem*>& Items, FPrimaryAssetType ItemType)
 {
-	for (const TPair<URPGItem*, FRPGItemData>& Pair : InventoryData)
-	{
-		if (Pair.Key)
-		{
-			FPrimaryAssetId AssetId = Pair.Key->GetPrimaryAssetId();
+	// 按类型分好的索引，不需要遍历整个 InventoryStore
+	// Filters based on item type using the per-type index instead of scanning InventoryStore
+	InventoryIndex.GetItems(ItemType, ERPGInventorySortOrder::None, Items);
+}
 
-			// Filters based on item type
-			if (AssetId.PrimaryAssetType == ItemType || !ItemType.IsValid())
-			{
-				Items.Add(Pair.Key);
-			}
-		}	
-	}
+void ARPGPlayerControllerBase::GetSortedInventoryItems(TArray<URPGItem*>& Items, FPrimaryAssetType ItemType, ERPGInventorySortOrder SortOrder)
+{
+	InventoryIndex.GetItems(ItemType, SortOrder, Items);
 }
 
 bool ARPGPlayerControllerBase::SetSlottedItem(const FRPGItemSlot& ItemSlot, URPGItem* Item)
 {
-	// Iterate entire inventory because we need to remove from old slot
-	bool bFound = false;
-	for (TPair<FRPGItemSlot, URPGItem*>& Pair : SlottedItems)
+	if (!CanModifyInventory())
 	{
-		// 找到了需要放入道具的插槽，需要更新
-		if (Pair.Key == ItemSlot)
-		{
-			// Add to new slot
-			bFound = true;
-			Pair.Value = Item;
-			NotifySlottedItemChanged(Pair.Key, Pair.Value);
-		}
-		// 这个道具之前放在了其他的插槽中，需要移除
-		else if (Item != nullptr && Pair.Value == Item)
-		{
-			// If this item was found in another slot, remove it
-			Pair.Value = nullptr;
-			NotifySlottedItemChanged(Pair.Key, Pair.Value);
-		}
+		ServerSetSlottedItem(ItemSlot, Item ? Item->GetPrimaryAssetId() : FPrimaryAssetId());
+		return true;
 	}
 
-	if (bFound)
+	if (SlotTable.GetSlotIndex(ItemSlot) == INDEX_NONE)
 	{
-		SaveInventory();
+		return false;
+	}
+
+	if (bInventoryLoading)
+	{
+		FRPGQueuedInventoryChange Change;
+		Change.Type = FRPGQueuedInventoryChange::EType::SetSlot;
+		Change.Item = Item;
+		Change.ItemSlot = ItemSlot;
+		QueueInventoryChange(Change);
 		return true;
 	}
 
-	return false;
+	// 这个道具之前放在了其他的插槽中，需要移除
+	// If this item was found in another slot, remove it
+	TArray<FRPGItemSlot> OldSlots;
+	SlotTable.FindSlotsWithItem(Item, OldSlots);
+	for (const FRPGItemSlot& OldSlot : OldSlots)
+	{
+		if (OldSlot != ItemSlot)
+		{
+			SetSlottedItemData(OldSlot, nullptr);
+			NotifySlottedItemChanged(OldSlot, nullptr);
+		}
+	}
+
+	// 找到了需要放入道具的插槽，需要更新
+	// Add to new slot
+	SetSlottedItemData(ItemSlot, Item);
+	NotifySlottedItemChanged(ItemSlot, Item);
+
+	SaveInventory();
+	return true;
 }
 
 int32 ARPGPlayerControllerBase::GetInventoryItemCount(const URPGItem* Item) const
 {
-	const FRPGItemData* FoundItem = InventoryData.Find(Item);
+	const FRPGItemData* FoundItem = InventoryStore.Find(Item);
 
 	if (FoundItem)
 	{
@@ -175,7 +227,7 @@ int32 ARPGPlayerControllerBase::GetInventoryItemCount(const URPGItem* Item) cons
 
 bool ARPGPlayerControllerBase::GetInventoryItemData(const URPGItem* Item, FRPGItemData& ItemData) const
 {
-	const FRPGItemData* FoundItem = InventoryData.Find(Item);
+	const FRPGItemData* FoundItem = InventoryStore.Find(Item);
 
 	if (FoundItem)
 	{
@@ -188,32 +240,35 @@ bool ARPGPlayerControllerBase::GetInventoryItemData(const URPGItem* Item, FRPGIt
 
 URPGItem* ARPGPlayerControllerBase::GetSlottedItem(const FRPGItemSlot& ItemSlot) const
 {
-	URPGItem* const* FoundItem = SlottedItems.Find(ItemSlot);
-
-	if (FoundItem)
-	{
-		return *FoundItem;
-	}
-	return nullptr;
+	return SlotTable.GetItem(ItemSlot);
 }
 
 void ARPGPlayerControllerBase::GetSlottedItems(TArray<URPGItem*>& Items, FPrimaryAssetType ItemType, bool bOutputEmptyIndexes)
 {
-	for (TPair<FRPGItemSlot, URPGItem*>& Pair : SlottedItems)
-	{
-		if (Pair.Key.ItemType == ItemType || !ItemType.IsValid())
-		{
-			Items.Add(Pair.Value);
-		}
-	}
+	// 同一类型的插槽在表中是连续的，直接拷贝
+	// Slots of a type are contiguous in the table, so this is a straight copy
+	SlotTable.GetItems(ItemType, Items);
 }
 
 void ARPGPlayerControllerBase::FillEmptySlots()
 {
+	if (!CanModifyInventory())
+	{
+		ServerFillEmptySlots();
+		return;
+	}
+
+	// 异步加载完成时会填充空的插槽
+	// The async load fills empty slots itself once it completes
+	if (bInventoryLoading)
+	{
+		return;
+	}
+
 	bool bShouldSave = false;
-	for (const TPair<URPGItem*, FRPGItemData>& Pair : InventoryData)
+	for (FRPGCompactInventory::FConstIterator It = InventoryStore.CreateConstIterator(); It; ++It)
 	{
-		bShouldSave |= FillEmptySlotWithItem(Pair.Key);
+		bShouldSave |= FillEmptySlotWithItem(It.GetItem());
 	}
 
 	if (bShouldSave)
@@ -224,6 +279,36 @@ void ARPGPlayerControllerBase::FillEmptySlots()
 
 bool ARPGPlayerControllerBase::SaveInventory()
 {
+	// 异步加载期间背包只有一部分，完整重建会覆盖存档中的背包，脏数据保留到加载完成
+	// During an async load the inventory is partial and a rebuild would overwrite the saved one, the dirty state stays pending until the fill
+	if (bInventoryLoading)
+	{
+		return false;
+	}
+
+	// 事务中的保存推迟到提交时进行
+	// Saves requested inside a transaction are deferred to the commit
+	if (InventoryTransactionDepth > 0)
+	{
+		bTransactionSaveRequested = true;
+		return true;
+	}
+
+	// 客户端的背包来自服务器，服务器上的远程玩家不使用本地存档，都不写存档
+	// A client's inventory comes from the server and remote players on a server are not persisted locally, neither writes the save game
+	if (!UsesLocalSaveGame())
+	{
+		DirtyInventoryItems.Reset();
+		DirtySlots.Reset();
+		return false;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_SaveInventory);
+
+	// 每次改变都会保存，所以在这里检查索引是否一致
+	// Every mutation ends in a save, so this is where index drift is caught in slow-guard builds
+	checkSlow(ValidateInventoryIndices());
+
 	// 获得 World 和 GameInstance
     const UWorld* World = GetWorld();
 	URPGGameInstanceBase* GameInstance = World ? World->GetGameInstance<URPGGameInstanceBase>() : nullptr;
@@ -236,40 +321,88 @@ bool ARPGPlayerControllerBase::SaveInventory()
 	URPGSaveGame* CurrentSaveGame = GameInstance->GetCurrentSaveGame();
 	if (CurrentSaveGame)
 	{
-		// 清空 CurrentSaveGame 中缓存的数据
-		// Reset cached data in save game before writing to it
-		CurrentSaveGame->InventoryData.Reset();
-		CurrentSaveGame->SlottedItems.Reset();
+		// 存档对象被替换了（加载 / 重置），之前的增量已经没有意义，需要完整重建
+		// If the save object was replaced since our last write, the patches we track are relative to the wrong object
+		if (LastSavedSaveGame.Get() != CurrentSaveGame)
+		{
+			bInventoryFullyDirty = true;
+		}
 
-		for (const TPair<URPGItem*, FRPGItemData>& ItemPair : InventoryData)
+		const bool bWriteSnapshot = bInventoryFullyDirty;
+		if (bWriteSnapshot)
 		{
-			if (ItemPair.Key)
-			{
-				FPrimaryAssetId AssetId;
-				AssetId = ItemPair.Key->GetPrimaryAssetId();
+			// 清空 CurrentSaveGame 中缓存的数据
+			// Reset cached data in save game before writing to it
+			CurrentSaveGame->InventoryData.Reset();
+			CurrentSaveGame->SlottedItems.Reset();
 
+			CurrentSaveGame->InventoryData.Reserve(InventoryStore.Num());
+			for (FRPGCompactInventory::FConstIterator It = InventoryStore.CreateConstIterator(); It; ++It)
+			{
 				// 在 SaveGame 中的 URPGItem 由其 AssetId 代替
-				CurrentSaveGame->InventoryData.Add(AssetId, ItemPair.Value);
+				CurrentSaveGame->InventoryData.Add(It.GetItem()->GetPrimaryAssetId(), It.GetItemData());
+			}
+
+			for (const TPair<FRPGItemSlot, URPGItem*>& SlotPair : SlottedItems)
+			{
+				// 空插槽也要保存，值是无效的 AssetId
+				// Empty slots are saved too, as an invalid id
+				CurrentSaveGame->SlottedItems.Add(SlotPair.Key, SlotPair.Value ? SlotPair.Value->GetPrimaryAssetId() : FPrimaryAssetId());
 			}
-		}
 
-		for (const TPair<FRPGItemSlot, URPGItem*>& SlotPair : SlottedItems)
+			INC_DWORD_STAT_BY(STAT_SavedInventoryEntries, InventoryStore.Num() + SlottedItems.Num());
+			GameInstance->RequestFullSaveSync();
+		}
+		else
 		{
-			FPrimaryAssetId AssetId;
+			// 只更新改变过的道具，已经不在背包中的道具需要从存档中移除
+			// Patch only the entries that changed, items no longer in the inventory are removed from the save
+			for (URPGItem* DirtyItem : DirtyInventoryItems)
+			{
+				if (!DirtyItem)
+				{
+					continue;
+				}
 
-			if (SlotPair.Value)
+				const FPrimaryAssetId AssetId = DirtyItem->GetPrimaryAssetId();
+				const FRPGItemData* FoundData = InventoryStore.Find(DirtyItem);
+				if (FoundData)
+				{
+					CurrentSaveGame->InventoryData.Add(AssetId, *FoundData);
+				}
+				else
+				{
+					CurrentSaveGame->InventoryData.Remove(AssetId);
+				}
+				GameInstance->JournalInventoryItem(AssetId, FoundData);
+			}
+
+			for (const FRPGItemSlot& DirtySlot : DirtySlots)
 			{
-				AssetId = SlotPair.Value->GetPrimaryAssetId();
+				const URPGItem* SlottedItem = GetSlottedItem(DirtySlot);
+				const FPrimaryAssetId AssetId = SlottedItem ? SlottedItem->GetPrimaryAssetId() : FPrimaryAssetId();
+				CurrentSaveGame->SlottedItems.Add(DirtySlot, AssetId);
+				GameInstance->JournalSlottedItem(DirtySlot, AssetId);
 			}
 
-			// TODO 这行为什么不在 if 里？
-			// 在 SaveGame 中的 URPGItem 由其 AssetId 代替
-			CurrentSaveGame->SlottedItems.Add(SlotPair.Key, AssetId);
+			INC_DWORD_STAT_BY(STAT_SavedInventoryEntries, DirtyInventoryItems.Num() + DirtySlots.Num());
 		}
 
-		// 写入硬盘
-		// Now that cache is updated, write to disk
-		GameInstance->WriteSaveGame();
+		DirtyInventoryItems.Reset();
+		DirtySlots.Reset();
+		bInventoryFullyDirty = false;
+		LastSavedSaveGame = CurrentSaveGame;
+
+		// 写入硬盘，增量的改变在启用日志时只会追加记录
+		// Now that cache is updated, write to disk. With the save journal enabled a patch only appends its records
+		if (bWriteSnapshot)
+		{
+			GameInstance->WriteSaveGame();
+		}
+		else
+		{
+			GameInstance->AppendSaveJournal();
+		}
 		return true;
 	}
 	return false;
@@ -277,8 +410,33 @@ bool ARPGPlayerControllerBase::SaveInventory()
 
 bool ARPGPlayerControllerBase::LoadInventory()
 {
-	InventoryData.Reset();
+	InventoryStore.Reset();
+	bInventoryDataViewStale = true;
+	InventoryIndex.Reset();
 	SlottedItems.Reset();
+	SlotTable.Reset();
+
+	// 客户端会通过复制收到移除和之后重新添加的条目
+	// Clients receive the removals and the entries added back by the fill
+	if (ShouldReplicateInventory())
+	{
+		ReplicatedInventory.Reset();
+		ReplicatedSlots.Reset();
+	}
+
+	// 背包被整体替换，下一次保存需要完整重建
+	// The whole inventory is replaced, so the next save has to rebuild
+	MarkInventoryFullyDirty();
+
+	// 取消之前还没完成的异步加载
+	// Cancel any async load that has not finished yet
+	InventoryLoadSerial++;
+	bInventoryLoading = false;
+	if (InventoryLoadHandle.IsValid())
+	{
+		InventoryLoadHandle->CancelHandle();
+		InventoryLoadHandle.Reset();
+	}
 
 	// Fill in slots from game instance
 	const UWorld* World = GetWorld();
@@ -289,14 +447,15 @@ bool ARPGPlayerControllerBase::LoadInventory()
 		return false;
 	}
 
-	// 绑定回调
-	// Bind to loaded callback if not already bound
-	if (!GameInstance->OnSaveGameLoadedNative.IsBoundToObject(this))
+	// 绑定回调，远程玩家的背包和本地存档无关
+	// Bind to loaded callback if not already bound, remote players' inventories do not follow the local save game
+	if (IsLocalController() && !GameInstance->OnSaveGameLoadedNative.IsBoundToObject(this))
 	{
 		GameInstance->OnSaveGameLoadedNative.AddUObject(this, &ARPGPlayerControllerBase::HandleSaveGameLoaded);
 	}
 
 	// 初始化 SlottedItems
+	SlotTable.Initialize(GameInstance->ItemSlotsPerType);
 	for (const TPair<FPrimaryAssetType, int32>& Pair : GameInstance->ItemSlotsPerType)
 	{
 		for (int32 SlotNumber = 0; SlotNumber < Pair.Value; SlotNumber++)
@@ -305,90 +464,242 @@ bool ARPGPlayerControllerBase::LoadInventory()
 		}
 	}
 
+	// 客户端不读存档，使用服务器复制过来的背包
+	// Clients do not read the save game, they rebuild from what the server replicated so far
+	if (GetNetMode() == NM_Client)
+	{
+		FillInventoryFromReplicatedData();
+		NotifyInventoryLoaded();
+		return true;
+	}
+
+	// 远程玩家的背包从空开始，不读取本地玩家的存档
+	// Remote players start with an empty inventory instead of reading the local player's save game
+	if (!UsesLocalSaveGame())
+	{
+		NotifyInventoryLoaded();
+		return true;
+	}
+
 	URPGSaveGame* CurrentSaveGame = GameInstance->GetCurrentSaveGame();
-	const URPGAssetManager& AssetManager = URPGAssetManager::Get();
 	if (CurrentSaveGame)
 	{
-		// 从当前的存档中加载 InventoryData
-		// Copy from save game into controller data
-		bool bFoundAnySlots = false;
-		for (const TPair<FPrimaryAssetId, FRPGItemData>& ItemPair : CurrentSaveGame->InventoryData)
+		if (bLoadInventoryAsync)
 		{
-			// 根据 FPrimaryAssetId 加载 URPGItem
-			URPGItem* LoadedItem = AssetManager.ForceLoadItem(ItemPair.Key);
-
-			if (LoadedItem != nullptr)
+			// 收集存档中用到的全部道具，用一次请求异步加载
+			// Gather every saved item id so they stream in with a single request
+			TArray<FPrimaryAssetId> ItemIds;
+			CurrentSaveGame->InventoryData.GetKeys(ItemIds);
+			for (const TPair<FRPGItemSlot, FPrimaryAssetId>& SlotPair : CurrentSaveGame->SlottedItems)
 			{
-				InventoryData.Add(LoadedItem, ItemPair.Value);
+				if (SlotPair.Value.IsValid())
+				{
+					ItemIds.AddUnique(SlotPair.Value);
+				}
 			}
-		}
 
-		// 从当前的存档中加载 SlottedItems
-		for (const TPair<FRPGItemSlot, FPrimaryAssetId>& SlotPair : CurrentSaveGame->SlottedItems)
-		{
-			if (SlotPair.Value.IsValid())
+			const int32 LoadSerial = InventoryLoadSerial;
+			bInventoryLoading = true;
+
+			// 如果所有道具都已经在内存中，回调会在 LoadItemsAsync 返回之前被调用
+			// The delegate runs before LoadItemsAsync returns if everything is already in memory
+			TSharedPtr<FStreamableHandle> Handle = URPGAssetManager::Get().LoadItemsAsync(ItemIds, URPGAssetManager::Get().GetPhaseBundles(),
+				FRPGItemsLoadedDelegate::CreateUObject(this, &ARPGPlayerControllerBase::HandleInventoryItemsLoaded, LoadSerial, TWeakObjectPtr<URPGSaveGame>(CurrentSaveGame)));
+
+			if (bInventoryLoading && LoadSerial == InventoryLoadSerial)
 			{
-				// 根据 FPrimaryAssetId 加载 URPGItem
-				URPGItem* LoadedItem = AssetManager.ForceLoadItem(SlotPair.Value);
-				
-				if (GameInstance->IsValidItemSlot(SlotPair.Key) && LoadedItem)
+				if (Handle.IsValid() && !Handle->HasLoadCompleted())
 				{
-					SlottedItems.Add(SlotPair.Key, LoadedItem);
-					bFoundAnySlots = true;
+					InventoryLoadHandle = Handle;
+				}
+				else
+				{
+					// 没有收到加载的道具，同步加载
+					// No items were delivered, fall back to loading them synchronously
+					bInventoryLoading = false;
+					FillInventoryFromSaveGame(GameInstance, CurrentSaveGame, nullptr);
 				}
 			}
-		}
 
-		// 这里的逻辑是装备插槽应该尽可能装备道具
-		if (!bFoundAnySlots)
-		{
-			// Auto slot items as no slots were saved
-			FillEmptySlots();
+			return true;
 		}
 
-		NotifyInventoryLoaded();
+		FillInventoryFromSaveGame(GameInstance, CurrentSaveGame, nullptr);
 
 		return true;
 	}
 
-	// 加载存档失败了，但是已经清空了 InventoryData 和 SlottedItems ，所以需要通知 UI
+	// 加载存档失败了，但是已经清空了 InventoryStore 和 SlottedItems ，所以需要通知 UI
 	// Load failed but we reset inventory, so need to notify UI
 	NotifyInventoryLoaded();
+	ApplyQueuedInventoryChanges();
 
 	return false;
 }
 
-bool ARPGPlayerControllerBase::FillEmptySlotWithItem(URPGItem* NewItem)
+bool ARPGPlayerControllerBase::IsInventoryLoading() const
 {
-	// Look for an empty item slot to fill with this item
-	const FPrimaryAssetType NewItemType = NewItem->GetPrimaryAssetId().PrimaryAssetType;
-	FRPGItemSlot EmptySlot;
-	for (TPair<FRPGItemSlot, URPGItem*>& Pair : SlottedItems)
+	return bInventoryLoading;
+}
+
+void ARPGPlayerControllerBase::FillInventoryFromSaveGame(URPGGameInstanceBase* GameInstance, URPGSaveGame* SaveGame, const TArray<URPGItem*>* PreloadedItems)
+{
+	URPGAssetManager& AssetManager = URPGAssetManager::Get();
+
+	// 预加载的道具按 FPrimaryAssetId 查找，加载失败的道具已经由 LoadItemsAsync 报告过了
+	// Preloaded items are looked up by id, items that failed to load were already reported by LoadItemsAsync
+	TMap<FPrimaryAssetId, URPGItem*> PreloadedItemMap;
+	if (PreloadedItems)
 	{
-		if (Pair.Key.ItemType == NewItemType)
+		PreloadedItemMap.Reserve(PreloadedItems->Num());
+		for (URPGItem* Item : *PreloadedItems)
 		{
-			if (Pair.Value == NewItem)
+			PreloadedItemMap.Add(Item->GetPrimaryAssetId(), Item);
+		}
+	}
+
+	// 根据 FPrimaryAssetId 获得 URPGItem
+	// Resolves an id to an item, synchronously loading it if nothing was preloaded
+	auto ResolveItem = [&AssetManager, &PreloadedItemMap, PreloadedItems](const FPrimaryAssetId& ItemId) -> URPGItem*
+	{
+		if (PreloadedItems)
+		{
+			return PreloadedItemMap.FindRef(ItemId);
+		}
+		return AssetManager.ForceLoadItem(ItemId);
+	};
+
+	// 从当前的存档中加载 InventoryStore
+	// Copy from save game into controller data
+	bool bFoundAnySlots = false;
+	for (const TPair<FPrimaryAssetId, FRPGItemData>& ItemPair : SaveGame->InventoryData)
+	{
+		URPGItem* LoadedItem = ResolveItem(ItemPair.Key);
+
+		if (LoadedItem != nullptr)
+		{
+			SetInventoryItemData(LoadedItem, ItemPair.Value);
+		}
+	}
+
+	// 从当前的存档中加载 SlottedItems
+	for (const TPair<FRPGItemSlot, FPrimaryAssetId>& SlotPair : SaveGame->SlottedItems)
+	{
+		if (SlotPair.Value.IsValid())
+		{
+			URPGItem* LoadedItem = ResolveItem(SlotPair.Value);
+
+			if (GameInstance->IsValidItemSlot(SlotPair.Key) && LoadedItem)
 			{
-				// Item is already slotted
-				return false;
+				SetSlottedItemData(SlotPair.Key, LoadedItem);
+				bFoundAnySlots = true;
 			}
+		}
+	}
+
+	// 这里的逻辑是装备插槽应该尽可能装备道具
+	if (!bFoundAnySlots)
+	{
+		// Auto slot items as no slots were saved
+		FillEmptySlots();
+	}
+
+	// 整个背包被替换了，监听者会通过 OnInventoryLoaded 整体刷新，不需要再逐个报告填充时的改变
+	// The whole inventory was replaced and listeners refresh from OnInventoryLoaded, so the fill is not reported entry by entry
+	DeferredChanges.Reset();
+
+	NotifyInventoryLoaded();
+
+	// 加载期间请求的修改在加载的背包上应用，监听者在整体刷新之后收到这些改变
+	// Changes requested during the load go on top of the loaded inventory, listeners get them after the full refresh
+	ApplyQueuedInventoryChanges();
+}
+
+void ARPGPlayerControllerBase::QueueInventoryChange(const FRPGQueuedInventoryChange& Change)
+{
+	check(bInventoryLoading);
+	QueuedInventoryChanges.Add(Change);
+}
+
+void ARPGPlayerControllerBase::ApplyQueuedInventoryChanges()
+{
+	if (QueuedInventoryChanges.Num() == 0)
+	{
+		return;
+	}
+
+	// 先移出，应用时不会再排队
+	// Move the queue out first, nothing is queued while it is applied
+	const TArray<FRPGQueuedInventoryChange> Changes = MoveTemp(QueuedInventoryChanges);
+	QueuedInventoryChanges.Reset();
 
-			// 找到空的且 SlotNumber 尽量小的 slot
-			// 如果 Pair.Key 无效，逻辑会有问题（存在可装备的 slot 但最后没有装备） ，所以这里应该是认为 SlottedItems 中的 Key 都是 Valid 的
-			// （这很合理因为 SlottedItems 只会在 ARPGPlayerControllerBase::LoadInventory() 中 Add ，且 Key 保证有效）
-			// 那么 EmptySlot.IsValid() 就只会在 EmptySlot 从未被赋值时返回 false （因为默认构造的 SlotNumber = -1）
-			if (Pair.Value == nullptr && (!EmptySlot.IsValid() || EmptySlot.SlotNumber > Pair.Key.SlotNumber))
+	FRPGScopedInventoryTransaction Transaction(this);
+	for (const FRPGQueuedInventoryChange& Change : Changes)
+	{
+		switch (Change.Type)
+		{
+		case FRPGQueuedInventoryChange::EType::Add:
+			if (Change.Item)
+			{
+				AddInventoryItem(Change.Item, Change.ItemCount, Change.ItemLevel, Change.bAutoSlot);
+			}
+			break;
+		case FRPGQueuedInventoryChange::EType::Remove:
+			if (Change.Item)
 			{
-				// We found an empty slot worth filling
-				EmptySlot = Pair.Key;
+				RemoveInventoryItem(Change.Item, Change.ItemCount);
 			}
+			break;
+		case FRPGQueuedInventoryChange::EType::SetSlot:
+			SetSlottedItem(Change.ItemSlot, Change.Item);
+			break;
 		}
 	}
+}
+
+void ARPGPlayerControllerBase::HandleInventoryItemsLoaded(const TArray<URPGItem*>& LoadedItems, int32 LoadSerial, TWeakObjectPtr<URPGSaveGame> SaveGame)
+{
+	// 被新的加载替代了
+	// A newer load superseded this one
+	if (!bInventoryLoading || LoadSerial != InventoryLoadSerial)
+	{
+		return;
+	}
+
+	bInventoryLoading = false;
+	InventoryLoadHandle.Reset();
+
+	const UWorld* World = GetWorld();
+	URPGGameInstanceBase* GameInstance = World ? World->GetGameInstance<URPGGameInstanceBase>() : nullptr;
+
+	if (GameInstance && SaveGame.IsValid() && SaveGame.Get() == GameInstance->GetCurrentSaveGame())
+	{
+		FillInventoryFromSaveGame(GameInstance, SaveGame.Get(), &LoadedItems);
+	}
+	else
+	{
+		// 存档在加载期间被替换了，新存档的 HandleSaveGameLoaded 会再次加载，排队的修改留给那次加载
+		// The save was replaced while loading, HandleSaveGameLoaded for the new save will load again and apply the queued changes
+		NotifyInventoryLoaded();
+	}
+}
+
+bool ARPGPlayerControllerBase::FillEmptySlotWithItem(URPGItem* NewItem)
+{
+	if (SlotTable.IsItemSlotted(NewItem))
+	{
+		// Item is already slotted
+		return false;
+	}
+
+	// 找到空的且 SlotNumber 尽量小的 slot ，由插槽表的空位图直接给出
+	// Look for the lowest numbered empty slot of this item's type, straight from the free-slot bitmap
+	const FRPGItemSlot EmptySlot = SlotTable.FindFreeSlot(NewItem->GetPrimaryAssetId().PrimaryAssetType);
 
 	if (EmptySlot.IsValid())
 	{
 		// 这里实际修改 SlottedItems
-		SlottedItems[EmptySlot] = NewItem;
+		SetSlottedItemData(EmptySlot, NewItem);
 		NotifySlottedItemChanged(EmptySlot, NewItem);
 		return true;
 	}
@@ -396,8 +707,323 @@ bool ARPGPlayerControllerBase::FillEmptySlotWithItem(URPGItem* NewItem)
 	return false;
 }
 
+void ARPGPlayerControllerBase::SetInventoryItemData(URPGItem* Item, const FRPGItemData& ItemData)
+{
+	const bool bWasInInventory = !InventoryStore.Set(Item, ItemData);
+	bInventoryDataViewStale = true;
+	DirtyInventoryItems.Add(Item);
+
+	if (!bWasInInventory)
+	{
+		InventoryIndex.Add(Item);
+	}
+
+	if (ShouldReplicateInventory())
+	{
+		ReplicatedInventory.SetItem(Item->GetPrimaryAssetId(), ItemData);
+	}
+
+	if (InventoryTransactionDepth > 0)
+	{
+		PendingTransactionChanges.AddItemChange(Item, bWasInInventory, true);
+	}
+
+	RecordDeferredItemChange(Item, bWasInInventory, true);
+}
+
+void ARPGPlayerControllerBase::RemoveInventoryItemData(URPGItem* Item)
+{
+	if (InventoryStore.Remove(Item))
+	{
+		InventoryIndex.Remove(Item);
+	}
+	bInventoryDataViewStale = true;
+	DirtyInventoryItems.Add(Item);
+
+	if (ShouldReplicateInventory())
+	{
+		ReplicatedInventory.RemoveItem(Item->GetPrimaryAssetId());
+	}
+
+	if (InventoryTransactionDepth > 0)
+	{
+		PendingTransactionChanges.AddItemChange(Item, true, false);
+	}
+
+	RecordDeferredItemChange(Item, true, false);
+}
+
+void ARPGPlayerControllerBase::SetSlottedItemData(const FRPGItemSlot& ItemSlot, URPGItem* Item)
+{
+	// SlottedItems 只是给 IRPGInventoryInterface 和蓝图用的视图，插槽表才是查询用的数据
+	// SlottedItems is kept as the view for IRPGInventoryInterface and blueprints, SlotTable answers queries
+	URPGItem** FoundItem = SlottedItems.Find(ItemSlot);
+	if (!ensure(FoundItem))
+	{
+		return;
+	}
+
+	*FoundItem = Item;
+	SlotTable.SetItem(ItemSlot, Item);
+	DirtySlots.Add(ItemSlot);
+
+	if (ShouldReplicateInventory())
+	{
+		ReplicatedSlots.SetSlot(ItemSlot, Item ? Item->GetPrimaryAssetId() : FPrimaryAssetId());
+	}
+
+	if (InventoryTransactionDepth > 0)
+	{
+		PendingTransactionChanges.AddSlotChange(ItemSlot);
+	}
+
+	RecordDeferredSlotChange(ItemSlot);
+}
+
+const TMap<URPGItem*, FRPGItemData>& ARPGPlayerControllerBase::GetInventoryDataMap() const
+{
+	// 只为还需要 TMap 的调用者构造，背包本身不使用它
+	// Only built for callers that still want a map, the inventory itself never reads it
+	if (bInventoryDataViewStale)
+	{
+		InventoryDataView.Reset();
+		InventoryDataView.Reserve(InventoryStore.Num());
+		for (FRPGCompactInventory::FConstIterator It = InventoryStore.CreateConstIterator(); It; ++It)
+		{
+			InventoryDataView.Add(It.GetItem(), It.GetItemData());
+		}
+		bInventoryDataViewStale = false;
+	}
+	return InventoryDataView;
+}
+
+TMap<URPGItem*, FRPGItemData> ARPGPlayerControllerBase::K2_GetInventoryDataMap() const
+{
+	return GetInventoryDataMap();
+}
+
+bool ARPGPlayerControllerBase::CanModifyInventory() const
+{
+	return GetNetMode() != NM_Client;
+}
+
+bool ARPGPlayerControllerBase::ServerAddInventoryItem_Validate(const FPrimaryAssetId& ItemId, int32 ItemCount, int32 ItemLevel, bool bAutoSlot)
+{
+	return ItemId.IsValid() && ItemCount > 0 && ItemLevel > 0;
+}
+
+void ARPGPlayerControllerBase::ServerAddInventoryItem_Implementation(const FPrimaryAssetId& ItemId, int32 ItemCount, int32 ItemLevel, bool bAutoSlot)
+{
+	// 和复制回调相同，服务器上可能还没有加载这个道具
+	// Like the replication callbacks, the server may not have the item loaded yet
+	URPGItem* Item = URPGAssetManager::Get().ForceLoadItem(ItemId);
+	if (!Item)
+	{
+		UE_LOG(LogActionRPG, Warning, TEXT("ServerAddInventoryItem: Client requested unknown item %s!"), *ItemId.ToString());
+		return;
+	}
+
+	AddInventoryItem(Item, ItemCount, ItemLevel, bAutoSlot);
+}
+
+bool ARPGPlayerControllerBase::ServerRemoveInventoryItem_Validate(const FPrimaryAssetId& ItemId, int32 RemoveCount)
+{
+	return ItemId.IsValid();
+}
+
+void ARPGPlayerControllerBase::ServerRemoveInventoryItem_Implementation(const FPrimaryAssetId& ItemId, int32 RemoveCount)
+{
+	// 只能移除背包中的道具，背包中的道具一定已经加载了
+	// Only inventory items can be removed, and those are always loaded
+	if (URPGItem* Item = URPGAssetManager::Get().GetPrimaryAssetObject<URPGItem>(ItemId))
+	{
+		RemoveInventoryItem(Item, RemoveCount);
+	}
+}
+
+bool ARPGPlayerControllerBase::ServerSetSlottedItem_Validate(const FRPGItemSlot& ItemSlot, const FPrimaryAssetId& ItemId)
+{
+	return ItemSlot.IsValid();
+}
+
+void ARPGPlayerControllerBase::ServerSetSlottedItem_Implementation(const FRPGItemSlot& ItemSlot, const FPrimaryAssetId& ItemId)
+{
+	// 客户端只能装备自己拥有的道具，异步加载期间交给 SetSlottedItem 排队
+	// Clients may only equip items they own, during an async load SetSlottedItem queues the request instead
+	URPGItem* Item = ItemId.IsValid() ? URPGAssetManager::Get().GetPrimaryAssetObject<URPGItem>(ItemId) : nullptr;
+	if (ItemId.IsValid() && (!Item || (!bInventoryLoading && !InventoryStore.Contains(Item))))
+	{
+		UE_LOG(LogActionRPG, Warning, TEXT("ServerSetSlottedItem: Client tried to slot %s which is not in its inventory!"), *ItemId.ToString());
+		return;
+	}
+
+	SetSlottedItem(ItemSlot, Item);
+}
+
+void ARPGPlayerControllerBase::ServerFillEmptySlots_Implementation()
+{
+	FillEmptySlots();
+}
+
+bool ARPGPlayerControllerBase::ShouldReplicateInventory() const
+{
+	return HasAuthority() && GetNetMode() != NM_Standalone;
+}
+
+bool ARPGPlayerControllerBase::UsesLocalSaveGame() const
+{
+	return GetNetMode() != NM_Client && IsLocalController();
+}
+
+void ARPGPlayerControllerBase::FillInventoryFromReplicatedData()
+{
+	URPGAssetManager& AssetManager = URPGAssetManager::Get();
+
+	for (const FRPGReplicatedInventoryEntry& Entry : ReplicatedInventory.GetEntries())
+	{
+		if (URPGItem* LoadedItem = AssetManager.ForceLoadItem(Entry.ItemId))
+		{
+			SetInventoryItemData(LoadedItem, Entry.ItemData);
+		}
+	}
+
+	for (const FRPGReplicatedSlotEntry& Entry : ReplicatedSlots.GetEntries())
+	{
+		URPGItem* LoadedItem = Entry.ItemId.IsValid() ? AssetManager.ForceLoadItem(Entry.ItemId) : nullptr;
+		if (LoadedItem && SlotTable.GetSlotIndex(Entry.ItemSlot) != INDEX_NONE)
+		{
+			SetSlottedItemData(Entry.ItemSlot, LoadedItem);
+		}
+	}
+
+	DeferredChanges.Reset();
+}
+
+void ARPGPlayerControllerBase::HandleReplicatedItemChanged(const FPrimaryAssetId& ItemId, const FRPGItemData& ItemData)
+{
+	URPGItem* Item = URPGAssetManager::Get().ForceLoadItem(ItemId);
+	if (!Item)
+	{
+		return;
+	}
+
+	SetInventoryItemData(Item, ItemData);
+	NotifyInventoryItemChanged(true, Item);
+}
+
+void ARPGPlayerControllerBase::HandleReplicatedItemRemoved(const FPrimaryAssetId& ItemId)
+{
+	// 背包中的道具由 FRPGItemCatalog 保持加载，没有加载的道具也不在背包中
+	// Items in the inventory are kept loaded by FRPGItemCatalog, an item that is not loaded has nothing to remove
+	URPGItem* Item = URPGAssetManager::Get().GetPrimaryAssetObject<URPGItem>(ItemId);
+	if (!Item || !InventoryStore.Contains(Item))
+	{
+		return;
+	}
+
+	// 插槽的改变由 ReplicatedSlots 单独复制
+	// Slots holding the item are updated by their own replicated entries
+	RemoveInventoryItemData(Item);
+	NotifyInventoryItemChanged(false, Item);
+}
+
+void ARPGPlayerControllerBase::HandleReplicatedSlotChanged(const FRPGItemSlot& ItemSlot, const FPrimaryAssetId& ItemId)
+{
+	// 初始复制可能早于 BeginPlay 中的 LoadInventory ，那时还没有插槽布局，LoadInventory 会使用复制过来的数据
+	// Initial replication can arrive before LoadInventory in BeginPlay built the layout, LoadInventory then picks the entry up
+	if (SlotTable.GetSlotIndex(ItemSlot) == INDEX_NONE)
+	{
+		return;
+	}
+
+	URPGItem* Item = ItemId.IsValid() ? URPGAssetManager::Get().ForceLoadItem(ItemId) : nullptr;
+	if (GetSlottedItem(ItemSlot) == Item)
+	{
+		return;
+	}
+
+	SetSlottedItemData(ItemSlot, Item);
+	NotifySlottedItemChanged(ItemSlot, Item);
+}
+
+bool ARPGPlayerControllerBase::ValidateInventoryIndices() const
+{
+	if (!SlotTable.IsConsistentWith(SlottedItems))
+	{
+		UE_LOG(LogActionRPG, Error, TEXT("ValidateInventoryIndices: Slot table is out of sync with SlottedItems!"));
+		return false;
+	}
+
+	if (InventoryIndex.Num(FPrimaryAssetType()) != InventoryStore.Num())
+	{
+		UE_LOG(LogActionRPG, Error, TEXT("ValidateInventoryIndices: Type index holds %d items but the inventory has %d!"), InventoryIndex.Num(FPrimaryAssetType()), InventoryStore.Num());
+		return false;
+	}
+
+	return true;
+}
+
+void ARPGPlayerControllerBase::MarkInventoryFullyDirty()
+{
+	DirtyInventoryItems.Reset();
+	DirtySlots.Reset();
+	bInventoryFullyDirty = true;
+}
+
+void ARPGPlayerControllerBase::BeginInventoryTransaction()
+{
+	InventoryTransactionDepth++;
+}
+
+bool ARPGPlayerControllerBase::CommitInventoryTransaction()
+{
+	if (InventoryTransactionDepth <= 0)
+	{
+		UE_LOG(LogActionRPG, Warning, TEXT("CommitInventoryTransaction: No inventory transaction is open!"));
+		return false;
+	}
+
+	if (--InventoryTransactionDepth > 0)
+	{
+		// 只有最外层的提交才生效
+		// Only the outermost commit takes effect
+		return false;
+	}
+
+	// 先移出再通知，这样回调中可以开启新的事务
+	// Move the changes out before notifying so callbacks can start a new transaction
+	const FRPGInventoryChangeSet ChangeSet = PendingTransactionChanges.Flush();
+
+	const bool bShouldSave = bTransactionSaveRequested;
+	bTransactionSaveRequested = false;
+
+	if (!ChangeSet.IsEmpty())
+	{
+		NotifyInventoryChangeSet(ChangeSet);
+	}
+
+	if (bShouldSave)
+	{
+		SaveInventory();
+	}
+
+	return !ChangeSet.IsEmpty();
+}
+
+bool ARPGPlayerControllerBase::IsInInventoryTransaction() const
+{
+	return InventoryTransactionDepth > 0;
+}
+
 void ARPGPlayerControllerBase::NotifyInventoryItemChanged(bool bAdded, URPGItem* Item)
 {
+	// 事务中的改变在提交时统一通知
+	// Changes inside a transaction are reported by the commit
+	if (InventoryTransactionDepth > 0)
+	{
+		return;
+	}
+
 	// Notify native before blueprint
 	OnInventoryItemChangedNative.Broadcast(bAdded, Item);
 	OnInventoryItemChanged.Broadcast(bAdded, Item);
@@ -408,6 +1034,11 @@ void ARPGPlayerControllerBase::NotifyInventoryItemChanged(bool bAdded, URPGItem*
 
 void ARPGPlayerControllerBase::NotifySlottedItemChanged(FRPGItemSlot ItemSlot, URPGItem* Item)
 {
+	if (InventoryTransactionDepth > 0)
+	{
+		return;
+	}
+
 	// Notify native before blueprint
 	OnSlottedItemChangedNative.Broadcast(ItemSlot, Item);
 	OnSlottedItemChanged.Broadcast(ItemSlot, Item);
@@ -424,6 +1055,99 @@ void ARPGPlayerControllerBase::NotifyInventoryLoaded() const
 	
 }
 
+void ARPGPlayerControllerBase::NotifyInventoryChangeSet(const FRPGInventoryChangeSet& ChangeSet)
+{
+	// Notify native before blueprint
+	OnInventoryChangeSetNative.Broadcast(ChangeSet);
+	OnInventoryChangeSet.Broadcast(ChangeSet);
+
+	// 对只关心单个改变的蓝图补发合并后的通知
+	// Replay one coalesced notification per entry for blueprints that only listen to single changes
+	if (bReplayBlueprintNotificationsOnCommit)
+	{
+		for (URPGItem* Item : ChangeSet.AddedItems)
+		{
+			OnInventoryItemChanged.Broadcast(true, Item);
+			InventoryItemChanged(true, Item);
+		}
+
+		for (URPGItem* Item : ChangeSet.ChangedItems)
+		{
+			OnInventoryItemChanged.Broadcast(true, Item);
+			InventoryItemChanged(true, Item);
+		}
+
+		for (URPGItem* Item : ChangeSet.RemovedItems)
+		{
+			OnInventoryItemChanged.Broadcast(false, Item);
+			InventoryItemChanged(false, Item);
+		}
+
+		for (const FRPGItemSlot& ItemSlot : ChangeSet.ChangedSlots)
+		{
+			URPGItem* SlottedItem = GetSlottedItem(ItemSlot);
+			OnSlottedItemChanged.Broadcast(ItemSlot, SlottedItem);
+			SlottedItemChanged(ItemSlot, SlottedItem);
+		}
+	}
+
+	// Call BP update event
+	InventoryChangeSetCommitted(ChangeSet);
+}
+
+void ARPGPlayerControllerBase::RecordDeferredItemChange(URPGItem* Item, bool bWasInInventory, bool bIsInInventory)
+{
+	if (bDeferInventoryChangeSets)
+	{
+		DeferredChanges.AddItemChange(Item, bWasInInventory, bIsInInventory);
+		BindEndOfFrame();
+	}
+}
+
+void ARPGPlayerControllerBase::RecordDeferredSlotChange(const FRPGItemSlot& ItemSlot)
+{
+	if (bDeferInventoryChangeSets)
+	{
+		DeferredChanges.AddSlotChange(ItemSlot);
+		BindEndOfFrame();
+	}
+}
+
+void ARPGPlayerControllerBase::BindEndOfFrame()
+{
+	// 绑定后一直保留到 EndPlay ，避免每帧绑定 / 解绑
+	// Stays bound until EndPlay instead of rebinding every frame
+	if (!EndOfFrameHandle.IsValid())
+	{
+		EndOfFrameHandle = FCoreDelegates::OnEndFrame.AddUObject(this, &ARPGPlayerControllerBase::HandleEndOfFrame);
+	}
+}
+
+void ARPGPlayerControllerBase::HandleEndOfFrame()
+{
+	FlushDeferredInventoryChanges();
+}
+
+bool ARPGPlayerControllerBase::FlushDeferredInventoryChanges()
+{
+	if (DeferredChanges.IsEmpty())
+	{
+		return false;
+	}
+
+	// 先移出再通知，回调中的改变会在下一帧通知
+	// Move the changes out first, changes made by the callbacks are delivered next frame
+	const FRPGInventoryChangeSet ChangeSet = DeferredChanges.Flush();
+
+	// Notify native before blueprint
+	OnDeferredInventoryChangeSetNative.Broadcast(ChangeSet);
+	OnDeferredInventoryChangeSet.Broadcast(ChangeSet);
+
+	// Call BP update event
+	DeferredInventoryChangeSet(ChangeSet);
+	return true;
+}
+
 void ARPGPlayerControllerBase::HandleSaveGameLoaded(URPGSaveGame* NewSaveGame)
 {
 	LoadInventory();
@@ -438,4 +1162,32 @@ void ARPGPlayerControllerBase::BeginPlay()
 	LoadInventory();
 
 	Super::BeginPlay();
+}
+
+void ARPGPlayerControllerBase::PostInitializeComponents()
+{
+	Super::PostInitializeComponents();
+
+	ReplicatedInventory.Owner = this;
+	ReplicatedSlots.Owner = this;
+}
+
+void ARPGPlayerControllerBase::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME_CONDITION(ARPGPlayerControllerBase, ReplicatedInventory, COND_OwnerOnly);
+	DOREPLIFETIME_CONDITION(ARPGPlayerControllerBase, ReplicatedSlots, COND_OwnerOnly);
+}
+
+void ARPGPlayerControllerBase::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (EndOfFrameHandle.IsValid())
+	{
+		FCoreDelegates::OnEndFrame.Remove(EndOfFrameHandle);
+		EndOfFrameHandle.Reset();
+	}
+	DeferredChanges.Reset();
+
+	Super::EndPlay(EndPlayReason);
 }
\ No newline at end of file
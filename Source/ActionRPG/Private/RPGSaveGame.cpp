@@ -2,25 +2,322 @@
 
 #include "RPGSaveGame.h"
 #include "RPGGameInstanceBase.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
 
-void URPGSaveGame::Serialize(FArchive& Ar)
+DECLARE_CYCLE_STAT(TEXT("Migrate Save Game"), STAT_MigrateSaveGame, STATGROUP_RPGSave);
+
+namespace RPGSaveGameDictionary
 {
-	Super::Serialize(Ar);
+	/** 把名称加入表中，返回它的下标 */
+	/** Adds a name to a table and returns its index */
+	static uint32 AddName(TArray<FName>& Names, TMap<FName, uint32>& Indices, FName Name)
+	{
+		if (const uint32* Index = Indices.Find(Name))
+		{
+			return *Index;
+		}
+		return Indices.Add(Name, Names.Add(Name));
+	}
+
+	static uint32 AddItemId(TArray<FPrimaryAssetId>& Ids, TMap<FPrimaryAssetId, uint32>& Indices, const FPrimaryAssetId& ItemId)
+	{
+		if (const uint32* Index = Indices.Find(ItemId))
+		{
+			return *Index;
+		}
+		return Indices.Add(ItemId, Ids.Add(ItemId));
+	}
+
+	static void SerializeName(FArchive& Ar, FName& Name)
+	{
+		FString NameString = Name.ToString();
+		Ar << NameString;
+		if (Ar.IsLoading())
+		{
+			Name = FName(*NameString);
+		}
+	}
 
-	if (Ar.IsLoading() && SavedDataVersion != ERPGSaveGameVersion::LatestVersion)
+	/**
+	 * 格式：版本、类型表、道具 Id 字典（类型下标和名称）、背包条目（Id 下标、数量、等级）、slot 条目（类型下标、编号、Id 下标），
+	 * 所有的整数都是变长编码。
+	 */
+	/**
+	 * Layout: version, type table, item id dictionary (type index and name), inventory entries (id index, count, level)
+	 * and slot entries (type index, slot number, id index). Every integer is variable-length encoded
+	 */
+	static void Pack(const TMap<FPrimaryAssetId, FRPGItemData>& InventoryData, const TMap<FRPGItemSlot, FPrimaryAssetId>& SlottedItems, TArray<uint8>& OutBytes)
 	{
-		// 在这里处理之间版本的游戏数据
-		if (SavedDataVersion < ERPGSaveGameVersion::AddedItemData)
+		TArray<FName> Types;
+		TMap<FName, uint32> TypeIndices;
+		TArray<FPrimaryAssetId> Ids;
+		TMap<FPrimaryAssetId, uint32> IdIndices;
+		Ids.Reserve(InventoryData.Num());
+		IdIndices.Reserve(InventoryData.Num());
+
+		for (const TPair<FPrimaryAssetId, FRPGItemData>& Pair : InventoryData)
+		{
+			AddItemId(Ids, IdIndices, Pair.Key);
+		}
+		for (const TPair<FRPGItemSlot, FPrimaryAssetId>& Pair : SlottedItems)
+		{
+			AddItemId(Ids, IdIndices, Pair.Value);
+			AddName(Types, TypeIndices, Pair.Key.ItemType.GetName());
+		}
+		for (const FPrimaryAssetId& ItemId : Ids)
 		{
-			// Convert from list to item data map
-			for (const FPrimaryAssetId& ItemId : InventoryItems_DEPRECATED)
+			AddName(Types, TypeIndices, ItemId.PrimaryAssetType.GetName());
+		}
+
+		OutBytes.Reset();
+		FMemoryWriter Ar(OutBytes);
+
+		int32 Version = ERPGSaveGameVersion::AddedItemDictionary;
+		Ar << Version;
+
+		uint32 NumTypes = Types.Num();
+		Ar.SerializeIntPacked(NumTypes);
+		for (FName& Type : Types)
+		{
+			SerializeName(Ar, Type);
+		}
+
+		uint32 NumIds = Ids.Num();
+		Ar.SerializeIntPacked(NumIds);
+		for (const FPrimaryAssetId& ItemId : Ids)
+		{
+			uint32 TypeIndex = TypeIndices.FindChecked(ItemId.PrimaryAssetType.GetName());
+			FName Name = ItemId.PrimaryAssetName;
+			Ar.SerializeIntPacked(TypeIndex);
+			SerializeName(Ar, Name);
+		}
+
+		uint32 NumItems = InventoryData.Num();
+		Ar.SerializeIntPacked(NumItems);
+		for (const TPair<FPrimaryAssetId, FRPGItemData>& Pair : InventoryData)
+		{
+			uint32 IdIndex = IdIndices.FindChecked(Pair.Key);
+			uint32 ItemCount = uint32(Pair.Value.ItemCount);
+			uint32 ItemLevel = uint32(Pair.Value.ItemLevel);
+			Ar.SerializeIntPacked(IdIndex);
+			Ar.SerializeIntPacked(ItemCount);
+			Ar.SerializeIntPacked(ItemLevel);
+		}
+
+		uint32 NumSlots = SlottedItems.Num();
+		Ar.SerializeIntPacked(NumSlots);
+		for (const TPair<FRPGItemSlot, FPrimaryAssetId>& Pair : SlottedItems)
+		{
+			uint32 TypeIndex = TypeIndices.FindChecked(Pair.Key.ItemType.GetName());
+			uint32 SlotNumber = uint32(Pair.Key.SlotNumber);
+			uint32 IdIndex = IdIndices.FindChecked(Pair.Value);
+			Ar.SerializeIntPacked(TypeIndex);
+			Ar.SerializeIntPacked(SlotNumber);
+			Ar.SerializeIntPacked(IdIndex);
+		}
+	}
+
+	/** 展开 Pack 的输出，遇到损坏的数据时返回 false */
+	/** Expands the output of Pack and returns the version it was packed with in OutVersion, returns false on damaged data */
+	static bool Unpack(const TArray<uint8>& Bytes, TMap<FPrimaryAssetId, FRPGItemData>& OutInventoryData, TMap<FRPGItemSlot, FPrimaryAssetId>& OutSlottedItems, int32& OutVersion)
+	{
+		FMemoryReader Ar(Bytes);
+
+		Ar << OutVersion;
+		if (OutVersion > ERPGSaveGameVersion::LatestVersion)
+		{
+			return false;
+		}
+
+		uint32 NumTypes = 0;
+		Ar.SerializeIntPacked(NumTypes);
+		if (Ar.IsError() || NumTypes > uint32(Bytes.Num()))
+		{
+			return false;
+		}
+
+		TArray<FName> Types;
+		Types.SetNum(NumTypes);
+		for (FName& Type : Types)
+		{
+			SerializeName(Ar, Type);
+		}
+
+		uint32 NumIds = 0;
+		Ar.SerializeIntPacked(NumIds);
+		if (Ar.IsError() || NumIds > uint32(Bytes.Num()))
+		{
+			return false;
+		}
+
+		TArray<FPrimaryAssetId> Ids;
+		Ids.SetNum(NumIds);
+		for (FPrimaryAssetId& ItemId : Ids)
+		{
+			uint32 TypeIndex = 0;
+			Ar.SerializeIntPacked(TypeIndex);
+			SerializeName(Ar, ItemId.PrimaryAssetName);
+			if (!Types.IsValidIndex(TypeIndex))
 			{
-				InventoryData.Add(ItemId, FRPGItemData(1, 1));
+				return false;
 			}
+			ItemId.PrimaryAssetType = Types[TypeIndex];
+		}
 
-			InventoryItems_DEPRECATED.Empty();
+		uint32 NumItems = 0;
+		Ar.SerializeIntPacked(NumItems);
+		OutInventoryData.Reset();
+		OutInventoryData.Reserve(FMath::Min(NumItems, uint32(Bytes.Num())));
+		for (uint32 Index = 0; Index < NumItems && !Ar.IsError(); Index++)
+		{
+			uint32 IdIndex = 0;
+			uint32 ItemCount = 0;
+			uint32 ItemLevel = 0;
+			Ar.SerializeIntPacked(IdIndex);
+			Ar.SerializeIntPacked(ItemCount);
+			Ar.SerializeIntPacked(ItemLevel);
+			if (!Ids.IsValidIndex(IdIndex))
+			{
+				return false;
+			}
+			OutInventoryData.Add(Ids[IdIndex], FRPGItemData(int32(ItemCount), int32(ItemLevel)));
+		}
+
+		uint32 NumSlots = 0;
+		Ar.SerializeIntPacked(NumSlots);
+		OutSlottedItems.Reset();
+		for (uint32 Index = 0; Index < NumSlots && !Ar.IsError(); Index++)
+		{
+			uint32 TypeIndex = 0;
+			uint32 SlotNumber = 0;
+			uint32 IdIndex = 0;
+			Ar.SerializeIntPacked(TypeIndex);
+			Ar.SerializeIntPacked(SlotNumber);
+			Ar.SerializeIntPacked(IdIndex);
+			if (!Types.IsValidIndex(TypeIndex) || !Ids.IsValidIndex(IdIndex))
+			{
+				return false;
+			}
+			OutSlottedItems.Add(FRPGItemSlot(Types[TypeIndex], int32(SlotNumber)), Ids[IdIndex]);
+		}
+
+		return !Ar.IsError();
+	}
+}
+
+void URPGSaveGame::Serialize(FArchive& Ar)
+{
+	// 写入存档时用字典代替两个 TMap ，TMap 暂时清空，不会被写入
+	// Save game archives get the dictionary instead of the two maps, which are emptied for the duration of the write
+	if (Ar.IsSaving() && Ar.IsSaveGame() && (InventoryData.Num() > 0 || SlottedItems.Num() > 0))
+	{
+		RPGSaveGameDictionary::Pack(InventoryData, SlottedItems, PackedInventory);
+
+		TMap<FPrimaryAssetId, FRPGItemData> SavedInventoryData = MoveTemp(InventoryData);
+		TMap<FRPGItemSlot, FPrimaryAssetId> SavedSlottedItems = MoveTemp(SlottedItems);
+		InventoryData.Reset();
+		SlottedItems.Reset();
+
+		Super::Serialize(Ar);
+
+		InventoryData = MoveTemp(SavedInventoryData);
+		SlottedItems = MoveTemp(SavedSlottedItems);
+		PackedInventory.Empty();
+		return;
+	}
+
+	Super::Serialize(Ar);
+
+	// 只有存档需要升级，复制对象等其他的读取不需要
+	// Only save game archives carry old versions, duplication and other loads never need a migration
+	if (!Ar.IsLoading() || !Ar.IsSaveGame())
+	{
+		return;
+	}
+
+	int32 PackedVersion = INDEX_NONE;
+	if (PackedInventory.Num() > 0)
+	{
+		if (!RPGSaveGameDictionary::Unpack(PackedInventory, InventoryData, SlottedItems, PackedVersion))
+		{
+			UE_LOG(LogActionRPG, Warning, TEXT("URPGSaveGame: Damaged item dictionary, the inventory could not be fully restored"));
 		}
-		
-		SavedDataVersion = ERPGSaveGameVersion::LatestVersion;
+		PackedInventory.Empty();
 	}
-}
\ No newline at end of file
+
+	const int32 LoadedVersion = DetectLoadedVersion(PackedVersion);
+	if (LoadedVersion < ERPGSaveGameVersion::LatestVersion)
+	{
+		Migrate(LoadedVersion);
+	}
+	SavedDataVersion = ERPGSaveGameVersion::LatestVersion;
+}
+
+int32 URPGSaveGame::DetectLoadedVersion(int32 PackedVersion) const
+{
+	// 字典中的版本总是被写入
+	// The dictionary always stores its version
+	if (PackedVersion != INDEX_NONE)
+	{
+		return PackedVersion;
+	}
+
+	// 旧的存档的 SavedDataVersion 通常没有被写入，只有显式写入的旧版本才可信
+	// SavedDataVersion of an old save is usually missing and then reads as LatestVersion, only an explicitly written older version can be trusted
+	int32 Version = FMath::Clamp<int32>(SavedDataVersion, ERPGSaveGameVersion::Initial, ERPGSaveGameVersion::LatestVersion);
+	if (InventoryItems_DEPRECATED.Num() > 0)
+	{
+		Version = FMath::Min<int32>(Version, ERPGSaveGameVersion::AddedInventory);
+	}
+	else if (InventoryData.Num() > 0 || SlottedItems.Num() > 0)
+	{
+		// 有数据但没有字典，是直接保存 TMap 的版本
+		// Maps without a dictionary were stored directly
+		Version = FMath::Min<int32>(Version, ERPGSaveGameVersion::AddedItemData);
+	}
+	return Version;
+}
+
+void URPGSaveGame::Migrate(int32 FromVersion)
+{
+	SCOPE_CYCLE_COUNTER(STAT_MigrateSaveGame);
+	const double StartTime = FPlatformTime::Seconds();
+
+	// 第 i 步把版本 i 的数据升级到版本 i + 1 ，没有数据需要转换的步骤为 nullptr
+	// Step i upgrades data of version i to version i + 1, steps without data to convert are nullptr
+	typedef void (*FMigrationStep)(URPGSaveGame&);
+	static const FMigrationStep MigrationSteps[] =
+	{
+		// Initial -> AddedInventory: there was no inventory before
+		nullptr,
+		// AddedInventory -> AddedItemData
+		&URPGSaveGame::MigrateInventoryList,
+		// AddedItemData -> AddedItemDictionary: Super::Serialize already read the maps, the dictionary is written by the next save
+		nullptr,
+	};
+	static_assert(UE_ARRAY_COUNT(MigrationSteps) == ERPGSaveGameVersion::LatestVersion, "Every save version needs a migration step");
+
+	for (int32 Version = FMath::Max<int32>(FromVersion, ERPGSaveGameVersion::Initial); Version < ERPGSaveGameVersion::LatestVersion; Version++)
+	{
+		if (MigrationSteps[Version])
+		{
+			MigrationSteps[Version](*this);
+		}
+	}
+
+	MigratedFromVersion = FromVersion;
+	MigrationSeconds = FPlatformTime::Seconds() - StartTime;
+}
+
+void URPGSaveGame::MigrateInventoryList(URPGSaveGame& SaveGame)
+{
+	// Convert from list to item data map
+	SaveGame.InventoryData.Reserve(SaveGame.InventoryData.Num() + SaveGame.InventoryItems_DEPRECATED.Num());
+	for (const FPrimaryAssetId& ItemId : SaveGame.InventoryItems_DEPRECATED)
+	{
+		SaveGame.InventoryData.Add(ItemId, FRPGItemData(1, 1));
+	}
+
+	SaveGame.InventoryItems_DEPRECATED.Empty();
+}
@@ -0,0 +1,330 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "RPGSaveGameArchive.h"
+#include "RPGSaveGame.h"
+#include "Kismet/GameplayStatics.h"
+#include "Misc/Compression.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace RPGSaveGameArchive
+{
+	static constexpr uint32 Magic = 0x53475052; // "RPGS"
+
+	/** 1: zlib compressed snapshot, 2: added compression and payload kind */
+	static constexpr uint32 FormatVersion = 2;
+
+	/** Magic, format version, uncompressed size and compressed size */
+	static constexpr int32 HeaderSizeV1 = sizeof(uint32) * 2 + sizeof(int32) * 2;
+
+	/** Version 1 plus compression, payload kind and two reserved bytes */
+	static constexpr int32 HeaderSize = HeaderSizeV1 + sizeof(uint8) * 4;
+
+	/** 返回压缩方式对应的 FCompression 格式，Oodle 不可用时退回 zlib */
+	/** Returns the FCompression format of a compression type, Oodle falls back to zlib where it is unavailable */
+	static FName GetCompressionFormat(ERPGSaveCompression& InOutCompression)
+	{
+		switch (InOutCompression)
+		{
+		case ERPGSaveCompression::Oodle:
+			if (FCompression::IsFormatValid(NAME_Oodle))
+			{
+				return NAME_Oodle;
+			}
+			InOutCompression = ERPGSaveCompression::Zlib;
+			return NAME_Zlib;
+		case ERPGSaveCompression::Zlib:
+			return NAME_Zlib;
+		default:
+			InOutCompression = ERPGSaveCompression::None;
+			return NAME_None;
+		}
+	}
+}
+
+TSharedRef<const FRPGSaveGameSnapshot> FRPGSaveGameSnapshot::Capture(const URPGSaveGame& SaveGame)
+{
+	check(IsInGameThread());
+
+	TSharedRef<FRPGSaveGameSnapshot> Snapshot = MakeShared<FRPGSaveGameSnapshot>();
+	Snapshot->SaveGameVersion = ERPGSaveGameVersion::LatestVersion;
+	Snapshot->UserId = SaveGame.UserId;
+	Snapshot->InventoryData = SaveGame.InventoryData;
+	Snapshot->SlottedItems = SaveGame.SlottedItems;
+	return Snapshot;
+}
+
+void FRPGSaveGameSnapshot::ApplyTo(URPGSaveGame& SaveGame) const
+{
+	SaveGame.UserId = UserId;
+	SaveGame.InventoryData = InventoryData;
+	SaveGame.SlottedItems = SlottedItems;
+}
+
+void FRPGSaveGameSnapshot::Serialize(FArchive& Ar)
+{
+	Ar << SaveGameVersion;
+	Ar << UserId;
+
+	int32 NumItems = InventoryData.Num();
+	Ar << NumItems;
+	if (Ar.IsLoading())
+	{
+		InventoryData.Reset();
+		InventoryData.Reserve(NumItems);
+		for (int32 Index = 0; Index < NumItems && !Ar.IsError(); Index++)
+		{
+			FPrimaryAssetId ItemId;
+			FRPGItemData ItemData;
+			Ar << ItemId << ItemData.ItemCount << ItemData.ItemLevel;
+			InventoryData.Add(ItemId, ItemData);
+		}
+	}
+	else
+	{
+		for (TPair<FPrimaryAssetId, FRPGItemData>& Pair : InventoryData)
+		{
+			Ar << Pair.Key << Pair.Value.ItemCount << Pair.Value.ItemLevel;
+		}
+	}
+
+	int32 NumSlots = SlottedItems.Num();
+	Ar << NumSlots;
+	if (Ar.IsLoading())
+	{
+		SlottedItems.Reset();
+		SlottedItems.Reserve(NumSlots);
+		for (int32 Index = 0; Index < NumSlots && !Ar.IsError(); Index++)
+		{
+			FRPGItemSlot ItemSlot;
+			FPrimaryAssetId ItemId;
+			Ar << ItemSlot.ItemType << ItemSlot.SlotNumber << ItemId;
+			SlottedItems.Add(ItemSlot, ItemId);
+		}
+	}
+	else
+	{
+		for (TPair<FRPGItemSlot, FPrimaryAssetId>& Pair : SlottedItems)
+		{
+			FRPGItemSlot ItemSlot = Pair.Key;
+			Ar << ItemSlot.ItemType << ItemSlot.SlotNumber << Pair.Value;
+		}
+	}
+}
+
+bool FRPGSaveGameArchive::Write(const FRPGSaveGameSnapshot& Snapshot, ERPGSaveCompression Compression, TArray<uint8>& OutBytes)
+{
+	TArray<uint8> Payload;
+	FMemoryWriter PayloadWriter(Payload, true);
+	const_cast<FRPGSaveGameSnapshot&>(Snapshot).Serialize(PayloadWriter);
+
+	return WriteArchive(Payload, ERPGSaveArchivePayload::Snapshot, Compression, OutBytes);
+}
+
+bool FRPGSaveGameArchive::WriteSaveGameData(const TArray<uint8>& SaveGameData, ERPGSaveCompression Compression, TArray<uint8>& OutBytes)
+{
+	return WriteArchive(SaveGameData, ERPGSaveArchivePayload::SaveGame, Compression, OutBytes);
+}
+
+bool FRPGSaveGameArchive::WriteArchive(const TArray<uint8>& Payload, ERPGSaveArchivePayload PayloadKind, ERPGSaveCompression Compression, TArray<uint8>& OutBytes)
+{
+	const FName Format = RPGSaveGameArchive::GetCompressionFormat(Compression);
+
+	int32 CompressedSize = Payload.Num();
+	if (Format.IsNone())
+	{
+		OutBytes.SetNumUninitialized(RPGSaveGameArchive::HeaderSize + CompressedSize);
+		FMemory::Memcpy(OutBytes.GetData() + RPGSaveGameArchive::HeaderSize, Payload.GetData(), CompressedSize);
+	}
+	else
+	{
+		CompressedSize = FCompression::CompressMemoryBound(Format, Payload.Num());
+		OutBytes.SetNumUninitialized(RPGSaveGameArchive::HeaderSize + CompressedSize);
+		if (!FCompression::CompressMemory(Format, OutBytes.GetData() + RPGSaveGameArchive::HeaderSize, CompressedSize, Payload.GetData(), Payload.Num()))
+		{
+			return false;
+		}
+		OutBytes.SetNum(RPGSaveGameArchive::HeaderSize + CompressedSize, false);
+	}
+
+	FMemoryWriter HeaderWriter(OutBytes, true);
+	uint32 Magic = RPGSaveGameArchive::Magic;
+	uint32 FormatVersion = RPGSaveGameArchive::FormatVersion;
+	int32 UncompressedSize = Payload.Num();
+	uint8 CompressionByte = static_cast<uint8>(Compression);
+	uint8 PayloadByte = static_cast<uint8>(PayloadKind);
+	uint16 Reserved = 0;
+	HeaderWriter << Magic << FormatVersion << UncompressedSize << CompressedSize << CompressionByte << PayloadByte << Reserved;
+	return true;
+}
+
+bool FRPGSaveGameArchive::Read(const TArray<uint8>& Bytes, FRPGSaveGameSnapshot& OutSnapshot)
+{
+	FRPGSaveArchiveHeader Header;
+	TArray<uint8> Payload;
+	if (!Decode(Bytes, Header, Payload) || Header.Payload != ERPGSaveArchivePayload::Snapshot)
+	{
+		return false;
+	}
+
+	FMemoryReader PayloadReader(Payload, true);
+	OutSnapshot.Serialize(PayloadReader);
+	return !PayloadReader.IsError();
+}
+
+bool FRPGSaveGameArchive::Decode(const TArray<uint8>& Bytes, FRPGSaveArchiveHeader& OutHeader, TArray<uint8>& OutPayload)
+{
+	if (!IsSaveArchive(Bytes))
+	{
+		return false;
+	}
+
+	FMemoryReader HeaderReader(Bytes, true);
+	uint32 Magic = 0;
+	HeaderReader << Magic << OutHeader.FormatVersion << OutHeader.UncompressedSize << OutHeader.CompressedSize;
+
+	int32 HeaderSize = RPGSaveGameArchive::HeaderSizeV1;
+	if (OutHeader.FormatVersion >= 2)
+	{
+		uint8 CompressionByte = 0;
+		uint8 PayloadByte = 0;
+		uint16 Reserved = 0;
+		HeaderReader << CompressionByte << PayloadByte << Reserved;
+		OutHeader.Compression = static_cast<ERPGSaveCompression>(CompressionByte);
+		OutHeader.Payload = static_cast<ERPGSaveArchivePayload>(PayloadByte);
+		HeaderSize = RPGSaveGameArchive::HeaderSize;
+	}
+	else
+	{
+		// 版本 1 只有 zlib 压缩的快照
+		// Version 1 only wrote zlib compressed snapshots
+		OutHeader.Compression = ERPGSaveCompression::Zlib;
+		OutHeader.Payload = ERPGSaveArchivePayload::Snapshot;
+	}
+
+	if (HeaderReader.IsError() || OutHeader.FormatVersion > RPGSaveGameArchive::FormatVersion || OutHeader.Compression > ERPGSaveCompression::Oodle
+		|| OutHeader.Payload > ERPGSaveArchivePayload::SaveGame || OutHeader.UncompressedSize < 0 || OutHeader.CompressedSize < 0
+		|| int64(HeaderSize) + OutHeader.CompressedSize > Bytes.Num())
+	{
+		UE_LOG(LogActionRPG, Warning, TEXT("FRPGSaveGameArchive: Unsupported or damaged save archive (format %u)"), OutHeader.FormatVersion);
+		return false;
+	}
+
+	const uint8* CompressedData = Bytes.GetData() + HeaderSize;
+	ERPGSaveCompression Compression = OutHeader.Compression;
+	const FName Format = RPGSaveGameArchive::GetCompressionFormat(Compression);
+	if (Compression != OutHeader.Compression)
+	{
+		UE_LOG(LogActionRPG, Warning, TEXT("FRPGSaveGameArchive: Save archive uses a compression format that is unavailable on this platform"));
+		return false;
+	}
+
+	if (Format.IsNone())
+	{
+		if (OutHeader.CompressedSize != OutHeader.UncompressedSize)
+		{
+			return false;
+		}
+		OutPayload = TArray<uint8>(CompressedData, OutHeader.CompressedSize);
+		return true;
+	}
+
+	OutPayload.SetNumUninitialized(OutHeader.UncompressedSize);
+	if (!FCompression::UncompressMemory(Format, OutPayload.GetData(), OutHeader.UncompressedSize, CompressedData, OutHeader.CompressedSize))
+	{
+		UE_LOG(LogActionRPG, Warning, TEXT("FRPGSaveGameArchive: Failed to decompress save archive"));
+		return false;
+	}
+	return true;
+}
+
+bool FRPGSaveGameArchive::IsSaveArchive(const TArray<uint8>& Bytes)
+{
+	if (Bytes.Num() < RPGSaveGameArchive::HeaderSizeV1)
+	{
+		return false;
+	}
+
+	uint32 Magic = 0;
+	FMemory::Memcpy(&Magic, Bytes.GetData(), sizeof(Magic));
+	return Magic == RPGSaveGameArchive::Magic;
+}
+
+bool FRPGSaveGameArchive::ReadFromMemory(const TArray<uint8>& Bytes, FRPGSaveGameLoadResult& OutResult)
+{
+	OutResult = FRPGSaveGameLoadResult();
+
+	// 没有文件头的是旧的存档
+	// Data without the header is a legacy save
+	if (!IsSaveArchive(Bytes))
+	{
+		OutResult.Payload = ERPGSaveArchivePayload::SaveGame;
+		OutResult.SaveGameData = Bytes;
+		OutResult.bValid = Bytes.Num() > 0;
+		return OutResult.bValid;
+	}
+
+	FRPGSaveArchiveHeader Header;
+	TArray<uint8> Payload;
+	if (!Decode(Bytes, Header, Payload))
+	{
+		return false;
+	}
+
+	OutResult.Payload = Header.Payload;
+	if (Header.Payload == ERPGSaveArchivePayload::SaveGame)
+	{
+		OutResult.SaveGameData = MoveTemp(Payload);
+		OutResult.bValid = true;
+		return true;
+	}
+
+	FMemoryReader PayloadReader(Payload, true);
+	OutResult.Snapshot.Serialize(PayloadReader);
+	OutResult.bValid = !PayloadReader.IsError();
+	return OutResult.bValid;
+}
+
+bool FRPGSaveGameArchive::ReadFromSlot(const FString& SlotName, int32 UserIndex, FRPGSaveGameLoadResult& OutResult)
+{
+	TArray<uint8> Bytes;
+	if (!UGameplayStatics::LoadDataFromSlot(Bytes, SlotName, UserIndex))
+	{
+		OutResult = FRPGSaveGameLoadResult();
+		return false;
+	}
+	return ReadFromMemory(Bytes, OutResult);
+}
+
+URPGSaveGame* FRPGSaveGameArchive::CreateSaveGame(const FRPGSaveGameLoadResult& Result)
+{
+	check(IsInGameThread());
+
+	if (!Result.bValid)
+	{
+		return nullptr;
+	}
+
+	if (Result.Payload == ERPGSaveArchivePayload::SaveGame)
+	{
+		return Cast<URPGSaveGame>(UGameplayStatics::LoadGameFromMemory(Result.SaveGameData));
+	}
+
+	URPGSaveGame* SaveGame = Cast<URPGSaveGame>(UGameplayStatics::CreateSaveGameObject(URPGSaveGame::StaticClass()));
+	Result.Snapshot.ApplyTo(*SaveGame);
+	return SaveGame;
+}
+
+URPGSaveGame* FRPGSaveGameArchive::LoadFromMemory(const TArray<uint8>& Bytes)
+{
+	FRPGSaveGameLoadResult Result;
+	ReadFromMemory(Bytes, Result);
+	return CreateSaveGame(Result);
+}
+
+URPGSaveGame* FRPGSaveGameArchive::LoadFromSlot(const FString& SlotName, int32 UserIndex)
+{
+	FRPGSaveGameLoadResult Result;
+	ReadFromSlot(SlotName, UserIndex, Result);
+	return CreateSaveGame(Result);
+}
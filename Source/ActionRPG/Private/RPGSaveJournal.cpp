@@ -0,0 +1,366 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "RPGSaveJournal.h"
+#include "RPGSaveGame.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace RPGSaveJournal
+{
+	/** 文件头，标识和格式版本 */
+	/** File header, magic and format version */
+	static constexpr uint32 Magic = 0x4A475052; // "RPGJ"
+	static constexpr uint32 Version = 1;
+	static constexpr int32 HeaderSize = sizeof(uint32) * 2;
+
+	/** 每条记录前的长度和 CRC */
+	/** Size and CRC in front of every record */
+	static constexpr int32 FrameHeaderSize = sizeof(uint32) * 2;
+
+	/** 一条记录的上限，超过的认为是损坏的 */
+	/** Upper bound of a record, anything larger is treated as corruption */
+	static constexpr uint32 MaxRecordSize = 1024;
+
+	static void SerializeItemData(FArchive& Ar, FRPGItemData& ItemData)
+	{
+		Ar << ItemData.ItemCount;
+		Ar << ItemData.ItemLevel;
+	}
+
+	static void SerializeItemSlot(FArchive& Ar, FRPGItemSlot& ItemSlot)
+	{
+		Ar << ItemSlot.ItemType;
+		Ar << ItemSlot.SlotNumber;
+	}
+}
+
+FRPGSaveJournal::FRPGSaveJournal(const FString& InSlotName)
+	: SlotName(InSlotName)
+	, FileState(MakeShared<FFileState, ESPMode::ThreadSafe>())
+{
+	// 和 ISaveGameSystem 在桌面平台上保存 .sav 的目录相同
+	// Same directory the desktop save game system writes <Slot>.sav to
+	JournalPath = FPaths::ProjectSavedDir() / TEXT("SaveGames") / SlotName + TEXT(".journal");
+	CompactingPath = JournalPath + TEXT(".compacting");
+
+	FileState->JournalPath = JournalPath;
+	FileState->CompactingPath = CompactingPath;
+}
+
+FRPGSaveJournal::~FRPGSaveJournal()
+{
+	EnqueueFileOperation([](FFileState& State)
+	{
+		State.CloseWriter();
+	});
+	WaitForWrites();
+}
+
+void FRPGSaveJournal::RecordItem(const FPrimaryAssetId& ItemId, const FRPGItemData* ItemData)
+{
+	TArray<uint8> Payload;
+	FMemoryWriter Ar(Payload);
+
+	uint8 Op = static_cast<uint8>(ItemData ? EOp::SetItem : EOp::RemoveItem);
+	FPrimaryAssetId Id = ItemId;
+	Ar << Op;
+	Ar << Id;
+
+	if (ItemData)
+	{
+		FRPGItemData Data = *ItemData;
+		RPGSaveJournal::SerializeItemData(Ar, Data);
+	}
+
+	AppendRecord(Payload);
+}
+
+void FRPGSaveJournal::RecordSlot(const FRPGItemSlot& ItemSlot, const FPrimaryAssetId& ItemId)
+{
+	TArray<uint8> Payload;
+	FMemoryWriter Ar(Payload);
+
+	uint8 Op = static_cast<uint8>(EOp::SetSlot);
+	FRPGItemSlot Slot = ItemSlot;
+	FPrimaryAssetId Id = ItemId;
+	Ar << Op;
+	RPGSaveJournal::SerializeItemSlot(Ar, Slot);
+	Ar << Id;
+
+	AppendRecord(Payload);
+}
+
+void FRPGSaveJournal::AppendRecord(const TArray<uint8>& Payload)
+{
+	FMemoryWriter Ar(PendingBytes, false, true);
+
+	uint32 Size = Payload.Num();
+	uint32 Crc = FCrc::MemCrc32(Payload.GetData(), Payload.Num());
+	Ar << Size;
+	Ar << Crc;
+	Ar.Serialize(const_cast<uint8*>(Payload.GetData()), Payload.Num());
+
+	NumPendingRecords++;
+}
+
+bool FRPGSaveJournal::Flush()
+{
+	// 失败的追加之后的记录也不能依赖，由完整存档代替
+	// Records after a failed append cannot be relied on either, a snapshot replaces them
+	if (FileState->bAppendFailed.exchange(false))
+	{
+		DiscardPending();
+		return false;
+	}
+
+	if (NumPendingRecords == 0)
+	{
+		return true;
+	}
+
+	EnqueueFileOperation([Bytes = MoveTemp(PendingBytes)](FFileState& State)
+	{
+		State.Append(Bytes);
+	});
+
+	NumRecords += NumPendingRecords;
+	DiscardPending();
+	return true;
+}
+
+void FRPGSaveJournal::WaitForWrites()
+{
+	if (WriteTask.IsValid())
+	{
+		WriteTask.Wait();
+	}
+}
+
+void FRPGSaveJournal::DiscardPending()
+{
+	PendingBytes.Reset();
+	NumPendingRecords = 0;
+}
+
+void FRPGSaveJournal::BeginCompaction()
+{
+	NumRecords = 0;
+	EnqueueFileOperation([](FFileState& State)
+	{
+		State.BeginCompaction();
+	});
+}
+
+void FRPGSaveJournal::EndCompaction(bool bSnapshotWritten)
+{
+	if (bSnapshotWritten)
+	{
+		EnqueueFileOperation([](FFileState& State)
+		{
+			IFileManager::Get().Delete(*State.CompactingPath, false, false, true);
+		});
+	}
+}
+
+int32 FRPGSaveJournal::Replay(URPGSaveGame* SaveGame)
+{
+	check(SaveGame);
+	WaitForWrites();
+
+	// 先重放被压缩的日志，它的记录比当前日志早
+	// The compacting journal holds older records than the current one
+	const int32 NumCompacting = ReplayFile(CompactingPath, SaveGame);
+	const int32 NumCurrent = ReplayFile(JournalPath, SaveGame);
+
+	NumRecords = NumCompacting + NumCurrent;
+	return NumRecords;
+}
+
+int32 FRPGSaveJournal::ReplayFile(const FString& Path, URPGSaveGame* SaveGame)
+{
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *Path, FILEREAD_Silent))
+	{
+		return 0;
+	}
+
+	FMemoryReader Ar(Bytes);
+	uint32 Magic = 0;
+	uint32 Version = 0;
+	Ar << Magic;
+	Ar << Version;
+
+	if (Ar.IsError() || Magic != RPGSaveJournal::Magic || Version != RPGSaveJournal::Version)
+	{
+		UE_LOG(LogActionRPG, Warning, TEXT("FRPGSaveJournal: Ignoring %s, unknown format!"), *Path);
+		return 0;
+	}
+
+	int32 NumApplied = 0;
+	while (Ar.Tell() + RPGSaveJournal::FrameHeaderSize <= Bytes.Num())
+	{
+		uint32 Size = 0;
+		uint32 Crc = 0;
+		Ar << Size;
+		Ar << Crc;
+
+		const int64 PayloadOffset = Ar.Tell();
+		if (Size > RPGSaveJournal::MaxRecordSize || PayloadOffset + Size > Bytes.Num()
+			|| FCrc::MemCrc32(Bytes.GetData() + PayloadOffset, Size) != Crc)
+		{
+			// 写到一半的记录，只会出现在文件末尾
+			// Torn write, only the tail of the file can be affected
+			UE_LOG(LogActionRPG, Warning, TEXT("FRPGSaveJournal: Ignoring damaged record at offset %lld of %s"), PayloadOffset, *Path);
+			break;
+		}
+
+		TArray<uint8> Payload(Bytes.GetData() + PayloadOffset, Size);
+		FMemoryReader RecordAr(Payload);
+
+		uint8 Op = 0;
+		RecordAr << Op;
+
+		switch (static_cast<EOp>(Op))
+		{
+		case EOp::SetItem:
+		{
+			FPrimaryAssetId ItemId;
+			FRPGItemData ItemData;
+			RecordAr << ItemId;
+			RPGSaveJournal::SerializeItemData(RecordAr, ItemData);
+			SaveGame->InventoryData.Add(ItemId, ItemData);
+			break;
+		}
+		case EOp::RemoveItem:
+		{
+			FPrimaryAssetId ItemId;
+			RecordAr << ItemId;
+			SaveGame->InventoryData.Remove(ItemId);
+			break;
+		}
+		case EOp::SetSlot:
+		{
+			FRPGItemSlot ItemSlot;
+			FPrimaryAssetId ItemId;
+			RPGSaveJournal::SerializeItemSlot(RecordAr, ItemSlot);
+			RecordAr << ItemId;
+			SaveGame->SlottedItems.Add(ItemSlot, ItemId);
+			break;
+		}
+		default:
+			UE_LOG(LogActionRPG, Warning, TEXT("FRPGSaveJournal: Unknown record %d in %s"), Op, *Path);
+			break;
+		}
+
+		Ar.Seek(PayloadOffset + Size);
+		NumApplied++;
+	}
+
+	return NumApplied;
+}
+
+void FRPGSaveJournal::DeleteFiles()
+{
+	DiscardPending();
+	NumRecords = 0;
+
+	EnqueueFileOperation([](FFileState& State)
+	{
+		State.CloseWriter();
+		IFileManager::Get().Delete(*State.JournalPath, false, false, true);
+		IFileManager::Get().Delete(*State.CompactingPath, false, false, true);
+	});
+}
+
+void FRPGSaveJournal::EnqueueFileOperation(TUniqueFunction<void(FFileState&)> Operation)
+{
+	auto Run = [State = FileState, Operation = MoveTemp(Operation)]()
+	{
+		Operation(*State);
+	};
+
+	if (WriteTask.IsValid())
+	{
+		WriteTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, MoveTemp(Run), UE::Tasks::Prerequisites(WriteTask));
+	}
+	else
+	{
+		WriteTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, MoveTemp(Run));
+	}
+}
+
+void FRPGSaveJournal::FFileState::Append(const TArray<uint8>& Bytes)
+{
+	if (!Writer)
+	{
+		Writer.Reset(IFileManager::Get().CreateFileWriter(*JournalPath, FILEWRITE_Append | FILEWRITE_AllowRead));
+		if (!Writer)
+		{
+			UE_LOG(LogActionRPG, Warning, TEXT("FRPGSaveJournal: Failed to open %s!"), *JournalPath);
+			bAppendFailed = true;
+			return;
+		}
+
+		// 新文件需要写入文件头
+		// A new file starts with the header
+		if (Writer->TotalSize() == 0)
+		{
+			uint32 Magic = RPGSaveJournal::Magic;
+			uint32 Version = RPGSaveJournal::Version;
+			*Writer << Magic;
+			*Writer << Version;
+		}
+	}
+
+	Writer->Serialize(const_cast<uint8*>(Bytes.GetData()), Bytes.Num());
+	Writer->Flush();
+
+	if (Writer->IsError())
+	{
+		UE_LOG(LogActionRPG, Warning, TEXT("FRPGSaveJournal: Failed to append to %s!"), *JournalPath);
+		CloseWriter();
+		bAppendFailed = true;
+	}
+}
+
+void FRPGSaveJournal::FFileState::BeginCompaction()
+{
+	CloseWriter();
+
+	IFileManager& FileManager = IFileManager::Get();
+	if (!FileManager.FileExists(*JournalPath))
+	{
+		return;
+	}
+
+	if (!FileManager.FileExists(*CompactingPath))
+	{
+		FileManager.Move(*CompactingPath, *JournalPath);
+		return;
+	}
+
+	// 上一次压缩失败了，把当前日志的记录接到被压缩的日志后面，两者都要在新存档写入之前保留
+	// The previous compaction failed, chain the current records after it so both survive until a snapshot lands
+	TArray<uint8> JournalBytes;
+	if (FFileHelper::LoadFileToArray(JournalBytes, *JournalPath) && JournalBytes.Num() > RPGSaveJournal::HeaderSize)
+	{
+		TUniquePtr<FArchive> CompactingWriter(FileManager.CreateFileWriter(*CompactingPath, FILEWRITE_Append));
+		if (CompactingWriter)
+		{
+			CompactingWriter->Serialize(JournalBytes.GetData() + RPGSaveJournal::HeaderSize, JournalBytes.Num() - RPGSaveJournal::HeaderSize);
+		}
+	}
+	FileManager.Delete(*JournalPath);
+}
+
+void FRPGSaveJournal::FFileState::CloseWriter()
+{
+	if (Writer)
+	{
+		Writer->Close();
+		Writer.Reset();
+	}
+}
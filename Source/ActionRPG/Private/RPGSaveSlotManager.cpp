@@ -0,0 +1,360 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "RPGSaveSlotManager.h"
+#include "RPGGameInstanceBase.h"
+#include "RPGSaveGameArchive.h"
+#include "RPGSaveJournal.h"
+#include "RPGSaveSubsystem.h"
+#include "Kismet/GameplayStatics.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace RPGSaveSlotIndex
+{
+	static constexpr uint32 Magic = 0x49475052; // "RPGI"
+	static constexpr uint32 Version = 1;
+
+	static void SerializeEntry(FArchive& Ar, FRPGSaveSlotInfo& Info)
+	{
+		Ar << Info.SlotName;
+		Ar << Info.UserIndex;
+		Ar << Info.Timestamp;
+		Ar << Info.CharacterLevel;
+		Ar << Info.ItemCount;
+		Ar << Info.SaveVersion;
+		Ar << Info.ByteSize;
+	}
+}
+
+void URPGSaveSlotManager::Deinitialize()
+{
+	FlushIndex();
+
+	Super::Deinitialize();
+}
+
+TArray<FRPGSaveSlotInfo> URPGSaveSlotManager::GetSaveSlots()
+{
+	LoadIndex();
+
+	TArray<FRPGSaveSlotInfo> Slots = Entries;
+	Slots.Sort([](const FRPGSaveSlotInfo& A, const FRPGSaveSlotInfo& B)
+	{
+		return A.Timestamp > B.Timestamp;
+	});
+	return Slots;
+}
+
+bool URPGSaveSlotManager::FindSaveSlot(const FString& SlotName, int32 UserIndex, FRPGSaveSlotInfo& OutInfo)
+{
+	LoadIndex();
+
+	if (const FRPGSaveSlotInfo* Entry = FindEntry(SlotName, UserIndex))
+	{
+		OutInfo = *Entry;
+		return true;
+	}
+	return false;
+}
+
+void URPGSaveSlotManager::SelectSaveSlot(const FString& SlotName, int32 UserIndex)
+{
+	URPGGameInstanceBase* GameInstance = GetRPGGameInstance();
+	if (!GameInstance || (GameInstance->SaveSlot == SlotName && GameInstance->SaveUserIndex == UserIndex))
+	{
+		return;
+	}
+
+	// 保存调度器在开始写入时才读取 slot ，切换前必须写完旧 slot 等待的保存
+	// The scheduler picks the slot when a write starts, so pending saves of the old slot have to land before switching
+	if (URPGSaveSubsystem* SaveSubsystem = GameInstance->GetSubsystem<URPGSaveSubsystem>())
+	{
+		SaveSubsystem->CancelLoad();
+		SaveSubsystem->FlushBlocking();
+	}
+
+	// 旧的角色不能留到新 slot 加载完成，否则这段时间的保存和日志会把旧数据写进新的 slot
+	// The old character must not outlive the switch, saves and journal appends made before the new slot arrives would write it into the new slot
+	GameInstance->CurrentSaveGame = nullptr;
+	GameInstance->SaveJournal.Reset();
+
+	GameInstance->SaveSlot = SlotName;
+	GameInstance->SaveUserIndex = UserIndex;
+	GameInstance->LoadOrCreateSaveGameAsync();
+}
+
+bool URPGSaveSlotManager::DeleteSaveSlot(const FString& SlotName, int32 UserIndex)
+{
+	URPGGameInstanceBase* GameInstance = GetRPGGameInstance();
+	if (GameInstance && GameInstance->SaveSlot == SlotName && GameInstance->SaveUserIndex == UserIndex)
+	{
+		UE_LOG(LogActionRPG, Warning, TEXT("URPGSaveSlotManager: Cannot delete the active save slot %s"), *SlotName);
+		return false;
+	}
+
+	LoadIndex();
+
+	UGameplayStatics::DeleteGameInSlot(SlotName, UserIndex);
+	FRPGSaveJournal(SlotName).DeleteFiles();
+
+	const int32 NumRemoved = Entries.RemoveAll([&SlotName, UserIndex](const FRPGSaveSlotInfo& Entry)
+	{
+		return Entry.SlotName == SlotName && Entry.UserIndex == UserIndex;
+	});
+
+	if (NumRemoved > 0)
+	{
+		WriteIndex();
+	}
+	return true;
+}
+
+void URPGSaveSlotManager::HandleSlotWritten(const FRPGSaveSlotInfo& Info)
+{
+	LoadIndex();
+
+	FRPGSaveSlotInfo* Entry = FindEntry(Info.SlotName, Info.UserIndex);
+	if (!Entry)
+	{
+		Entry = &Entries.AddDefaulted_GetRef();
+	}
+
+	// 退出时可能已经没有角色，保留上一次的等级
+	// There may be no character left on shutdown, keep the last known level then
+	const int32 CharacterLevel = Info.CharacterLevel > 0 ? Info.CharacterLevel : Entry->CharacterLevel;
+	*Entry = Info;
+	Entry->CharacterLevel = CharacterLevel;
+
+	WriteIndex();
+}
+
+void URPGSaveSlotManager::HandleJournalAppended(const FString& SlotName, int32 UserIndex, int32 ItemCount, const UE::Tasks::FTask& JournalWriteTask)
+{
+	LoadIndex();
+
+	// 日志追加的时候完整存档没有写入，只更新道具数量和时间
+	// Only the item count and time change, the snapshot itself was not rewritten
+	FRPGSaveSlotInfo* Entry = FindEntry(SlotName, UserIndex);
+	if (Entry && Entry->ItemCount != ItemCount)
+	{
+		Entry->ItemCount = ItemCount;
+		Entry->Timestamp = FDateTime::UtcNow();
+		WriteIndex(JournalWriteTask);
+	}
+}
+
+void URPGSaveSlotManager::FlushIndex()
+{
+	if (IndexWriteTask.IsValid())
+	{
+		IndexWriteTask.Wait();
+	}
+}
+
+void URPGSaveSlotManager::LoadIndex()
+{
+	if (bIndexLoaded)
+	{
+		MergeReconciledSlots();
+		return;
+	}
+	bIndexLoaded = true;
+
+	ReadIndexFile();
+	if (ReconcileIndex())
+	{
+		WriteIndex();
+	}
+}
+
+void URPGSaveSlotManager::ReadIndexFile()
+{
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *GetIndexPath(), FILEREAD_Silent))
+	{
+		return;
+	}
+
+	FMemoryReader Ar(Bytes);
+	uint32 Magic = 0;
+	uint32 Version = 0;
+	int32 NumEntries = 0;
+	Ar << Magic;
+	Ar << Version;
+	Ar << NumEntries;
+
+	if (Ar.IsError() || Magic != RPGSaveSlotIndex::Magic || Version != RPGSaveSlotIndex::Version || NumEntries < 0)
+	{
+		UE_LOG(LogActionRPG, Warning, TEXT("URPGSaveSlotManager: Ignoring %s, unknown format!"), *GetIndexPath());
+		return;
+	}
+
+	for (int32 Index = 0; Index < NumEntries && !Ar.IsError(); Index++)
+	{
+		FRPGSaveSlotInfo Info;
+		RPGSaveSlotIndex::SerializeEntry(Ar, Info);
+		if (!Ar.IsError())
+		{
+			Entries.Add(MoveTemp(Info));
+		}
+	}
+}
+
+bool URPGSaveSlotManager::ReconcileIndex()
+{
+	// 已经删除的 slot 从索引中移除
+	// Drop entries whose slot was deleted behind our back
+	bool bChanged = Entries.RemoveAll([](const FRPGSaveSlotInfo& Entry)
+	{
+		return !UGameplayStatics::DoesSaveGameExist(Entry.SlotName, Entry.UserIndex);
+	}) > 0;
+
+	// 索引之前写入的存档，或者其他程序写入的存档，只在第一次发现时在工作线程上读取一次
+	// Slots written before the index existed, or by something else, are read once on a worker when first found
+	TArray<FRPGSaveSlotInfo> UnindexedSlots;
+	TArray<FString> SaveFiles;
+	IFileManager::Get().FindFiles(SaveFiles, *(GetSaveGamesDir() / TEXT("*.sav")), true, false);
+
+	for (const FString& SaveFile : SaveFiles)
+	{
+		const FString SlotName = FPaths::GetBaseFilename(SaveFile);
+		const bool bIndexed = Entries.ContainsByPredicate([&SlotName](const FRPGSaveSlotInfo& Entry)
+		{
+			return Entry.SlotName == SlotName;
+		});
+		if (bIndexed)
+		{
+			continue;
+		}
+
+		// 文件名中没有 UserIndex ，桌面平台上的存档都是 0
+		// The file name does not carry the user index, desktop platforms always save with 0
+		const FString SavePath = GetSaveGamesDir() / SaveFile;
+		FRPGSaveSlotInfo& Info = Entries.AddDefaulted_GetRef();
+		Info.SlotName = SlotName;
+		Info.Timestamp = IFileManager::Get().GetTimeStamp(*SavePath);
+		Info.ByteSize = IFileManager::Get().FileSize(*SavePath);
+		UnindexedSlots.Add(Info);
+		bChanged = true;
+	}
+
+	// 存档的反序列化不放在游戏线程上，旧的 USaveGame 格式只能在游戏线程上读取，道具数量留到下一次写入时更新
+	// Keep save deserialization off the game thread. Legacy USaveGame data can only be read on the game thread, so its item count waits for the next write
+	if (UnindexedSlots.Num() > 0)
+	{
+		ReconcileReadTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [Slots = MoveTemp(UnindexedSlots)]() mutable
+		{
+			for (FRPGSaveSlotInfo& Info : Slots)
+			{
+				FRPGSaveGameLoadResult Result;
+				if (FRPGSaveGameArchive::ReadFromSlot(Info.SlotName, Info.UserIndex, Result) && Result.bValid && Result.Payload == ERPGSaveArchivePayload::Snapshot)
+				{
+					Info.ItemCount = Result.Snapshot.InventoryData.Num();
+					Info.SaveVersion = Result.Snapshot.SaveGameVersion;
+				}
+			}
+			return MoveTemp(Slots);
+		});
+	}
+	return bChanged;
+}
+
+void URPGSaveSlotManager::MergeReconciledSlots()
+{
+	if (!ReconcileReadTask.IsValid() || !ReconcileReadTask.IsCompleted())
+	{
+		return;
+	}
+
+	bool bChanged = false;
+	for (const FRPGSaveSlotInfo& Info : ReconcileReadTask.GetResult())
+	{
+		// 读取期间重新写入的 slot 在索引中已经是新的数据
+		// A slot written again during the read already has newer data in the index
+		FRPGSaveSlotInfo* Entry = FindEntry(Info.SlotName, Info.UserIndex);
+		if (Entry && Entry->Timestamp == Info.Timestamp && (Entry->ItemCount != Info.ItemCount || Entry->SaveVersion != Info.SaveVersion))
+		{
+			Entry->ItemCount = Info.ItemCount;
+			Entry->SaveVersion = Info.SaveVersion;
+			bChanged = true;
+		}
+	}
+	ReconcileReadTask = UE::Tasks::TTask<TArray<FRPGSaveSlotInfo>>();
+
+	if (bChanged)
+	{
+		WriteIndex();
+	}
+}
+
+void URPGSaveSlotManager::WriteIndex(const UE::Tasks::FTask& Prerequisite)
+{
+	// 索引很小，在游戏线程上序列化，文件操作在工作线程上进行
+	// The index is tiny, serialize it here and leave the file operations to the worker
+	TArray<uint8> Bytes;
+	FMemoryWriter Ar(Bytes);
+
+	uint32 Magic = RPGSaveSlotIndex::Magic;
+	uint32 Version = RPGSaveSlotIndex::Version;
+	int32 NumEntries = Entries.Num();
+	Ar << Magic;
+	Ar << Version;
+	Ar << NumEntries;
+	for (FRPGSaveSlotInfo& Entry : Entries)
+	{
+		RPGSaveSlotIndex::SerializeEntry(Ar, Entry);
+	}
+
+	auto WriteFile = [Bytes = MoveTemp(Bytes)]()
+	{
+		const FString IndexPath = GetIndexPath();
+		const FString TempPath = IndexPath + TEXT(".tmp");
+		if (!FFileHelper::SaveArrayToFile(Bytes, *TempPath) || !IFileManager::Get().Move(*IndexPath, *TempPath, true))
+		{
+			UE_LOG(LogActionRPG, Warning, TEXT("URPGSaveSlotManager: Failed to write %s!"), *IndexPath);
+		}
+	};
+
+	// 每次写入都排在上一次之后，文件中总是最后一次更新的索引
+	// Each write runs after the previous one, so the file always ends up with the latest index
+	if (IndexWriteTask.IsValid() && Prerequisite.IsValid())
+	{
+		IndexWriteTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, MoveTemp(WriteFile), UE::Tasks::Prerequisites(IndexWriteTask, Prerequisite));
+	}
+	else if (IndexWriteTask.IsValid() || Prerequisite.IsValid())
+	{
+		IndexWriteTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, MoveTemp(WriteFile), UE::Tasks::Prerequisites(IndexWriteTask.IsValid() ? IndexWriteTask : Prerequisite));
+	}
+	else
+	{
+		IndexWriteTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, MoveTemp(WriteFile));
+	}
+}
+
+FRPGSaveSlotInfo* URPGSaveSlotManager::FindEntry(const FString& SlotName, int32 UserIndex)
+{
+	return Entries.FindByPredicate([&SlotName, UserIndex](const FRPGSaveSlotInfo& Entry)
+	{
+		return Entry.SlotName == SlotName && Entry.UserIndex == UserIndex;
+	});
+}
+
+URPGGameInstanceBase* URPGSaveSlotManager::GetRPGGameInstance() const
+{
+	return Cast<URPGGameInstanceBase>(GetGameInstance());
+}
+
+FString URPGSaveSlotManager::GetIndexPath()
+{
+	// 和存档日志在同一个目录
+	// Same directory as the save journals
+	return GetSaveGamesDir() / TEXT("SaveIndex.bin");
+}
+
+FString URPGSaveSlotManager::GetSaveGamesDir()
+{
+	return FPaths::ProjectSavedDir() / TEXT("SaveGames");
+}
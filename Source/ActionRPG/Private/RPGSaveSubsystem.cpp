@@ -0,0 +1,418 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "RPGSaveSubsystem.h"
+#include "RPGGameInstanceBase.h"
+#include "RPGSaveGame.h"
+#include "RPGSaveGameArchive.h"
+#include "RPGSaveSlotManager.h"
+#include "Kismet/GameplayStatics.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Saves Requested"), STAT_SavesRequested, STATGROUP_RPGSave);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Saves Written"), STAT_SavesWritten, STATGROUP_RPGSave);
+DECLARE_MEMORY_STAT(TEXT("Save Bytes Written"), STAT_SaveBytesWritten, STATGROUP_RPGSave);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Last Save Latency (ms)"), STAT_SaveLatency, STATGROUP_RPGSave);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Last Save Game Thread Time (ms)"), STAT_SaveGameThreadTime, STATGROUP_RPGSave);
+DECLARE_CYCLE_STAT(TEXT("Serialize Save Game"), STAT_SerializeSaveGame, STATGROUP_RPGSave);
+DECLARE_CYCLE_STAT(TEXT("Capture Save Snapshot"), STAT_CaptureSaveSnapshot, STATGROUP_RPGSave);
+DECLARE_CYCLE_STAT(TEXT("Write Save Archive"), STAT_WriteSaveArchive, STATGROUP_RPGSave);
+DECLARE_CYCLE_STAT(TEXT("Read Save Archive"), STAT_ReadSaveArchive, STATGROUP_RPGSave);
+DECLARE_CYCLE_STAT(TEXT("Create Loaded Save Game"), STAT_CreateLoadedSaveGame, STATGROUP_RPGSave);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Last Load Latency (ms)"), STAT_LoadLatency, STATGROUP_RPGSave);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Saves Migrated"), STAT_SavesMigrated, STATGROUP_RPGSave);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Last Migration (ms)"), STAT_SaveMigrationTime, STATGROUP_RPGSave);
+
+void URPGSaveSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	// 索引要在最后一次写入完成之后才能关闭
+	// The slot index has to outlive the final flush in Deinitialize
+	Collection.InitializeDependency<URPGSaveSlotManager>();
+
+	TickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &URPGSaveSubsystem::Tick));
+	PreLoadMapHandle = FCoreUObjectDelegates::PreLoadMap.AddUObject(this, &URPGSaveSubsystem::HandlePreLoadMap);
+}
+
+void URPGSaveSubsystem::Deinitialize()
+{
+	CancelLoad();
+	FlushBlocking();
+
+	FTSTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+	FCoreUObjectDelegates::PreLoadMap.Remove(PreLoadMapHandle);
+
+	Super::Deinitialize();
+}
+
+bool URPGSaveSubsystem::RequestSave(ERPGSavePriority Priority)
+{
+	URPGGameInstanceBase* GameInstance = GetRPGGameInstance();
+	if (!GameInstance || !GameInstance->bSavingEnabled)
+	{
+		return false;
+	}
+
+	Stats.SavesRequested++;
+	INC_DWORD_STAT(STAT_SavesRequested);
+
+	const double Now = FPlatformTime::Seconds();
+	double Window = 0.0;
+	switch (Priority)
+	{
+	case ERPGSavePriority::Background:
+		Window = BackgroundDeferralSeconds;
+		break;
+	case ERPGSavePriority::Normal:
+		Window = DebounceSeconds;
+		break;
+	default:
+		break;
+	}
+
+	// 新的请求只会让截止时间提前，不会推迟，所以连续的请求不会让保存一直等下去
+	// A request can only pull the deadline in, never push it out, so a stream of requests cannot starve the write
+	if (!bSavePending)
+	{
+		bSavePending = true;
+		PendingSince = Now;
+		PendingDeadline = Now + Window;
+	}
+	else
+	{
+		PendingDeadline = FMath::Min(PendingDeadline, Now + Window);
+	}
+
+	if (Priority == ERPGSavePriority::Immediate)
+	{
+		Flush();
+	}
+	return true;
+}
+
+void URPGSaveSubsystem::Flush()
+{
+	if (!bSavePending)
+	{
+		return;
+	}
+
+	// 正在写入时，当前的写入完成后马上开始下一次
+	// While a write is in flight the next one starts as soon as it completes
+	PendingDeadline = 0.0;
+	if (!bWriting)
+	{
+		StartWrite();
+	}
+}
+
+void URPGSaveSubsystem::FlushBlocking()
+{
+	if (bWriting)
+	{
+		WriteTask.Wait();
+		FinishWrite();
+	}
+
+	if (bSavePending)
+	{
+		StartWrite();
+		if (bWriting)
+		{
+			WriteTask.Wait();
+			FinishWrite();
+		}
+	}
+}
+
+bool URPGSaveSubsystem::StartLoad()
+{
+	URPGGameInstanceBase* GameInstance = GetRPGGameInstance();
+	if (!GameInstance || bLoading)
+	{
+		return false;
+	}
+
+	GameInstance->GetSaveSlotInfo(LoadSlotName, LoadUserIndex);
+	LoadStartedAt = FPlatformTime::Seconds();
+	bLoading = true;
+
+	auto ReadSlot = [SlotName = LoadSlotName, UserIndex = LoadUserIndex]()
+	{
+		SCOPE_CYCLE_COUNTER(STAT_ReadSaveArchive);
+
+		FRPGSaveGameLoadResult Result;
+		FRPGSaveGameArchive::ReadFromSlot(SlotName, UserIndex, Result);
+		return Result;
+	};
+
+	// 不能读到写了一半的文件，读取排在正在进行的写入之后
+	// Never read a half written slot, the load waits for the in-flight write
+	if (bWriting)
+	{
+		LoadTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, MoveTemp(ReadSlot), UE::Tasks::Prerequisites(WriteTask));
+	}
+	else
+	{
+		LoadTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, MoveTemp(ReadSlot));
+	}
+	return true;
+}
+
+bool URPGSaveSubsystem::WaitForLoad(float TimeoutSeconds)
+{
+	if (!bLoading)
+	{
+		return true;
+	}
+
+	if (!LoadTask.Wait(FTimespan::FromSeconds(FMath::Max(TimeoutSeconds, 0.0f))))
+	{
+		UE_LOG(LogActionRPG, Warning, TEXT("URPGSaveSubsystem: Save slot %s did not load within %.2f seconds"), *LoadSlotName, TimeoutSeconds);
+		return false;
+	}
+
+	FinishLoad();
+	return true;
+}
+
+void URPGSaveSubsystem::CancelLoad()
+{
+	// 任务无法中断，只是丢弃它的结果
+	// The task cannot be interrupted, its result is simply dropped
+	bLoading = false;
+	LoadTask = {};
+}
+
+bool URPGSaveSubsystem::IsLoading() const
+{
+	return bLoading;
+}
+
+bool URPGSaveSubsystem::HasPendingSave() const
+{
+	return bSavePending;
+}
+
+bool URPGSaveSubsystem::IsWriting() const
+{
+	return bWriting;
+}
+
+void URPGSaveSubsystem::RecordMigration(double Seconds)
+{
+	const float MigrationMs = float(Seconds * 1000.0);
+	Stats.SavesMigrated++;
+	Stats.LastMigrationMs = MigrationMs;
+	INC_DWORD_STAT(STAT_SavesMigrated);
+	SET_FLOAT_STAT(STAT_SaveMigrationTime, MigrationMs);
+}
+
+FRPGSaveStats URPGSaveSubsystem::GetStats() const
+{
+	return Stats;
+}
+
+bool URPGSaveSubsystem::Tick(float DeltaTime)
+{
+	if (bLoading && LoadTask.IsCompleted())
+	{
+		FinishLoad();
+	}
+
+	if (bWriting && WriteTask.IsCompleted())
+	{
+		FinishWrite();
+	}
+
+	if (!bWriting && bSavePending && FPlatformTime::Seconds() >= PendingDeadline)
+	{
+		StartWrite();
+	}
+	return true;
+}
+
+void URPGSaveSubsystem::StartWrite()
+{
+	check(!bWriting);
+
+	// 读取期间 CurrentSaveGame 还不是这个 slot 的数据，保存留到读取完成之后
+	// While a load is in flight CurrentSaveGame does not hold this slot yet, the save stays pending until the load completed
+	if (bLoading)
+	{
+		return;
+	}
+	bSavePending = false;
+
+	URPGGameInstanceBase* GameInstance = GetRPGGameInstance();
+	URPGSaveGame* SaveGame = GameInstance ? GameInstance->GetCurrentSaveGame() : nullptr;
+	if (!SaveGame || !GameInstance->bSavingEnabled)
+	{
+		return;
+	}
+
+	// 存档将要包含目前的全部改变，通知 GameInstance 开始压缩日志
+	// The snapshot is about to contain every change so far, let the game instance start compacting its journal
+	GameInstance->HandleSaveWriteStarted();
+
+	GameInstance->GetSaveSlotInfo(WriteSlotName, WriteUserIndex);
+	WriteRequestedAt = PendingSince;
+
+	// 索引中的信息描述这次写入的数据，写入成功之后才会更新
+	// Metadata describing this write, it only reaches the slot index once the write succeeded
+	WriteSlotInfo = FRPGSaveSlotInfo();
+	WriteSlotInfo.SlotName = WriteSlotName;
+	WriteSlotInfo.UserIndex = WriteUserIndex;
+	WriteSlotInfo.CharacterLevel = GameInstance->GetSaveCharacterLevel();
+	WriteSlotInfo.ItemCount = SaveGame->InventoryData.Num();
+	WriteSlotInfo.SaveVersion = ERPGSaveGameVersion::LatestVersion;
+
+	const ERPGSaveCompression Compression = GameInstance->SaveCompression;
+	const double GameThreadStart = FPlatformTime::Seconds();
+
+	if (GameInstance->bSerializeSaveOffGameThread)
+	{
+		// 游戏线程上只拷贝数据，序列化、压缩和写入都在工作线程上进行
+		// Only copy the data on the game thread, serialization, compression and the write run on the worker
+		TSharedPtr<const FRPGSaveGameSnapshot> Snapshot;
+		{
+			SCOPE_CYCLE_COUNTER(STAT_CaptureSaveSnapshot);
+			Snapshot = FRPGSaveGameSnapshot::Capture(*SaveGame);
+		}
+
+		WriteTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [Snapshot, Compression, SlotName = WriteSlotName, UserIndex = WriteUserIndex]() -> int64
+		{
+			SCOPE_CYCLE_COUNTER(STAT_WriteSaveArchive);
+
+			TArray<uint8> SaveData;
+			if (!FRPGSaveGameArchive::Write(*Snapshot, Compression, SaveData) || !UGameplayStatics::SaveDataToSlot(SaveData, SlotName, UserIndex))
+			{
+				return INDEX_NONE;
+			}
+			return SaveData.Num();
+		});
+	}
+	else
+	{
+		// 在游戏线程上序列化，保证存档对象不会在写入期间被修改
+		// Serialize on the game thread so the save object cannot change under the write
+		TArray<uint8> SaveData;
+		{
+			SCOPE_CYCLE_COUNTER(STAT_SerializeSaveGame);
+			if (!UGameplayStatics::SaveGameToMemory(SaveGame, SaveData))
+			{
+				UE_LOG(LogActionRPG, Warning, TEXT("URPGSaveSubsystem: Failed to serialize the save game!"));
+				Stats.SavesFailed++;
+				GameInstance->HandleAsyncSave(WriteSlotName, WriteUserIndex, false);
+				return;
+			}
+		}
+
+		// 压缩和实际的写入在工作线程上进行，和 UGameplayStatics::AsyncSaveGameToSlot 相同
+		// Compression and the write itself happen on a worker, like UGameplayStatics::AsyncSaveGameToSlot
+		WriteTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [SaveData = MoveTemp(SaveData), Compression, SlotName = WriteSlotName, UserIndex = WriteUserIndex]() -> int64
+		{
+			if (Compression == ERPGSaveCompression::None)
+			{
+				return UGameplayStatics::SaveDataToSlot(SaveData, SlotName, UserIndex) ? SaveData.Num() : INDEX_NONE;
+			}
+
+			SCOPE_CYCLE_COUNTER(STAT_WriteSaveArchive);
+
+			TArray<uint8> ArchiveData;
+			if (!FRPGSaveGameArchive::WriteSaveGameData(SaveData, Compression, ArchiveData) || !UGameplayStatics::SaveDataToSlot(ArchiveData, SlotName, UserIndex))
+			{
+				return INDEX_NONE;
+			}
+			return ArchiveData.Num();
+		});
+	}
+
+	const float GameThreadMs = float((FPlatformTime::Seconds() - GameThreadStart) * 1000.0);
+	Stats.LastGameThreadMs = GameThreadMs;
+	Stats.MaxGameThreadMs = FMath::Max(Stats.MaxGameThreadMs, GameThreadMs);
+	SET_FLOAT_STAT(STAT_SaveGameThreadTime, GameThreadMs);
+	UE_LOG(LogActionRPG, Verbose, TEXT("URPGSaveSubsystem: Spent %.3f ms on the game thread preparing slot %s"), GameThreadMs, *WriteSlotName);
+
+	bWriting = true;
+}
+
+void URPGSaveSubsystem::FinishWrite()
+{
+	check(bWriting);
+	bWriting = false;
+
+	const int64 WriteBytes = WriteTask.GetResult();
+	const bool bSuccess = WriteBytes != INDEX_NONE;
+	WriteTask = {};
+
+	if (bSuccess)
+	{
+		const float LatencyMs = float((FPlatformTime::Seconds() - WriteRequestedAt) * 1000.0);
+
+		Stats.SavesWritten++;
+		Stats.BytesWritten += WriteBytes;
+		Stats.LastLatencyMs = LatencyMs;
+		Stats.MaxLatencyMs = FMath::Max(Stats.MaxLatencyMs, LatencyMs);
+		Stats.AverageLatencyMs += (LatencyMs - Stats.AverageLatencyMs) / Stats.SavesWritten;
+
+		INC_DWORD_STAT(STAT_SavesWritten);
+		INC_MEMORY_STAT_BY(STAT_SaveBytesWritten, WriteBytes);
+		SET_FLOAT_STAT(STAT_SaveLatency, LatencyMs);
+
+		if (URPGSaveSlotManager* SlotManager = GetGameInstance()->GetSubsystem<URPGSaveSlotManager>())
+		{
+			WriteSlotInfo.Timestamp = FDateTime::UtcNow();
+			WriteSlotInfo.ByteSize = WriteBytes;
+			SlotManager->HandleSlotWritten(WriteSlotInfo);
+		}
+	}
+	else
+	{
+		UE_LOG(LogActionRPG, Warning, TEXT("URPGSaveSubsystem: Failed to write save slot %s!"), *WriteSlotName);
+		Stats.SavesFailed++;
+	}
+
+	if (URPGGameInstanceBase* GameInstance = GetRPGGameInstance())
+	{
+		GameInstance->HandleAsyncSave(WriteSlotName, WriteUserIndex, bSuccess);
+	}
+}
+
+void URPGSaveSubsystem::FinishLoad()
+{
+	check(bLoading);
+	bLoading = false;
+
+	FRPGSaveGameLoadResult Result = MoveTemp(LoadTask.GetResult());
+	LoadTask = {};
+
+	URPGGameInstanceBase* GameInstance = GetRPGGameInstance();
+	if (!GameInstance)
+	{
+		return;
+	}
+
+	const double GameThreadStart = FPlatformTime::Seconds();
+	URPGSaveGame* SaveGame = nullptr;
+	{
+		SCOPE_CYCLE_COUNTER(STAT_CreateLoadedSaveGame);
+		SaveGame = FRPGSaveGameArchive::CreateSaveGame(Result);
+	}
+	GameInstance->ApplySaveGame(SaveGame);
+
+	const double Now = FPlatformTime::Seconds();
+	const float LatencyMs = float((Now - LoadStartedAt) * 1000.0);
+	SET_FLOAT_STAT(STAT_LoadLatency, LatencyMs);
+	UE_LOG(LogActionRPG, Log, TEXT("URPGSaveSubsystem: %s save slot %s after %.2f ms, %.2f ms of it on the game thread"),
+		SaveGame ? TEXT("Loaded") : TEXT("Created"), *LoadSlotName, LatencyMs, (Now - GameThreadStart) * 1000.0);
+}
+
+void URPGSaveSubsystem::HandlePreLoadMap(const FString& MapName)
+{
+	FlushBlocking();
+}
+
+URPGGameInstanceBase* URPGSaveSubsystem::GetRPGGameInstance() const
+{
+	return Cast<URPGGameInstanceBase>(GetGameInstance());
+}
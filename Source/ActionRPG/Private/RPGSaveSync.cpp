@@ -0,0 +1,64 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "RPGSaveSync.h"
+#include "HttpModule.h"
+#include "Interfaces/IHttpRequest.h"
+#include "Interfaces/IHttpResponse.h"
+#include "GenericPlatform/GenericPlatformHttp.h"
+
+FRPGHttpSaveSyncBackend::FRPGHttpSaveSyncBackend(const FString& InBaseUrl, float InTimeoutSeconds)
+	: BaseUrl(InBaseUrl)
+	, TimeoutSeconds(InTimeoutSeconds)
+{
+	BaseUrl.RemoveFromEnd(TEXT("/"));
+}
+
+void FRPGHttpSaveSyncBackend::Upload(const FRPGSaveSyncBatch& Batch, TFunction<void(ERPGSaveSyncResult)> OnComplete)
+{
+	TSharedRef<IHttpRequest, ESPMode::ThreadSafe> Request = FHttpModule::Get().CreateRequest();
+	Request->SetURL(FString::Printf(TEXT("%s/saves/%s/%s"), *BaseUrl, *FGenericPlatformHttp::UrlEncode(Batch.UserId), *FGenericPlatformHttp::UrlEncode(Batch.SlotName)));
+	Request->SetVerb(TEXT("POST"));
+	Request->SetTimeout(TimeoutSeconds);
+	Request->SetHeader(TEXT("Content-Type"), TEXT("application/octet-stream"));
+	Request->SetHeader(TEXT("X-RPG-Sync-Kind"), Batch.bFull ? TEXT("full") : TEXT("delta"));
+	Request->SetHeader(TEXT("X-RPG-Sync-Base-Revision"), LexToString(Batch.BaseRevision));
+	Request->SetHeader(TEXT("X-RPG-Sync-Revision"), LexToString(Batch.Revision));
+	Request->SetHeader(TEXT("X-RPG-Sync-Uncompressed-Size"), LexToString(Batch.UncompressedSize));
+	Request->SetContent(Batch.Data);
+
+	// HTTP 模块在游戏线程上调用完成回调，请求没有开始时有的平台也会调用，保证只调用一次
+	// The HTTP module completes requests on the game thread. Some platforms also complete requests that failed to start, so guard against a second call
+	TSharedRef<bool> bCompleted = MakeShared<bool>(false);
+	TFunction<void(ERPGSaveSyncResult)> Complete = [bCompleted, OnComplete = MoveTemp(OnComplete)](ERPGSaveSyncResult Result)
+	{
+		if (!*bCompleted)
+		{
+			*bCompleted = true;
+			OnComplete(Result);
+		}
+	};
+
+	Request->OnProcessRequestComplete().BindLambda([Complete](FHttpRequestPtr, FHttpResponsePtr Response, bool bConnectedSuccessfully)
+	{
+		const int32 Code = bConnectedSuccessfully && Response.IsValid() ? Response->GetResponseCode() : 0;
+		if (Code == EHttpResponseCodes::Ok)
+		{
+			Complete(ERPGSaveSyncResult::Success);
+		}
+		else if (Code == EHttpResponseCodes::Conflict)
+		{
+			Complete(ERPGSaveSyncResult::NeedsFullUpload);
+		}
+		else
+		{
+			UE_LOG(LogActionRPG, Verbose, TEXT("FRPGHttpSaveSyncBackend: Upload failed with %d"), Code);
+			Complete(ERPGSaveSyncResult::Retry);
+		}
+	});
+
+	if (!Request->ProcessRequest())
+	{
+		UE_LOG(LogActionRPG, Warning, TEXT("FRPGHttpSaveSyncBackend: Failed to start request to %s"), *Request->GetURL());
+		Complete(ERPGSaveSyncResult::Retry);
+	}
+}
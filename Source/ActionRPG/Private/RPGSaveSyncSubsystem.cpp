@@ -0,0 +1,348 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "RPGSaveSyncSubsystem.h"
+#include "RPGGameInstanceBase.h"
+#include "RPGSaveGame.h"
+#include "RPGSaveGameArchive.h"
+#include "Misc/Compression.h"
+#include "Serialization/MemoryWriter.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Sync Changes Recorded"), STAT_SyncChangesRecorded, STATGROUP_RPGSave);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Sync Batches Uploaded"), STAT_SyncBatchesUploaded, STATGROUP_RPGSave);
+DECLARE_MEMORY_STAT(TEXT("Sync Bytes Uploaded"), STAT_SyncBytesUploaded, STATGROUP_RPGSave);
+DECLARE_CYCLE_STAT(TEXT("Start Sync Batch"), STAT_StartSyncBatch, STATGROUP_RPGSave);
+DECLARE_CYCLE_STAT(TEXT("Build Sync Batch"), STAT_BuildSyncBatch, STATGROUP_RPGSave);
+
+namespace RPGSaveSync
+{
+	/** 增量的格式版本，写在压缩前的数据开头 */
+	/** Version of the delta payload, first field of the uncompressed data */
+	static constexpr uint32 DeltaVersion = 1;
+
+	/** 序列化并压缩一批增量 */
+	/** Serializes and zlib compresses a delta, worker thread */
+	static void BuildDelta(FRPGSaveSyncBatch& Batch, TMap<FPrimaryAssetId, TOptional<FRPGItemData>>& Items, TMap<FRPGItemSlot, FPrimaryAssetId>& Slots)
+	{
+		TArray<uint8> Payload;
+		FMemoryWriter Ar(Payload);
+
+		uint32 Version = DeltaVersion;
+		int32 NumItems = Items.Num();
+		Ar << Version;
+		Ar << NumItems;
+		for (TPair<FPrimaryAssetId, TOptional<FRPGItemData>>& Pair : Items)
+		{
+			uint8 bRemoved = Pair.Value.IsSet() ? 0 : 1;
+			Ar << Pair.Key;
+			Ar << bRemoved;
+			if (!bRemoved)
+			{
+				Ar << Pair.Value->ItemCount;
+				Ar << Pair.Value->ItemLevel;
+			}
+		}
+
+		int32 NumSlots = Slots.Num();
+		Ar << NumSlots;
+		for (TPair<FRPGItemSlot, FPrimaryAssetId>& Pair : Slots)
+		{
+			Ar << Pair.Key.ItemType;
+			Ar << Pair.Key.SlotNumber;
+			Ar << Pair.Value;
+		}
+
+		int32 CompressedSize = FCompression::CompressMemoryBound(NAME_Zlib, Payload.Num());
+		Batch.Data.SetNumUninitialized(CompressedSize);
+		if (!FCompression::CompressMemory(NAME_Zlib, Batch.Data.GetData(), CompressedSize, Payload.GetData(), Payload.Num()))
+		{
+			Batch.Data.Reset();
+			return;
+		}
+		Batch.Data.SetNum(CompressedSize);
+		Batch.UncompressedSize = Payload.Num();
+	}
+}
+
+void URPGSaveSyncSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	TickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &URPGSaveSyncSubsystem::Tick));
+}
+
+void URPGSaveSyncSubsystem::Deinitialize()
+{
+	FTSTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+	SetBackend(nullptr);
+
+	Super::Deinitialize();
+}
+
+void URPGSaveSyncSubsystem::SetBackend(TSharedPtr<IRPGSaveSyncBackend> InBackend)
+{
+	Backend = MoveTemp(InBackend);
+
+	// 正在构建和上传的批次属于旧的后端
+	// Batches being built or uploaded belong to the previous backend, and completions of its uploads are ignored from now on
+	if (bBuilding)
+	{
+		BuildTask.Wait();
+		BuildTask = {};
+		bBuilding = false;
+	}
+	UploadSerial++;
+	bUploading = false;
+	bBatchInFlight = false;
+	InFlightBatch = FRPGSaveSyncBatch();
+	PendingItems.Reset();
+	PendingSlots.Reset();
+	NextAttemptTime = 0.0;
+	RetryDelay = 0.0f;
+	AckedRevision = 0;
+
+	bFullUploadPending = Backend.IsValid();
+	PendingSince = FPlatformTime::Seconds();
+}
+
+void URPGSaveSyncSubsystem::RecordItem(const FPrimaryAssetId& ItemId, const FRPGItemData* ItemData)
+{
+	if (!Backend)
+	{
+		return;
+	}
+
+	if (GetNumPendingChanges() == 0 && !bFullUploadPending)
+	{
+		PendingSince = FPlatformTime::Seconds();
+	}
+	PendingItems.Add(ItemId, ItemData ? TOptional<FRPGItemData>(*ItemData) : TOptional<FRPGItemData>());
+
+	Stats.ChangesRecorded++;
+	INC_DWORD_STAT(STAT_SyncChangesRecorded);
+}
+
+void URPGSaveSyncSubsystem::RecordSlot(const FRPGItemSlot& ItemSlot, const FPrimaryAssetId& ItemId)
+{
+	if (!Backend)
+	{
+		return;
+	}
+
+	if (GetNumPendingChanges() == 0 && !bFullUploadPending)
+	{
+		PendingSince = FPlatformTime::Seconds();
+	}
+	PendingSlots.Add(ItemSlot, ItemId);
+
+	Stats.ChangesRecorded++;
+	INC_DWORD_STAT(STAT_SyncChangesRecorded);
+}
+
+void URPGSaveSyncSubsystem::RequestFullUpload()
+{
+	if (!Backend)
+	{
+		return;
+	}
+
+	if (GetNumPendingChanges() == 0 && !bFullUploadPending)
+	{
+		PendingSince = FPlatformTime::Seconds();
+	}
+	bFullUploadPending = true;
+}
+
+void URPGSaveSyncSubsystem::Flush()
+{
+	bFlushRequested = true;
+}
+
+bool URPGSaveSyncSubsystem::IsSyncPending() const
+{
+	return bFullUploadPending || GetNumPendingChanges() > 0 || bBuilding || bBatchInFlight;
+}
+
+FRPGSaveSyncStats URPGSaveSyncSubsystem::GetStats() const
+{
+	return Stats;
+}
+
+bool URPGSaveSyncSubsystem::Tick(float DeltaTime)
+{
+	if (!Backend)
+	{
+		return true;
+	}
+
+	if (bBuilding)
+	{
+		if (!BuildTask.IsCompleted())
+		{
+			return true;
+		}
+
+		bBuilding = false;
+		InFlightBatch = MoveTemp(BuildTask.GetResult());
+		BuildTask = {};
+		if (InFlightBatch.Data.Num() == 0)
+		{
+			// 压缩失败，下一批重新上传完整的存档
+			// Compression failed, resync with a full upload
+			UE_LOG(LogActionRPG, Warning, TEXT("URPGSaveSyncSubsystem: Failed to build a batch for slot %s"), *InFlightBatch.SlotName);
+			bFullUploadPending = true;
+			return true;
+		}
+		bBatchInFlight = true;
+	}
+
+	const double Now = FPlatformTime::Seconds();
+	if (bUploading || Now < NextAttemptTime)
+	{
+		return true;
+	}
+
+	if (bBatchInFlight)
+	{
+		SendBatch();
+	}
+	else if (bFullUploadPending || GetNumPendingChanges() > 0)
+	{
+		if (bFlushRequested || GetNumPendingChanges() >= MaxPendingChanges || Now - PendingSince >= SyncIntervalSeconds)
+		{
+			StartBatch();
+		}
+	}
+	return true;
+}
+
+void URPGSaveSyncSubsystem::StartBatch()
+{
+	SCOPE_CYCLE_COUNTER(STAT_StartSyncBatch);
+
+	URPGGameInstanceBase* GameInstance = GetRPGGameInstance();
+	URPGSaveGame* SaveGame = GameInstance ? GameInstance->GetCurrentSaveGame() : nullptr;
+	if (!SaveGame)
+	{
+		return;
+	}
+
+	FRPGSaveSyncBatch Batch;
+	Batch.UserId = SaveGame->UserId.IsEmpty() ? TEXT("Local") : SaveGame->UserId;
+	Batch.SlotName = GameInstance->SaveSlot;
+	Batch.bFull = bFullUploadPending;
+	Batch.BaseRevision = AckedRevision;
+	Batch.Revision = AckedRevision + 1;
+
+	bFlushRequested = false;
+
+	if (Batch.bFull)
+	{
+		// 存档已经包含了所有等待的改变
+		// The save game already holds every pending change
+		bFullUploadPending = false;
+		PendingItems.Reset();
+		PendingSlots.Reset();
+
+		TSharedRef<const FRPGSaveGameSnapshot> Snapshot = FRPGSaveGameSnapshot::Capture(*SaveGame);
+		Batch.NumChanges = Snapshot->InventoryData.Num() + Snapshot->SlottedItems.Num();
+		BuildTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [Batch = MoveTemp(Batch), Snapshot]() mutable
+		{
+			SCOPE_CYCLE_COUNTER(STAT_BuildSyncBatch);
+			if (!FRPGSaveGameArchive::Write(*Snapshot, ERPGSaveCompression::Zlib, Batch.Data))
+			{
+				Batch.Data.Reset();
+			}
+			return MoveTemp(Batch);
+		});
+	}
+	else
+	{
+		// 只移动 map ，序列化和压缩都在工作线程上
+		// Only the maps are moved here, serialization and compression run on the worker
+		Batch.NumChanges = GetNumPendingChanges();
+		BuildTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [Batch = MoveTemp(Batch), Items = MoveTemp(PendingItems), Slots = MoveTemp(PendingSlots)]() mutable
+		{
+			SCOPE_CYCLE_COUNTER(STAT_BuildSyncBatch);
+			RPGSaveSync::BuildDelta(Batch, Items, Slots);
+			return MoveTemp(Batch);
+		});
+		PendingItems.Reset();
+		PendingSlots.Reset();
+	}
+	bBuilding = true;
+}
+
+void URPGSaveSyncSubsystem::SendBatch()
+{
+	bUploading = true;
+	const uint32 Serial = ++UploadSerial;
+
+	TWeakObjectPtr<URPGSaveSyncSubsystem> WeakThis(this);
+	Backend->Upload(InFlightBatch, [WeakThis, Serial](ERPGSaveSyncResult Result)
+	{
+		if (URPGSaveSyncSubsystem* StrongThis = WeakThis.Get())
+		{
+			StrongThis->HandleUploadComplete(Serial, Result);
+		}
+	});
+}
+
+void URPGSaveSyncSubsystem::HandleUploadComplete(uint32 InUploadSerial, ERPGSaveSyncResult Result)
+{
+	if (InUploadSerial != UploadSerial || !bUploading)
+	{
+		return;
+	}
+	bUploading = false;
+
+	switch (Result)
+	{
+	case ERPGSaveSyncResult::Success:
+		AckedRevision = InFlightBatch.Revision;
+		RetryDelay = 0.0f;
+		NextAttemptTime = 0.0;
+
+		Stats.BatchesUploaded++;
+		Stats.FullUploads += InFlightBatch.bFull ? 1 : 0;
+		Stats.ChangesUploaded += InFlightBatch.bFull ? 0 : InFlightBatch.NumChanges;
+		Stats.BytesUploaded += InFlightBatch.Data.Num();
+		INC_DWORD_STAT(STAT_SyncBatchesUploaded);
+		INC_MEMORY_STAT_BY(STAT_SyncBytesUploaded, InFlightBatch.Data.Num());
+
+		UE_LOG(LogActionRPG, Verbose, TEXT("URPGSaveSyncSubsystem: Uploaded %s revision %lld of slot %s, %d changes in %d bytes"),
+			InFlightBatch.bFull ? TEXT("full") : TEXT("delta"), InFlightBatch.Revision, *InFlightBatch.SlotName, InFlightBatch.NumChanges, InFlightBatch.Data.Num());
+
+		bBatchInFlight = false;
+		InFlightBatch = FRPGSaveSyncBatch();
+		break;
+
+	case ERPGSaveSyncResult::NeedsFullUpload:
+		// 完整的存档包含这一批的改变
+		// The full upload carries the changes of this batch too
+		UE_LOG(LogActionRPG, Log, TEXT("URPGSaveSyncSubsystem: Backend lost revision %lld of slot %s, uploading the whole save"), InFlightBatch.BaseRevision, *InFlightBatch.SlotName);
+		bBatchInFlight = false;
+		InFlightBatch = FRPGSaveSyncBatch();
+		bFullUploadPending = true;
+		bFlushRequested = true;
+		break;
+
+	case ERPGSaveSyncResult::Retry:
+	default:
+	{
+		// 指数退避，加上随机量避免多个客户端同时重试
+		// Exponential backoff, jittered so clients do not retry in lockstep
+		RetryDelay = RetryDelay > 0.0f ? FMath::Min(RetryDelay * 2.0f, MaxRetrySeconds) : FMath::Min(InitialRetrySeconds, MaxRetrySeconds);
+		const float Delay = RetryDelay * FMath::FRandRange(0.5f, 1.0f);
+		NextAttemptTime = FPlatformTime::Seconds() + Delay;
+		Stats.Retries++;
+
+		UE_LOG(LogActionRPG, Log, TEXT("URPGSaveSyncSubsystem: Upload of slot %s failed, retrying in %.1f seconds"), *InFlightBatch.SlotName, Delay);
+		break;
+	}
+	}
+}
+
+URPGGameInstanceBase* URPGSaveSyncSubsystem::GetRPGGameInstance() const
+{
+	return Cast<URPGGameInstanceBase>(GetGameInstance());
+}
@@ -0,0 +1,241 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "RPGStartupProfiler.h"
+#include "ProfilingDebugging/MiscTrace.h"
+#include "Misc/CoreDelegates.h"
+
+namespace RPGStartupProfiler
+{
+	struct FPhaseTiming
+	{
+		double StartTime = 0.0;
+		double EndTime = 0.0;
+		bool bStarted = false;
+		bool bEnded = false;
+	};
+
+	static FPhaseTiming Phases[int32(ERPGStartupPhase::Num)];
+
+	/** Set once the summary was logged, later phases are logged on their own */
+	static bool bSummaryLogged = false;
+
+	static FDelegateHandle EndFrameHandle;
+
+	static void LogLatePhase(ERPGStartupPhase Phase)
+	{
+		// 汇总之后才结束的阶段，比如在第一帧之后才完成的存档读取
+		// Phases that end after the summary, e.g. a save game read that outlasted the first frame
+		const FPhaseTiming& Timing = Phases[int32(Phase)];
+		UE_CLOG(bSummaryLogged, LogActionRPG, Display, TEXT("Startup: %s took %.1f ms, finished %.1f ms after process start"),
+			FRPGStartupProfiler::GetPhaseName(Phase), (Timing.EndTime - Timing.StartTime) * 1000.0, (Timing.EndTime - GStartTime) * 1000.0);
+	}
+
+	/** 子阶段的父阶段，汇总中显示在父阶段的括号里 */
+	/** Returns the phase a sub phase is part of, sub phases are listed inside their parent in the summary */
+	static ERPGStartupPhase GetParentPhase(ERPGStartupPhase Phase)
+	{
+		switch (Phase)
+		{
+		case ERPGStartupPhase::LoadingScreenModule:
+			return ERPGStartupPhase::ModuleLoad;
+		case ERPGStartupPhase::GlobalTags:
+		case ERPGStartupPhase::AttributeDefaults:
+		case ERPGStartupPhase::GameplayCueManager:
+			return ERPGStartupPhase::GlobalData;
+		default:
+			return ERPGStartupPhase::Num;
+		}
+	}
+
+	/** 相对进程启动的毫秒数 */
+	/** Returns a time in milliseconds since process start */
+	static double ToStartupMs(double Time)
+	{
+		return (Time - GStartTime) * 1000.0;
+	}
+
+	static void AppendPhase(FString& Summary, ERPGStartupPhase Phase)
+	{
+		const FPhaseTiming& Timing = Phases[int32(Phase)];
+		if (!Timing.bStarted)
+		{
+			return;
+		}
+
+		if (Timing.bEnded)
+		{
+			Summary += FString::Printf(TEXT("%s %.1f ms"), FRPGStartupProfiler::GetPhaseName(Phase), (Timing.EndTime - Timing.StartTime) * 1000.0);
+		}
+		else
+		{
+			Summary += FString::Printf(TEXT("%s pending"), FRPGStartupProfiler::GetPhaseName(Phase));
+		}
+	}
+
+	static void HandleEndFrame()
+	{
+		FCoreDelegates::OnEndFrame.Remove(EndFrameHandle);
+		EndFrameHandle.Reset();
+
+		FRPGStartupProfiler::EndPhase(ERPGStartupPhase::FirstPlayableFrame);
+		FRPGStartupProfiler::LogSummary();
+		bSummaryLogged = true;
+	}
+}
+
+void FRPGStartupProfiler::BeginPhase(ERPGStartupPhase Phase)
+{
+	check(IsInGameThread());
+
+	RPGStartupProfiler::FPhaseTiming& Timing = RPGStartupProfiler::Phases[int32(Phase)];
+	if (Timing.bStarted)
+	{
+		return;
+	}
+	Timing.bStarted = true;
+	Timing.StartTime = FPlatformTime::Seconds();
+
+	TRACE_BOOKMARK(TEXT("RPGStartup %s begin"), GetPhaseName(Phase));
+}
+
+void FRPGStartupProfiler::EndPhase(ERPGStartupPhase Phase)
+{
+	check(IsInGameThread());
+
+	RPGStartupProfiler::FPhaseTiming& Timing = RPGStartupProfiler::Phases[int32(Phase)];
+	if (!Timing.bStarted || Timing.bEnded)
+	{
+		return;
+	}
+	Timing.bEnded = true;
+	Timing.EndTime = FPlatformTime::Seconds();
+
+	TRACE_BOOKMARK(TEXT("RPGStartup %s end"), GetPhaseName(Phase));
+
+	RPGStartupProfiler::LogLatePhase(Phase);
+}
+
+void FRPGStartupProfiler::RecordPhase(ERPGStartupPhase Phase, double StartTime, double EndTime)
+{
+	check(IsInGameThread());
+
+	RPGStartupProfiler::FPhaseTiming& Timing = RPGStartupProfiler::Phases[int32(Phase)];
+	if (Timing.bStarted)
+	{
+		return;
+	}
+	Timing.bStarted = true;
+	Timing.bEnded = true;
+	Timing.StartTime = StartTime;
+	Timing.EndTime = EndTime;
+
+	RPGStartupProfiler::LogLatePhase(Phase);
+}
+
+double FRPGStartupProfiler::GetPhaseSeconds(ERPGStartupPhase Phase)
+{
+	const RPGStartupProfiler::FPhaseTiming& Timing = RPGStartupProfiler::Phases[int32(Phase)];
+	return Timing.bEnded ? Timing.EndTime - Timing.StartTime : -1.0;
+}
+
+void FRPGStartupProfiler::NotifyStartPlay()
+{
+	// 编辑器中的 PIE 不是冷启动
+	// Play in editor is not a cold start
+	if (GIsEditor || RPGStartupProfiler::Phases[int32(ERPGStartupPhase::FirstPlayableFrame)].bStarted)
+	{
+		return;
+	}
+
+	BeginPhase(ERPGStartupPhase::FirstPlayableFrame);
+	RPGStartupProfiler::EndFrameHandle = FCoreDelegates::OnEndFrame.AddStatic(&RPGStartupProfiler::HandleEndFrame);
+}
+
+void FRPGStartupProfiler::LogSummary()
+{
+	using namespace RPGStartupProfiler;
+
+	// 每个阶段的开始时间和时长，用于对照 trace
+	// Start offset and duration of every phase, to line up with a trace
+	for (int32 Index = 0; Index < int32(ERPGStartupPhase::Num); Index++)
+	{
+		const FPhaseTiming& Timing = Phases[Index];
+		if (Timing.bStarted)
+		{
+			UE_LOG(LogActionRPG, Log, TEXT("Startup:   %-20s started at %9.1f ms, %s"), GetPhaseName(ERPGStartupPhase(Index)), ToStartupMs(Timing.StartTime),
+				Timing.bEnded ? *FString::Printf(TEXT("took %.1f ms"), (Timing.EndTime - Timing.StartTime) * 1000.0) : TEXT("pending"));
+		}
+	}
+
+	// 一行汇总，方便在服务器日志中查找
+	// One summary line so server logs can be grepped and budgeted
+	FString Summary;
+	for (int32 Index = 0; Index < int32(ERPGStartupPhase::Num); Index++)
+	{
+		const ERPGStartupPhase Phase = ERPGStartupPhase(Index);
+		if (!Phases[Index].bStarted || GetParentPhase(Phase) != ERPGStartupPhase::Num)
+		{
+			continue;
+		}
+
+		if (!Summary.IsEmpty())
+		{
+			Summary += TEXT(", ");
+		}
+		AppendPhase(Summary, Phase);
+
+		FString SubPhases;
+		for (int32 SubIndex = 0; SubIndex < int32(ERPGStartupPhase::Num); SubIndex++)
+		{
+			if (Phases[SubIndex].bStarted && GetParentPhase(ERPGStartupPhase(SubIndex)) == Phase)
+			{
+				if (!SubPhases.IsEmpty())
+				{
+					SubPhases += TEXT(", ");
+				}
+				AppendPhase(SubPhases, ERPGStartupPhase(SubIndex));
+			}
+		}
+		if (!SubPhases.IsEmpty())
+		{
+			Summary += FString::Printf(TEXT(" [%s]"), *SubPhases);
+		}
+	}
+
+	const FPhaseTiming& FirstFrame = Phases[int32(ERPGStartupPhase::FirstPlayableFrame)];
+	if (FirstFrame.bEnded)
+	{
+		UE_LOG(LogActionRPG, Display, TEXT("Startup: First playable frame %.1f ms after process start (%s)"), ToStartupMs(FirstFrame.EndTime), *Summary);
+	}
+	else
+	{
+		UE_LOG(LogActionRPG, Display, TEXT("Startup: %.1f ms since process start (%s)"), ToStartupMs(FPlatformTime::Seconds()), *Summary);
+	}
+}
+
+const TCHAR* FRPGStartupProfiler::GetPhaseName(ERPGStartupPhase Phase)
+{
+	switch (Phase)
+	{
+	case ERPGStartupPhase::ModuleLoad:
+		return TEXT("ModuleLoad");
+	case ERPGStartupPhase::LoadingScreenModule:
+		return TEXT("LoadingScreenModule");
+	case ERPGStartupPhase::AssetManagerScan:
+		return TEXT("AssetManagerScan");
+	case ERPGStartupPhase::GlobalData:
+		return TEXT("GlobalData");
+	case ERPGStartupPhase::GlobalTags:
+		return TEXT("GlobalTags");
+	case ERPGStartupPhase::AttributeDefaults:
+		return TEXT("AttributeDefaults");
+	case ERPGStartupPhase::GameplayCueManager:
+		return TEXT("GameplayCueManager");
+	case ERPGStartupPhase::SaveLoad:
+		return TEXT("SaveLoad");
+	case ERPGStartupPhase::FirstPlayableFrame:
+		return TEXT("FirstPlayableFrame");
+	default:
+		return TEXT("Unknown");
+	}
+}
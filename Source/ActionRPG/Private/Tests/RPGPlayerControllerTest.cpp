@@ -0,0 +1,247 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "RPGPlayerControllerBase.h"
+#include "RPGAssetManager.h"
+#include "RPGGameInstanceBase.h"
+#include "RPGSaveGame.h"
+#include "Items/RPGPotionItem.h"
+#include "Items/RPGWeaponItem.h"
+#include "Misc/AutomationTest.h"
+#include "Math/RandomStream.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+/** 测试需要访问的 ARPGPlayerControllerBase 内部状态 */
+/** Internal state of ARPGPlayerControllerBase the tests drive and check */
+struct FRPGPlayerControllerTestAccess
+{
+	/**
+	 * 进入 LoadInventory 开始异步加载之后的状态。道具都在内存中时 LoadItemsAsync 会同步完成，所以这里直接设置，
+	 * 调用者负责先用空的存档加载背包。
+	 */
+	/**
+	 * Puts the controller into the state LoadInventory leaves behind once an async load started, returns the load serial
+	 * LoadItemsAsync completes synchronously for items already in memory, so the state is entered directly. The caller loads an empty save first
+	 */
+	static int32 BeginPendingLoad(ARPGPlayerControllerBase& Controller)
+	{
+		Controller.MarkInventoryFullyDirty();
+		Controller.bInventoryLoading = true;
+		return ++Controller.InventoryLoadSerial;
+	}
+
+	/** 完成 BeginPendingLoad 开始的加载 */
+	/** Delivers the items of the load started by BeginPendingLoad */
+	static void CompletePendingLoad(ARPGPlayerControllerBase& Controller, const TArray<URPGItem*>& LoadedItems, int32 LoadSerial, URPGSaveGame* SaveGame)
+	{
+		Controller.HandleInventoryItemsLoaded(LoadedItems, LoadSerial, SaveGame);
+	}
+
+	static bool ValidateInventoryIndices(const ARPGPlayerControllerBase& Controller)
+	{
+		return Controller.ValidateInventoryIndices();
+	}
+};
+
+namespace RPGPlayerControllerTest
+{
+	/** 和 URPGInventoryBenchmarkCommandlet 相同，在独立的 GameInstance 和世界中创建控制器，不写入硬盘 */
+	/** Standalone game instance and world with one controller, set up like URPGInventoryBenchmarkCommandlet. Saving to disk is disabled */
+	struct FControllerFixture
+	{
+		explicit FControllerFixture(const TMap<FPrimaryAssetType, int32>& SlotsPerType)
+		{
+			GameInstance = NewObject<URPGGameInstanceBase>(GEngine);
+			GameInstance->AddToRoot();
+			GameInstance->InitializeStandalone();
+			GameInstance->SetSavingEnabled(false);
+			GameInstance->ItemSlotsPerType = SlotsPerType;
+
+			Controller = GameInstance->GetWorld()->SpawnActor<ARPGPlayerControllerBase>();
+			check(Controller);
+
+			GameInstance->ResetSaveGame();
+			Controller->LoadInventory();
+		}
+
+		~FControllerFixture()
+		{
+			Controller->Destroy();
+			GameInstance->Shutdown();
+			GameInstance->RemoveFromRoot();
+		}
+
+		UE_NONCOPYABLE(FControllerFixture);
+
+		URPGGameInstanceBase* GameInstance = nullptr;
+		ARPGPlayerControllerBase* Controller = nullptr;
+	};
+
+	/** 创建一个道具并注册为动态资产，这样控制器可以通过 AssetManager 找到它 */
+	/** Creates an item registered as a dynamic asset so the controller resolves it through the asset manager. The item is rooted */
+	template <typename ItemClass>
+	static URPGItem* CreateItem(const TCHAR* BaseName, int32 Price, const FText& ItemName)
+	{
+		const FName Name = MakeUniqueObjectName(GetTransientPackage(), ItemClass::StaticClass(), FName(BaseName));
+		URPGItem* Item = NewObject<ItemClass>(GetTransientPackage(), Name, RF_Transient);
+		Item->Price = Price;
+		Item->ItemName = ItemName;
+		Item->AddToRoot();
+
+		URPGAssetManager::Get().AddDynamicAsset(Item->GetPrimaryAssetId(), FSoftObjectPath(Item), FAssetBundleData());
+		return Item;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRPGInventoryChangesDuringLoadTest, "ActionRPG.Inventory.ChangesDuringAsyncLoad",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FRPGInventoryChangesDuringLoadTest::RunTest(const FString& Parameters)
+{
+	using namespace RPGPlayerControllerTest;
+
+	URPGItem* SavedPotion = CreateItem<URPGPotionItem>(TEXT("TestSavedPotion"), 10, FText::FromString(TEXT("Saved")));
+	URPGItem* NewWeapon = CreateItem<URPGWeaponItem>(TEXT("TestNewWeapon"), 20, FText::FromString(TEXT("New")));
+
+	{
+		TMap<FPrimaryAssetType, int32> SlotsPerType;
+		SlotsPerType.Add(URPGAssetManager::PotionItemType, 1);
+		SlotsPerType.Add(URPGAssetManager::WeaponItemType, 1);
+		FControllerFixture Fixture(SlotsPerType);
+		ARPGPlayerControllerBase& Controller = *Fixture.Controller;
+
+		// 存档中有 3 个药水，背包正在异步加载
+		// The save holds three potions while the inventory is still loading them
+		URPGSaveGame* SaveGame = Fixture.GameInstance->GetCurrentSaveGame();
+		SaveGame->InventoryData.Add(SavedPotion->GetPrimaryAssetId(), FRPGItemData(3, 1));
+		SaveGame->SlottedItems.Add(FRPGItemSlot(URPGAssetManager::PotionItemType, 0), SavedPotion->GetPrimaryAssetId());
+		const int32 LoadSerial = FRPGPlayerControllerTestAccess::BeginPendingLoad(Controller);
+
+		// 加载期间拾取、使用和装备
+		// Pick up, consume and equip while the load is in flight
+		TestTrue(TEXT("Add during load is accepted"), Controller.AddInventoryItem(NewWeapon, 1, 1, true));
+		TestTrue(TEXT("Remove during load is accepted"), Controller.RemoveInventoryItem(SavedPotion, 1));
+		TestTrue(TEXT("Slot change during load is accepted"), Controller.SetSlottedItem(FRPGItemSlot(URPGAssetManager::WeaponItemType, 0), nullptr));
+		TestFalse(TEXT("Save during load is refused"), Controller.SaveInventory());
+
+		TestEqual(TEXT("Saved potions survive the changes made during the load"), SaveGame->InventoryData.FindRef(SavedPotion->GetPrimaryAssetId()).ItemCount, 3);
+		TestFalse(TEXT("Queued weapon is not saved before the load completes"), SaveGame->InventoryData.Contains(NewWeapon->GetPrimaryAssetId()));
+		TestEqual(TEXT("Nothing is applied before the load completes"), Controller.GetInventoryItemNum(), 0);
+
+		FRPGPlayerControllerTestAccess::CompletePendingLoad(Controller, { SavedPotion }, LoadSerial, SaveGame);
+
+		// 修改应用在加载的背包上，并且写入了存档
+		// The changes were applied on top of the loaded inventory and saved
+		TestFalse(TEXT("Load finished"), Controller.IsInventoryLoading());
+		TestEqual(TEXT("Potion count after the queued removal"), Controller.GetInventoryItemCount(SavedPotion), 2);
+		TestEqual(TEXT("Weapon count after the queued add"), Controller.GetInventoryItemCount(NewWeapon), 1);
+		TestTrue(TEXT("Saved slot was loaded"), Controller.GetSlottedItem(FRPGItemSlot(URPGAssetManager::PotionItemType, 0)) == SavedPotion);
+		TestNull(TEXT("Queued slot change applied after the auto slot"), Controller.GetSlottedItem(FRPGItemSlot(URPGAssetManager::WeaponItemType, 0)));
+		TestTrue(TEXT("Indices consistent"), FRPGPlayerControllerTestAccess::ValidateInventoryIndices(Controller));
+
+		TestEqual(TEXT("Saved potion count"), SaveGame->InventoryData.FindRef(SavedPotion->GetPrimaryAssetId()).ItemCount, 2);
+		TestEqual(TEXT("Saved weapon count"), SaveGame->InventoryData.FindRef(NewWeapon->GetPrimaryAssetId()).ItemCount, 1);
+	}
+
+	SavedPotion->RemoveFromRoot();
+	NewWeapon->RemoveFromRoot();
+	return !HasAnyErrors();
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRPGInventoryIndicesRandomTest, "ActionRPG.Inventory.IndicesStayConsistent",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FRPGInventoryIndicesRandomTest::RunTest(const FString& Parameters)
+{
+	using namespace RPGPlayerControllerTest;
+
+	static constexpr int32 NumItemsPerType = 8;
+	static constexpr int32 NumSteps = 2000;
+
+	// 固定的种子，失败时可以重现
+	// Fixed seed so a failure reproduces
+	FRandomStream Random(0x52504749);
+
+	TArray<URPGItem*> Items;
+	for (int32 Index = 0; Index < NumItemsPerType; Index++)
+	{
+		Items.Add(CreateItem<URPGPotionItem>(TEXT("TestRandomPotion"), Random.RandRange(0, 4), FText::AsNumber(Random.RandRange(0, 4))));
+		Items.Add(CreateItem<URPGWeaponItem>(TEXT("TestRandomWeapon"), Random.RandRange(0, 4), FText::AsNumber(Random.RandRange(0, 4))));
+	}
+
+	{
+		TMap<FPrimaryAssetType, int32> SlotsPerType;
+		SlotsPerType.Add(URPGAssetManager::PotionItemType, 2);
+		SlotsPerType.Add(URPGAssetManager::WeaponItemType, 3);
+		FControllerFixture Fixture(SlotsPerType);
+		ARPGPlayerControllerBase& Controller = *Fixture.Controller;
+
+		TArray<FRPGItemSlot> AllSlots;
+		Controller.SlottedItems.GetKeys(AllSlots);
+
+		for (int32 Step = 0; Step < NumSteps; Step++)
+		{
+			URPGItem* Item = Items[Random.RandHelper(Items.Num())];
+			const int32 Operation = Random.RandHelper(3);
+
+			if (Operation == 0)
+			{
+				Controller.AddInventoryItem(Item, Random.RandRange(1, 5), 1, Random.RandBool());
+			}
+			else if (Operation == 1)
+			{
+				// 0 代表移除全部
+				// A count of 0 removes the whole stack
+				Controller.RemoveInventoryItem(Item, Random.RandRange(0, 3));
+			}
+			else
+			{
+				// 插槽中只放背包中的道具，也可以清空插槽
+				// Only items in the inventory are slotted, a slot may also be cleared
+				const FRPGItemSlot& ItemSlot = AllSlots[Random.RandHelper(AllSlots.Num())];
+				URPGItem* SlotItem = (Controller.GetInventoryItemCount(Item) > 0 && Item->ItemType == ItemSlot.ItemType) ? Item : nullptr;
+				Controller.SetSlottedItem(ItemSlot, SlotItem);
+			}
+
+			if (!FRPGPlayerControllerTestAccess::ValidateInventoryIndices(Controller))
+			{
+				AddError(FString::Printf(TEXT("Inventory indices out of sync after step %d"), Step));
+				break;
+			}
+
+			TArray<URPGItem*> ByPrice;
+			Controller.GetSortedInventoryItems(ByPrice, Item->ItemType, ERPGInventorySortOrder::Price);
+			bool bOrderValid = true;
+			for (int32 Index = 0; bOrderValid && Index < ByPrice.Num(); Index++)
+			{
+				bOrderValid = Controller.GetInventoryItemCount(ByPrice[Index]) > 0 && (Index == 0 || ByPrice[Index - 1]->Price <= ByPrice[Index]->Price);
+			}
+			if (!bOrderValid)
+			{
+				AddError(FString::Printf(TEXT("Price order of %s is wrong after step %d"), *Item->ItemType.ToString(), Step));
+				break;
+			}
+
+			for (const TPair<FRPGItemSlot, URPGItem*>& Pair : Controller.SlottedItems)
+			{
+				if (Pair.Value && Controller.GetInventoryItemCount(Pair.Value) == 0)
+				{
+					AddError(FString::Printf(TEXT("Slot %s holds an item that left the inventory after step %d"), *Pair.Key.ItemType.ToString(), Step));
+					break;
+				}
+			}
+			if (HasAnyErrors())
+			{
+				break;
+			}
+		}
+	}
+
+	for (URPGItem* Item : Items)
+	{
+		Item->RemoveFromRoot();
+	}
+	return !HasAnyErrors();
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
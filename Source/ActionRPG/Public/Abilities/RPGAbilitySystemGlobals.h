@@ -0,0 +1,30 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "ActionRPG.h"
+#include "AbilitySystemGlobals.h"
+#include "RPGAbilitySystemGlobals.generated.h"
+
+/**
+ * 这个游戏的 AbilitySystemGlobals ，在 DefaultGame.ini 的 AbilitySystemGlobalsClassName 中指定。
+ * 计时 InitGlobalData 的各个部分，用于启动时间的统计。
+ */
+/**
+ * Game-specific ability system globals, installed through AbilitySystemGlobalsClassName in DefaultGame.ini
+ * Times the parts of InitGlobalData for FRPGStartupProfiler
+ */
+UCLASS()
+class ACTIONRPG_API URPGAbilitySystemGlobals : public UAbilitySystemGlobals
+{
+	GENERATED_BODY()
+
+public:
+	// UAbilitySystemGlobals interface
+	virtual void InitGlobalData() override;
+	virtual void InitGlobalTags() override;
+	virtual UGameplayCueManager* GetGameplayCueManager() override;
+
+protected:
+	virtual void InitAttributeDefaults() override;
+};
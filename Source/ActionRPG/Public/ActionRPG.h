@@ -21,5 +21,10 @@
 
 ACTIONRPG_API DECLARE_LOG_CATEGORY_EXTERN(LogActionRPG, Log, All);
 
+/** 背包和存档相关的性能统计，使用 stat RPGInventory 查看 */
+/** Stats for inventory and save game bookkeeping, view with "stat RPGInventory" */
+DECLARE_STATS_GROUP(TEXT("RPGInventory"), STATGROUP_RPGInventory, STATCAT_Advanced);
+DECLARE_STATS_GROUP(TEXT("RPGSave"), STATGROUP_RPGSave, STATCAT_Advanced);
+
 // DECLARE_STATS_GROUP(TEXT("ARPGCharacterBase"), STATGROUP_ARPGCharacterBase, STATCAT_Custom);
 // DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("ARPGCharacterBase::HandleHealthChanged"), STAT_HandleHealthChanged, STATGROUP_ARPGCharacterBase, ACTIONRPG_API);
\ No newline at end of file
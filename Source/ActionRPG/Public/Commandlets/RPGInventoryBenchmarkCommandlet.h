@@ -0,0 +1,69 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "ActionRPG.h"
+#include "Commandlets/Commandlet.h"
+#include "RPGInventoryBenchmarkCommandlet.generated.h"
+
+class URPGItem;
+class URPGGameInstanceBase;
+class ARPGPlayerControllerBase;
+
+/** 用 UPROPERTY 的 TMap 保存背包，作为紧凑存储的内存和 GC 遍历开销的对比 */
+/** Holds the inventory as the former UPROPERTY map, the baseline for the memory and GC trace comparison */
+UCLASS(Transient)
+class URPGInventoryBenchmarkMapHolder : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY()
+	TMap<URPGItem*, FRPGItemData> InventoryData;
+};
+
+/**
+ * 背包的性能测试，在无界面的世界中创建 ARPGPlayerControllerBase 和合成的 URPGItem ，
+ * 在不同的背包规模下测量各个操作的 ns/op 和每次操作的内存分配次数，结果以 JSON 输出。
+ */
+/**
+ * Inventory micro-benchmark. Builds an ARPGPlayerControllerBase in a headless world with synthetic URPGItem assets and measures
+ * Add/Remove/SetSlotted/GetInventoryItems/SaveInventory/LoadInventory at several inventory sizes, reporting ns/op and allocations/op as JSON
+ * Also reports memory and GC reference tracing time of the inventory storage against a UPROPERTY TMap of the same items
+ *
+ * Usage: UnrealEditor-Cmd ActionRPG.uproject -run=RPGInventoryBenchmark -nullrhi -unattended [-Scales=10,1000,50000] [-Ops=2000] [-Seed=1] [-Output=Path.json]
+ */
+UCLASS()
+class URPGInventoryBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	URPGInventoryBenchmarkCommandlet();
+
+	// UCommandlet interface
+	virtual int32 Main(const FString& Params) override;
+
+protected:
+	/** 创建合成的道具，并注册为动态资产，这样 LoadInventory 可以通过 AssetManager 找到它们 */
+	/** Creates synthetic items and registers them as dynamic assets so LoadInventory can resolve them through the asset manager */
+	void CreateSyntheticItems(int32 NumItems);
+
+	/** 运行一个规模的全部测试，结果写入 OutResults */
+	/** Runs every benchmark at one inventory size and appends the results */
+	void RunScale(int32 Scale, int32 NumOps, int32 Seed, TArray<TSharedPtr<class FJsonValue>>& OutResults);
+
+	/** 比较紧凑存储和 TMap 的内存占用和 GC 遍历时间 */
+	/** Compares memory and GC reference tracing time of the compact store against the equivalent UPROPERTY map */
+	void MeasureStorage(int32 Scale, TArray<TSharedPtr<class FJsonValue>>& OutResults);
+
+	/** Synthetic items, kept referenced for the lifetime of the run */
+	UPROPERTY(Transient)
+	TArray<URPGItem*> SyntheticItems;
+
+	UPROPERTY(Transient)
+	URPGGameInstanceBase* GameInstance;
+
+	UPROPERTY(Transient)
+	ARPGPlayerControllerBase* Controller;
+};
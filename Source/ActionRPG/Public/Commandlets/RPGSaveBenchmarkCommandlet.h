@@ -0,0 +1,54 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "ActionRPG.h"
+#include "Commandlets/Commandlet.h"
+#include "RPGSaveBenchmarkCommandlet.generated.h"
+
+class URPGSaveGame;
+
+/**
+ * 存档的性能测试，用合成的存档测量序列化、反序列化、旧版本的升级和硬盘读写，
+ * 并比较 USaveGame 格式和快照格式在各种压缩方式下的大小和读写速度，结果以 JSON 输出。
+ */
+/**
+ * Save benchmark. Builds synthetic save games and measures serialize, deserialize, the URPGSaveGame::Serialize fix-up of
+ * ERPGSaveGameVersion::Initial and AddedInventory data and a disk round trip, reporting ms per save, MB/s and bytes as JSON
+ * Also compares size and encode/decode throughput of the tagged property and snapshot payloads under every ERPGSaveCompression
+ * Rerun it after changes to RPGSaveGame.h to track save format performance
+ *
+ * Usage: UnrealEditor-Cmd ActionRPG.uproject -run=RPGSaveBenchmark -nullrhi -unattended [-Items=10000] [-SlotsPerType=3] [-Iterations=20] [-Output=Path.json]
+ */
+UCLASS()
+class URPGSaveBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	URPGSaveBenchmarkCommandlet();
+
+	// UCommandlet interface
+	virtual int32 Main(const FString& Params) override;
+
+protected:
+	/** 创建包含 NumItems 个道具的存档，道具不需要存在 */
+	/** Creates a save game holding NumItems entries and SlotsPerType slots of every item type, the items do not have to exist */
+	URPGSaveGame* CreateSyntheticSaveGame(int32 NumItems, int32 SlotsPerType) const;
+
+	/** 创建旧版本的存档，道具保存在 InventoryItems_DEPRECATED 中 */
+	/** Creates a save game of an old version, holding its items in InventoryItems_DEPRECATED */
+	URPGSaveGame* CreateLegacySaveGame(int32 NumItems, int32 Version) const;
+
+	/** 测量序列化、反序列化和硬盘读写 */
+	/** Measures serialize, deserialize and the disk round trip of the current format */
+	void MeasureSaveGame(URPGSaveGame* SaveGame, int32 NumIterations, TArray<TSharedPtr<class FJsonValue>>& OutResults);
+
+	/** 测量从旧版本读取并升级的开销，以及写回之后再次加载的开销 */
+	/** Measures loading and migrating a save of an old version, the migration steps alone, and reloading it once the upgraded form was written */
+	void MeasureVersionFixUp(int32 NumItems, int32 Version, int32 NumIterations, TArray<TSharedPtr<class FJsonValue>>& OutResults);
+
+	/** 测量一种格式和压缩方式的组合 */
+	/** Measures one payload and compression combination */
+	void MeasureFormat(URPGSaveGame* SaveGame, bool bSnapshot, ERPGSaveCompression Compression, int32 NumIterations, TArray<TSharedPtr<class FJsonValue>>& OutResults);
+};
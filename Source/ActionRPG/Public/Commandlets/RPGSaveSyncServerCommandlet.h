@@ -0,0 +1,43 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "ActionRPG.h"
+#include "Commandlets/Commandlet.h"
+#include "RPGSaveSyncServerCommandlet.generated.h"
+
+/**
+ * 本地的存档同步服务器，代替真正的远程服务测试 FRPGHttpSaveSyncBackend 。
+ * 记录每个用户和 slot 的版本，增量的基础版本不一致时返回 409 ，可以按比例随机返回 503 来测试重试。
+ */
+/**
+ * Loopback stand-in for the remote save sync service, used to test FRPGHttpSaveSyncBackend and URPGSaveSyncSubsystem locally
+ * Accepts POST /saves/<UserId>/<SlotName>, tracks the revision of every user and slot and answers 409 to a delta whose base revision it does not hold
+ * Every accepted batch is validated and stored under Saved/SaveSync/<UserId>/<SlotName>/. -FailRate answers that fraction of requests with 503 to exercise the retry backoff
+ *
+ * Usage: UnrealEditor-Cmd ActionRPG.uproject -run=RPGSaveSyncServer -unattended [-Port=8787] [-Duration=Seconds] [-FailRate=0.0]
+ * Then start the game with -SaveSyncUrl=http://127.0.0.1:8787
+ */
+UCLASS()
+class URPGSaveSyncServerCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	URPGSaveSyncServerCommandlet();
+
+	// UCommandlet interface
+	virtual int32 Main(const FString& Params) override;
+
+protected:
+	/** 每个 "用户/slot" 的当前版本 */
+	/** Current revision of every "User/Slot" */
+	TMap<FString, int64> Revisions;
+
+	/** Fraction of requests answered with 503 */
+	float FailRate = 0.0f;
+
+	int32 NumAccepted = 0;
+	int32 NumRejected = 0;
+	int64 NumBytesReceived = 0;
+};
@@ -46,14 +46,14 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Item)
 	FSlateBrush ItemIcon;
 
-	/** 游戏中的价格 */
-	/** Price in game */
-	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Item)
+	/** 游戏中的价格，写入资产注册表，URPGAssetManager 的道具目录不需要加载道具就可以读取 */
+	/** Price in game. Registry searchable, so the URPGAssetManager item catalog reads it without loading the item */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Item, AssetRegistrySearchable)
 	int32 Price;
 
 	/** 可以在背包中保存的最大数量，0 代表无限 */
 	/** Maximum number of instances that can be in inventory at once, <= 0 means infinite */
-	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Max)
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Max, AssetRegistrySearchable)
 	int32 MaxCount;
 
 	/** 返回道具是否是可消耗的，即 MaxCount <= 0 */
@@ -63,7 +63,7 @@ public:
 
 	/** 道具的最大等级，0 代表无限 */
 	/** Maximum level this item can be, <= 0 means infinite */
-	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Max)
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Max, AssetRegistrySearchable)
 	int32 MaxLevel;
 
 	/** 当这个物品被装备后赋予给角色的 Ability */
@@ -96,7 +96,7 @@ public:
 	TSoftObjectPtr<USoundBase> PickupSound;
 
 	// ASSET MANAGER EXAMPLE: Item that is linked to this one somehow
-	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Item)
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Item, AssetRegistrySearchable)
 	FPrimaryAssetId LinkedItem;
  
 	// ASSET MANAGER EXAMPLE: Item that is linked to this one somehow
@@ -104,4 +104,11 @@ public:
 	// the Asset Registry for any Asset class instances containing this as a member variable. It is not legal to use on struct properties or parameters.
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Item, AssetRegistrySearchable)
 	FName ExampleRegistryTag;
+
+private:
+	friend class FRPGItemCatalog;
+
+	/** 在 FRPGItemCatalog 中的下标，查找时不需要哈希指针 */
+	/** Index in FRPGItemCatalog, cached here so lookups do not hash the pointer */
+	int32 CatalogIndex = INDEX_NONE;
 };
@@ -4,10 +4,93 @@
 
 #include "ActionRPG.h"
 #include "Engine/AssetManager.h"
+#include "Engine/StreamableManager.h"
+#include "UObject/ObjectKey.h"
 #include "RPGAssetManager.generated.h"
 
+class AGameModeBase;
 class URPGItem;
 
+/** 批量加载完成的回调，参数是按请求顺序排列的加载成功的道具 */
+/** Called when a LoadItemsAsync batch completed, with the items that loaded in request order */
+DECLARE_DELEGATE_OneParam(FRPGItemsLoadedDelegate, const TArray<URPGItem*>& /*LoadedItems*/);
+
+/** 批量异步加载道具的统计数据 */
+/** Counters of LoadItemsAsync */
+USTRUCT(BlueprintType)
+struct ACTIONRPG_API FRPGItemLoadStats
+{
+    GENERATED_BODY()
+
+    UPROPERTY(BlueprintReadOnly, Category = Item)
+    int32 BatchesRequested = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = Item)
+    int32 ItemsRequested = 0;
+
+    /** 已经在另一批中加载，没有发出新请求的道具数 */
+    /** Items that were already loading in another batch and shared its request instead of issuing a new one */
+    UPROPERTY(BlueprintReadOnly, Category = Item)
+    int32 ItemsShared = 0;
+
+    /** Batches that completed, including the ones that had nothing to stream */
+    UPROPERTY(BlueprintReadOnly, Category = Item)
+    int32 BatchesCompleted = 0;
+
+    /** 从请求到回调的时间 */
+    /** Time from the request to the completion delegate of the last batch */
+    UPROPERTY(BlueprintReadOnly, Category = Item)
+    float LastLatencyMs = 0.0f;
+
+    /** Largest latency of any batch */
+    UPROPERTY(BlueprintReadOnly, Category = Item)
+    float MaxLatencyMs = 0.0f;
+};
+
+/**
+ * 道具目录中的一个条目，从资产注册表的标签中读取，不需要加载道具。
+ */
+/**
+ * Item metadata read from asset registry tags, available without loading the URPGItem
+ * Mirrors the AssetRegistrySearchable properties of URPGItem
+ */
+USTRUCT(BlueprintType)
+struct ACTIONRPG_API FRPGItemInfo
+{
+    GENERATED_BODY()
+
+    UPROPERTY(BlueprintReadOnly, Category = Item)
+    FPrimaryAssetId ItemId;
+
+    UPROPERTY(BlueprintReadOnly, Category = Item)
+    int32 Price = 0;
+
+    /** <= 0 means infinite */
+    UPROPERTY(BlueprintReadOnly, Category = Item)
+    int32 MaxCount = 1;
+
+    /** <= 0 means infinite */
+    UPROPERTY(BlueprintReadOnly, Category = Item)
+    int32 MaxLevel = 1;
+
+    UPROPERTY(BlueprintReadOnly, Category = Item)
+    FPrimaryAssetId LinkedItem;
+
+    UPROPERTY(BlueprintReadOnly, Category = Item)
+    FName ExampleRegistryTag;
+
+    /** 为 false 时资产在添加标签之前保存，值是道具类的默认值 */
+    /** False if the asset was saved before its properties were tagged, the values are then the defaults of its item class */
+    UPROPERTY(BlueprintReadOnly, Category = Item)
+    bool bFromRegistryTags = false;
+
+    /** Returns the type of the item */
+    FPrimaryAssetType GetItemType() const
+    {
+        return ItemId.PrimaryAssetType;
+    }
+};
+
 /**
  * AssetManager 的子类。
  * 资源管理器最初设计用于管理在各种不同情况下和整个游戏中可用的资源，通常应用于所有物品栏项目。
@@ -34,7 +117,7 @@ class URPGItem;
  * It is expected that most games will want to override AssetManager as it provides a good place for game-specific loading logic
  * This is used by setting AssetManagerClassName in DefaultEngine.ini
  */
-UCLASS()
+UCLASS(Config = Game)
 class ACTIONRPG_API URPGAssetManager : public UAssetManager
 {
     GENERATED_BODY()
@@ -56,6 +139,11 @@ public:
     static const FPrimaryAssetType TokenItemType; // 代币
     static const FPrimaryAssetType WeaponItemType; // 武器
 
+    /** URPGItem 中软引用使用的 Bundle 名称 */
+    /** Asset bundle names used by the soft references on URPGItem */
+    static const FName MenuBundle;
+    static const FName GameBundle;
+
     /** 返回当前的 AssetManager 的单例，这个函数在 AssetManager 类中也有，但不是 virtual 的，实现基本上参照了 AssetManager 中的实现 */
     /** Returns the current AssetManager object */
     static URPGAssetManager& Get();
@@ -66,15 +154,220 @@ public:
      */
     /**
      * Synchronously loads an RPGItem subclass, this can hitch but is useful when you cannot wait for an async load
-     * This does not maintain a reference to the item so it will garbage collect if not loaded some other way
+     * The item is loaded through the asset manager, it stays loaded until it is evicted by the residency budget or unloaded
      *
      * @param PrimaryAssetId The asset identifier to load
      * @param bLogWarning If true, this will log a warning if the item failed to load
      */
-    URPGItem* ForceLoadItem(const FPrimaryAssetId& PrimaryAssetId, bool bLogWarning = true) const;
+    URPGItem* ForceLoadItem(const FPrimaryAssetId& PrimaryAssetId, bool bLogWarning = true);
+
+    /**
+     * 道具目录：所有道具的价格、最大数量、类型等元数据，从资产注册表的标签中读取，不需要加载道具。
+     * 初始扫描完成后构建一次，按类型和名称排序，同一类型的道具是连续的。
+     */
+    /**
+     * Item catalog: price, max count, type and linked item of every item, read from asset registry tags so no item is loaded
+     * Built once when the initial asset scan completed, sorted by type and then name so the items of a type are contiguous
+     * Shop and loot code can filter it without touching disk, loading only the items they end up using
+     */
+    const TArray<FRPGItemInfo>& GetItemInfos() const
+    {
+        return ItemInfos;
+    }
+
+    /** 二分查找一个道具的元数据，没有时返回 nullptr */
+    /** Binary searches the catalog, returns nullptr for unknown items */
+    const FRPGItemInfo* FindItemInfo(const FPrimaryAssetId& ItemId) const;
+
+    /** 返回一个类型的所有道具 */
+    /** Returns the contiguous catalog range of one item type */
+    TArrayView<const FRPGItemInfo> GetItemInfosOfType(const FPrimaryAssetType& ItemType) const;
+
+    /**
+     * 批量异步加载道具，返回一个句柄，全部完成后在游戏线程上调用 OnLoaded 。
+     * 正在被其他批次加载的道具不会发出新的请求，而是等待那一批完成。所有道具都已经加载时立即调用 OnLoaded 并返回 nullptr 。
+     * 道具由资产管理器保持加载，直到 UnloadPrimaryAsset 。
+     */
+    /**
+     * Streams a batch of items with one request and calls OnLoaded on the game thread once all of them are in memory
+     * Items another batch is already loading are not requested again, this batch waits for that request instead
+     * If nothing has to be streamed, OnLoaded runs before this returns and the returned handle is null. Keep the handle until OnLoaded ran
+     * Like LoadPrimaryAssets, the items stay loaded until they are unloaded through the asset manager
+     *
+     * @param ItemIds Items to load, duplicates are ignored
+     * @param LoadBundles Bundles of the items to load along with them
+     * @param OnLoaded Receives the items that loaded, in request order
+     */
+    TSharedPtr<FStreamableHandle> LoadItemsAsync(const TArray<FPrimaryAssetId>& ItemIds, const TArray<FName>& LoadBundles, FRPGItemsLoadedDelegate OnLoaded);
+
+    /** Returns the LoadItemsAsync counters */
+    const FRPGItemLoadStats& GetItemLoadStats() const
+    {
+        return ItemLoadStats;
+    }
+
+    /**
+     * 切换游戏阶段，用 ChangeBundleStateForPrimaryAssets 改变所有已加载道具的 Bundle ：
+     * 主菜单只保留 Menu ，战斗中只保留 Game ，打开背包时两者都保留。之后加载的道具使用新阶段的 Bundle 。
+     */
+    /**
+     * Switches the game phase and changes the bundle state of every loaded item with ChangeBundleStateForPrimaryAssets, so menu textures
+     * are released during combat and pickup sounds in the main menu. Released bundle assets leave memory with the next garbage collection
+     * Items loaded later, for instance by the async inventory load, should request GetPhaseBundles()
+     */
+    void SetGamePhase(ERPGGamePhase NewPhase);
+
+    ERPGGamePhase GetGamePhase() const
+    {
+        return GamePhase;
+    }
+
+    /** 返回当前阶段的 Bundle */
+    /** Returns the bundles resident in the current phase */
+    TArray<FName> GetPhaseBundles() const
+    {
+        return GetBundlesForPhase(GamePhase);
+    }
+
+    /**
+     * 进入主菜单阶段的 GameMode ，用于不是从 ARPGGameModeBase 派生的 GameMode ，比如 BP_MainMenuGameMode 。
+     * ARPGGameModeBase 使用自己的 GamePhase 属性。
+     */
+    /**
+     * Game modes that enter the MainMenu phase when they initialize, for game modes not derived from ARPGGameModeBase such as BP_MainMenuGameMode
+     * ARPGGameModeBase subclasses use their own GamePhase property instead
+     */
+    UPROPERTY(Config, EditAnywhere, Category = Item, meta = (MetaClass = "/Script/Engine.GameModeBase"))
+    TArray<FSoftClassPath> MainMenuGameModes;
+
+    /** 返回一个阶段需要的 Bundle */
+    /** Returns the bundles of the items that have to be resident in a phase */
+    virtual TArray<FName> GetBundlesForPhase(ERPGGamePhase Phase) const;
+
+    /**
+     * 返回一个阶段最近一次测量的道具 Bundle 内存，在阶段切换完成和每次垃圾回收之后更新
+     */
+    /** Returns the last measurement of item bundle memory in a phase, taken when its transition completed and after every garbage collection during it */
+    FRPGPhaseMemoryReport GetPhaseMemoryReport(ERPGGamePhase Phase) const;
+
+    /**
+     * 道具常驻管理：记录资产管理器加载的道具和它们已加载的 Bundle 资产的大小，超过 ItemResidencyBudgetMB 时
+     * 按最近最少使用的顺序卸载不在背包或插槽中的道具。
+     */
+    /**
+     * Item residency: tracks the items the asset manager keeps loaded and the size of their loaded bundle assets
+     * Once they exceed ItemResidencyBudgetMB, the least recently used items that are in no inventory, slot or current save game are
+     * unloaded with UnloadPrimaryAsset until the budget holds again. Runs after every LoadItemsAsync batch, phase transition and garbage collection
+     */
+    void UpdateItemResidency();
+
+    /** 记录道具被使用，最近使用的道具最后被换出 */
+    /** Marks an item as used, recently used items are evicted last. LoadItemsAsync and ForceLoadItem call this */
+    void TouchItem(const FPrimaryAssetId& ItemId) const;
+
+    /** Returns the residency counters as of the last UpdateItemResidency */
+    const FRPGItemResidencyStats& GetItemResidencyStats() const
+    {
+        return ItemResidencyStats;
+    }
+
+    /** 常驻道具的内存预算，0 表示不限制 */
+    /** Memory budget of resident items and their bundle assets in MB, 0 disables eviction */
+    UPROPERTY(Config, EditAnywhere, Category = Item, meta = (ClampMin = 0))
+    int32 ItemResidencyBudgetMB = 64;
+
+    /** 重新从资产注册表构建道具目录，编辑器中添加道具后使用 */
+    /** Rebuilds the item catalog from the asset registry, for the editor after items were added or changed */
+    void RebuildItemCatalog();
 
     UFUNCTION(BlueprintCallable)
     static void AssetManagerSample();
 
     void CallbackFunction(FPrimaryAssetId WeaponId);
+
+protected:
+    /** 道具目录，按类型和名称排序 */
+    /** Item catalog sorted by type and name */
+    TArray<FRPGItemInfo> ItemInfos;
+
+    /** 完成一批加载：收集道具、记录延迟并调用回调 */
+    /** Completes a LoadItemsAsync batch: gathers its items, records the latency and calls the delegate */
+    void FinishItemLoadBatch(const TArray<FPrimaryAssetId>& ItemIds, double StartTime, FRPGItemsLoadedDelegate OnLoaded);
+
+    /** 正在加载的道具和加载它的请求 */
+    /** Items being streamed by LoadItemsAsync and the request loading them */
+    struct FInFlightItemLoad
+    {
+        TWeakPtr<FStreamableHandle> Handle;
+
+        /** 这个请求加载的 Bundle ，只有需要的 Bundle 都在其中时才能共享请求 */
+        /** Bundles the request loads, a batch only shares the request if it needs no other bundle */
+        TArray<FName> Bundles;
+    };
+    TMap<FPrimaryAssetId, FInFlightItemLoad> InFlightItemLoads;
+
+    FRPGItemLoadStats ItemLoadStats;
+
+    /** 测量当前阶段的道具 Bundle 内存并记录 */
+    /** Measures the resident item bundle memory and records it for the current phase */
+    void UpdatePhaseMemoryReport();
+
+    /** 垃圾回收之后，释放的 Bundle 已经离开内存 */
+    /** After garbage collection released bundles have left memory, measure again */
+    void HandlePostGarbageCollect();
+
+    ERPGGamePhase GamePhase = ERPGGamePhase::MainMenu;
+
+    /** 阶段切换的加载，切换到下一个阶段时取消 */
+    /** Load started by the last phase transition, cancelled by the next one and cleared once it completes or is cancelled */
+    TSharedPtr<FStreamableHandle> PhaseTransitionHandle;
+
+    /** 根据 MainMenuGameModes 进入主菜单阶段 */
+    /** Enters the MainMenu phase for the game modes listed in MainMenuGameModes */
+    void HandleGameModeInitialized(AGameModeBase* GameMode);
+
+    TMap<ERPGGamePhase, FRPGPhaseMemoryReport> PhaseMemoryReports;
+
+    /** 收集背包、插槽和当前存档中的道具，这些道具不会被换出 */
+    /** Gathers the items of every player inventory, slot and current save game, which are never evicted */
+    void GatherItemsInUse(TSet<FPrimaryAssetId>& OutItemIds) const;
+
+    /** 卸载最近最少使用的道具直到满足预算，道具目录引用的道具不会被卸载 */
+    /** Unloads least recently used items until the budget holds. Items held by the item catalog are skipped, unloading them frees nothing */
+    void EvictItems();
+
+    /** 垃圾回收之后统计换出的资产中真正释放的大小 */
+    /** After garbage collection, adds the evicted assets that actually left memory to EvictedBytes */
+    void ConfirmEvictions();
+
+    /** 一个常驻的道具和它引用的资产 */
+    /** A resident item and the loaded assets it holds, itself included */
+    struct FResidentItem
+    {
+        TArray<FObjectKey> Assets;
+    };
+
+    /** 常驻的资产，可能被几个道具共享 */
+    /** A resident asset, possibly shared by several items */
+    struct FResidentAsset
+    {
+        int32 NumItems = 0;
+        int64 Bytes = 0;
+    };
+
+    TMap<FPrimaryAssetId, FResidentItem> ResidentItems;
+    TMap<FObjectKey, FResidentAsset> ResidentAssets;
+
+    /** 换出的资产和它们的大小，等待下一次垃圾回收确认 */
+    /** Assets released by evictions and their size, confirmed by the next garbage collection */
+    TMap<FObjectKey, int64> PendingEvictedAssets;
+
+    /** 每个道具最后一次使用的序号，在 const 的查找中也会更新 */
+    /** Use serial of every item, also updated from const lookups */
+    mutable TMap<FPrimaryAssetId, uint64> ItemLastUse;
+    mutable uint64 ItemUseSerial = 0;
+
+    FRPGItemResidencyStats ItemResidencyStats;
+
+    FDelegateHandle PostGarbageCollectHandle;
 };
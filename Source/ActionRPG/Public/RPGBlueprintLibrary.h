@@ -65,4 +65,23 @@ public:
 	/** Returns the project version set in the 'Project Settings' > 'Description' section of the editor */
 	UFUNCTION(BlueprintPure, Category = "Project")
 	static FString GetProjectVersion();
+
+	/** 切换游戏阶段，打开 / 关闭背包界面和进入主菜单时调用，决定道具的哪些 Bundle 保持加载 */
+	/** Switches the game phase that decides which item bundles stay resident. Call it when the inventory menu opens or closes and when entering the main menu */
+	UFUNCTION(BlueprintCallable, Category = Loading)
+	static void SetGamePhase(ERPGGamePhase NewPhase);
+
+	/** Returns the current game phase */
+	UFUNCTION(BlueprintPure, Category = Loading)
+	static ERPGGamePhase GetGamePhase();
+
+	/** 返回一个阶段中道具 Bundle 占用的内存 */
+	/** Returns the item bundle memory last measured in a game phase */
+	UFUNCTION(BlueprintPure, Category = Loading)
+	static FRPGPhaseMemoryReport GetPhaseMemoryReport(ERPGGamePhase Phase);
+
+	/** 返回常驻道具的数量、大小和换出次数 */
+	/** Returns the number and size of resident items and how many were evicted to stay within the budget */
+	UFUNCTION(BlueprintPure, Category = Loading)
+	static FRPGItemResidencyStats GetItemResidencyStats();
 };
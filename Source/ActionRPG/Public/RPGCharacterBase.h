@@ -158,6 +158,7 @@ protected:
 	/** Delegate handles */
 	FDelegateHandle InventoryUpdateHandle;
 	FDelegateHandle InventoryLoadedHandle;
+	FDelegateHandle InventoryChangeSetHandle;
 
 	/**
 	 * Called when character takes damage, which may have killed them
@@ -204,6 +205,10 @@ protected:
 	void OnItemSlotChanged(FRPGItemSlot ItemSlot, URPGItem* Item);
 	void RefreshSlottedGameplayAbilities();
 
+	/** 背包事务提交时调用，只有插槽改变时才刷新一次 Ability */
+	/** Called when an inventory transaction commits, refreshes abilities once if any slot changed */
+	void OnInventoryChangeSet(const FRPGInventoryChangeSet& ChangeSet);
+
 	/** 应用开始时的 GA 和 GE */
 	/** Apply the startup gameplay abilities and effects */
 	void AddStartupGameplayAbilities();
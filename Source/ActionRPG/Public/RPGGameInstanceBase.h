@@ -4,10 +4,12 @@
 
 #include "ActionRPG.h"
 #include "Engine/GameInstance.h"
+#include "RPGSaveJournal.h"
 #include "RPGGameInstanceBase.generated.h"
 
 class URPGItem;
 class URPGSaveGame;
+class IRPGSaveSyncBackend;
 
 /**
  * - 一个游戏中只有一个，可用于存储全局游戏数据
@@ -26,6 +28,8 @@ class ACTIONRPG_API URPGGameInstanceBase : public UGameInstance
 public:
 	// Constructor
 	URPGGameInstanceBase();
+	virtual void Init() override;
+	virtual void Shutdown() override;
 
 	/** 默认 inventory 中的物品，会添加到新的 player 的 inventory 中 */
 	/** List of inventory items to add to new players */
@@ -47,6 +51,70 @@ public:
 	UPROPERTY(BlueprintReadWrite, Category = Save)
 	int32 SaveUserIndex;
 
+	/**
+	 * 为 true 时背包的增量改变以记录的形式追加到存档旁边的日志中，而不是重写整个存档。
+	 * 完整的存档只在日志记录数超过 SaveJournalCompactionThreshold 、背包被整体替换或退出时写入。
+	 */
+	/**
+	 * If true, incremental inventory changes are appended as records to a journal next to the save slot instead of rewriting the whole save game.
+	 * The full snapshot is only written when the journal exceeds SaveJournalCompactionThreshold, when the inventory is replaced, or on exit
+	 */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = Save)
+	bool bUseSaveJournal = false;
+
+	/** 日志超过这个记录数时写入完整存档并压缩日志 */
+	/** Number of journal records after which a full snapshot is written and the journal compacted */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = Save, meta = (ClampMin = 1))
+	int32 SaveJournalCompactionThreshold = 256;
+
+	/**
+	 * 为 true 时保存只在游戏线程上捕获存档数据的快照，序列化、压缩和写入都在工作线程上进行。
+	 * 写入的是 FRPGSaveGameArchive 格式，只能由 LoadOrCreateSaveGame 读取，蓝图的 Async Load Game From Slot 不能读取，
+	 * 这时 HandleSaveGameLoaded 会在游戏线程上重新读取。
+	 */
+	/**
+	 * If true, a save only captures a snapshot of the save data on the game thread, serialization, compression and the write all run on a worker task
+	 * Slots are written in the FRPGSaveGameArchive format, which LoadOrCreateSaveGame reads but blueprint Async Load Game From Slot does not,
+	 * HandleSaveGameLoaded then reads the slot again on the game thread
+	 */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = Save)
+	bool bSerializeSaveOffGameThread = false;
+
+	/**
+	 * 存档的压缩方式，在工作线程上压缩。 None 时 USaveGame 格式的存档和以前一样写入，其他方式会加上 FRPGSaveGameArchive 的文件头。
+	 * LoadOrCreateSaveGame 可以读取所有的格式。蓝图的 Async Load Game From Slot 只能读取 None 的存档，
+	 * 其他格式要由 HandleSaveGameLoaded 在游戏线程上重新读取，所以应该使用 LoadOrCreateSaveGameAsync 或 bPrefetchSaveGame 。
+	 */
+	/**
+	 * Compression of written saves, applied on the worker task. With None, tagged property saves are written as before, otherwise they get the FRPGSaveGameArchive header
+	 * LoadOrCreateSaveGame reads every combination, including legacy saves. Blueprint Async Load Game From Slot only reads None,
+	 * other formats are read again on the game thread by HandleSaveGameLoaded, so load through LoadOrCreateSaveGameAsync or bPrefetchSaveGame instead
+	 */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = Save)
+	ERPGSaveCompression SaveCompression = ERPGSaveCompression::None;
+
+	/**
+	 * 为 true 时在 Init 中开始异步读取存档，读取和启动时的加载画面同时进行。
+	 * 蓝图不需要再调用 Async Load Game From Slot ，可以绑定 OnSaveGameLoaded 或调用 WaitForSaveGame 。
+	 */
+	/**
+	 * If true, Init starts LoadOrCreateSaveGameAsync so the slot is read while the startup loading screen is up
+	 * Blueprints should then bind OnSaveGameLoaded or call WaitForSaveGame instead of calling Async Load Game From Slot themselves
+	 */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = Save)
+	bool bPrefetchSaveGame = false;
+
+	/**
+	 * 远程存档同步服务的地址，不为空时 Init 创建 HTTP 后端，命令行的 -SaveSyncUrl= 优先。
+	 * 本地测试可以用 RPGSaveSyncServer commandlet 作为服务器。
+	 */
+	/**
+	 * Base URL of the remote save sync service. If set, Init installs a FRPGHttpSaveSyncBackend, -SaveSyncUrl= on the command line takes precedence
+	 * For local testing run the RPGSaveSyncServer commandlet and pass -SaveSyncUrl=http://127.0.0.1:8787
+	 */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = Save)
+	FString SaveSyncUrl;
+
 	/** 当存档被加载 / 重置时的代理 */
 	/** Delegate called when the save game has been loaded/reset */
 	UPROPERTY(BlueprintAssignable, Category = Inventory)
@@ -90,20 +158,86 @@ public:
 	UFUNCTION(BlueprintCallable, Category = Save)
 	bool LoadOrCreateSaveGame();
 
-	/** 返回加载的存档是否有效，无效的话会创建新的存档，最终将存档保存到 CurrentSaveGame 中 */
-	/** Handle the final setup required after loading a USaveGame object using AsyncLoadGameFromSlot. Returns true if it loaded, false if it created one */
+	/**
+	 * LoadOrCreateSaveGame 的异步版本，在工作线程上读取和解码存档，完成后在游戏线程上调用 HandleSaveGameLoaded 。
+	 */
+	/** Asynchronous LoadOrCreateSaveGame. The slot is read and decoded on a worker and HandleSaveGameLoaded runs on the game thread once it is done */
+	UFUNCTION(BlueprintCallable, Category = Save)
+	void LoadOrCreateSaveGameAsync();
+
+	/**
+	 * 等待异步读取的存档，最多等待 TimeoutSeconds 秒，用于需要提前拿到存档的地方。返回存档是否可用。
+	 */
+	/** Blocks up to TimeoutSeconds for a pending LoadOrCreateSaveGameAsync, for callers that need the save game early. Returns true if the save game is available */
+	UFUNCTION(BlueprintCallable, Category = Save)
+	bool WaitForSaveGame(float TimeoutSeconds = 5.0f);
+
+	/** Returns true while LoadOrCreateSaveGameAsync has not completed */
+	UFUNCTION(BlueprintPure, Category = Save)
+	bool IsSaveGameLoading() const;
+
+	/**
+	 * 返回加载的存档是否有效，无效的话会创建新的存档，最终将存档保存到 CurrentSaveGame 中。
+	 * Async Load Game From Slot 不能读取压缩或在工作线程上序列化的存档，这时会通过 FRPGSaveGameArchive 重新同步读取这个 slot 。
+	 */
+	/**
+	 * Handle the final setup required after loading a USaveGame object using AsyncLoadGameFromSlot. Returns true if it loaded, false if it created one
+	 * Async Load Game From Slot returns null for compressed or off game thread saves, the slot is then read again synchronously through FRPGSaveGameArchive
+	 */
 	UFUNCTION(BlueprintCallable, Category = Save)
 	bool HandleSaveGameLoaded(USaveGame* SaveGameObject);
 
+	/** 返回写入存档索引的角色等级，默认使用第一个本地玩家控制的角色 */
+	/** Returns the character level recorded in the save slot index, defaults to the pawn of the first local player. 0 if unknown */
+	UFUNCTION(BlueprintNativeEvent, BlueprintCallable, Category = Save)
+	int32 GetSaveCharacterLevel() const;
+
 	/** 获得 SlotName 和 UserIndex 的 Helper 函数 */
 	/** Gets the save game slot and user index used for inventory saving, ready to pass to GameplayStatics save functions */
 	UFUNCTION(BlueprintCallable, Category = Save)
 	void GetSaveSlotInfo(FString& SlotName, int32& UserIndex) const;
 
-	/** 把当前保存的游戏写入硬盘，在后台线程中进行。 */
-	/** Writes the current save game object to disk. The save to disk happens in a background thread*/
+	/**
+	 * 请求把当前保存的游戏写入硬盘，由 URPGSaveSubsystem 按优先级合并后在后台线程中写入。
+	 * 存档点和切换关卡应该使用 Immediate 。
+	 */
+	/**
+	 * Requests a write of the current save game object to disk. URPGSaveSubsystem coalesces requests by priority and writes in a background thread
+	 * Checkpoints and level transitions should pass Immediate
+	 */
+	UFUNCTION(BlueprintCallable, Category = Save)
+	bool WriteSaveGame(ERPGSavePriority Priority = ERPGSavePriority::Normal);
+
+	/** 是否使用存档日志，需要同时启用保存 */
+	/** Returns true if incremental saves go to the journal */
+	UFUNCTION(BlueprintPure, Category = Save)
+	bool IsSaveJournalEnabled() const;
+
+	/** 记录一个道具的改变，ItemData 为空代表移除，在 AppendSaveJournal 时写入 */
+	/** Records an item change for the next AppendSaveJournal, a null ItemData records a removal. CurrentSaveGame must already hold the change */
+	void JournalInventoryItem(const FPrimaryAssetId& ItemId, const FRPGItemData* ItemData);
+
+	/** 记录一个插槽的改变，在 AppendSaveJournal 时写入 */
+	/** Records a slot change for the next AppendSaveJournal. CurrentSaveGame must already hold the change */
+	void JournalSlottedItem(const FRPGItemSlot& ItemSlot, const FPrimaryAssetId& ItemId);
+
+	/**
+	 * 把记录的改变追加到日志中，日志过长时会写入完整存档。没有启用日志时等同于 WriteSaveGame 。
+	 */
+	/**
+	 * Queues the recorded changes to be appended to the journal on a worker, writing a full snapshot if it grew too long or an earlier append failed
+	 * Same as WriteSaveGame when the journal is disabled
+	 */
 	UFUNCTION(BlueprintCallable, Category = Save)
-	bool WriteSaveGame();
+	bool AppendSaveJournal();
+
+	/** 设置远程存档的后端，为空时停止同步 */
+	/** Installs the remote save backend used by URPGSaveSyncSubsystem, a null backend stops syncing */
+	void SetSaveSyncBackend(TSharedPtr<IRPGSaveSyncBackend> Backend);
+
+	/** 背包被整体替换之后调用，下一次同步上传完整的存档 */
+	/** Call after the inventory in the save game was rebuilt as a whole, the next sync uploads the whole save game */
+	void RequestFullSaveSync();
 
 	/** 重置存档，只会重置 CurrentSaveGame ，不会直接写入硬盘 */
 	/** Resets the current save game to it's default. This will erase player data! This won't save to disk until the next WriteSaveGame */
@@ -111,6 +245,10 @@ public:
 	void ResetSaveGame();
 
 protected:
+	/** 替换 CurrentSaveGame ， SaveGame 为空时创建新的存档。返回是否使用了读取的存档 */
+	/** Replaces CurrentSaveGame, creating a new one if SaveGame is null. Returns true if the loaded save was used */
+	bool ApplySaveGame(URPGSaveGame* SaveGame);
+
 	/** 当前的存档 */
 	/** The current save game object */
 	UPROPERTY()
@@ -121,17 +259,22 @@ protected:
 	UPROPERTY()
 	bool bSavingEnabled;
 
-	/** 是否正在进行保存操作 */
-	/** True if we are in the middle of doing a save */
-	UPROPERTY()
-	bool bCurrentlySaving;
+	friend class URPGSaveSubsystem;
+	friend class URPGSaveSlotManager;
 
-	/** 是否有由于当前正在进行保存而等待的保存操作 */
-	/** True if another save was requested during a save */
-	UPROPERTY()
-	bool bPendingSaveRequested;
+	/** 返回当前 SaveSlot 的日志，SaveSlot 改变时重新创建 */
+	/** Returns the journal of the current SaveSlot, recreating it if the slot changed */
+	FRPGSaveJournal& GetSaveJournal();
+
+	/** 当前 SaveSlot 的日志 */
+	/** Journal of the save slot, created on first use */
+	TUniquePtr<FRPGSaveJournal> SaveJournal;
+
+	/** URPGSaveSubsystem 开始写入完整存档之前调用 */
+	/** Called by URPGSaveSubsystem right before it serializes the save game for a write */
+	virtual void HandleSaveWriteStarted();
 
 	/** 当发生异步保存时调用 */
-	/** Called when the async save happens */
+	/** Called by URPGSaveSubsystem when the async save happens */
 	virtual void HandleAsyncSave(const FString& SlotName, const int32 UserIndex, bool bSuccess);
 };
\ No newline at end of file
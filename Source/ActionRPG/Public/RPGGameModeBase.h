@@ -45,6 +45,15 @@ public:
 	UFUNCTION(BlueprintCallable, Category=Game)
 	virtual void GameOver();
 
+	/** 开始游戏时切换到 GamePhase ，第一次开始游戏时记录启动时间 */
+	/** Switches URPGAssetManager to GamePhase, the first call also ends the startup profile */
+	virtual void StartPlay() override;
+
+	/** 这个 GameMode 的游戏阶段，主菜单的 GameMode 应该设置为 MainMenu */
+	/** Game phase entered when play starts, a main menu game mode should use MainMenu */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category=Game)
+	ERPGGamePhase GamePhase = ERPGGamePhase::Gameplay;
+
 protected:
 	/**
 	 * BlueprintImplementableEvent 和 BlueprintNativeEvent 都是可以在蓝图中定义的函数，区别是 BlueprintImplementableEvent 没有
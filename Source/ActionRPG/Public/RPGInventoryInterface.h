@@ -3,6 +3,7 @@
 #pragma once
 
 #include "ActionRPG.h"
+#include "RPGInventoryTypes.h"
 #include "RPGInventoryInterface.generated.h"
 
 /**
@@ -30,9 +31,16 @@ class ACTIONRPG_API IRPGInventoryInterface
 	GENERATED_BODY()
 
 public:
-	/** Returns the map of items to data */
+	/** 返回从道具到数据的 TMap ，背包不是用 TMap 保存的，所以每次改变后第一次调用都会重新构造，应该优先使用 CreateInventoryIterator */
+	/** Returns the map of items to data. The inventory is not stored as a map, so this rebuilds it after every change, prefer CreateInventoryIterator */
 	virtual const TMap<URPGItem*, FRPGItemData>& GetInventoryDataMap() const = 0;
 
+	/** Returns an iterator over the items and their data */
+	virtual FRPGCompactInventory::FConstIterator CreateInventoryIterator() const = 0;
+
+	/** Returns the number of items in the inventory */
+	virtual int32 GetInventoryItemNum() const = 0;
+
 	/** Returns the map of slots to items */
 	virtual const TMap<FRPGItemSlot, URPGItem*>& GetSlottedItemMap() const = 0;
 
@@ -44,5 +52,8 @@ public:
 
 	/** Gets the delegate for when the inventory loads */
 	virtual FOnInventoryLoadedNative& GetInventoryLoadedDelegate() = 0;
+
+	/** Gets the delegate for aggregated changes, changes made inside a transaction are only reported here */
+	virtual FOnInventoryChangeSetNative& GetInventoryChangeSetDelegate() = 0;
 };
 
@@ -0,0 +1,151 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+// ----------------------------------------------------------------------------------------------------------------
+// 背包的网络复制，服务器修改背包时只会发送改变的条目，客户端按条目收到添加 / 改变 / 移除的回调
+// ----------------------------------------------------------------------------------------------------------------
+
+// ----------------------------------------------------------------------------------------------------------------
+// Replicated form of the inventory in ARPGPlayerControllerBase, using fast array delta serialization keyed by item id
+// The server only sends entries that changed and clients get a callback per added, changed or removed entry
+// ----------------------------------------------------------------------------------------------------------------
+
+#include "ActionRPG.h"
+#include "Net/Serialization/FastArraySerializer.h"
+#include "RPGInventoryReplication.generated.h"
+
+class ARPGPlayerControllerBase;
+struct FRPGReplicatedInventory;
+struct FRPGReplicatedSlots;
+
+/** 背包中的一个道具，用 FPrimaryAssetId 代替 URPGItem */
+/** One inventory entry, keyed by item id like the save game */
+USTRUCT()
+struct ACTIONRPG_API FRPGReplicatedInventoryEntry : public FFastArraySerializerItem
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FPrimaryAssetId ItemId;
+
+	UPROPERTY()
+	FRPGItemData ItemData;
+
+	// FFastArraySerializerItem callbacks, called on clients only
+	void PreReplicatedRemove(const FRPGReplicatedInventory& InArraySerializer) const;
+	void PostReplicatedAdd(const FRPGReplicatedInventory& InArraySerializer) const;
+	void PostReplicatedChange(const FRPGReplicatedInventory& InArraySerializer) const;
+};
+
+/** 复制的 InventoryStore */
+/** Replicated InventoryStore, written by the server through the controller's storage writers */
+USTRUCT()
+struct ACTIONRPG_API FRPGReplicatedInventory : public FFastArraySerializer
+{
+	GENERATED_BODY()
+
+	/** 添加或更新一个道具，只会标记这个条目 */
+	/** Adds or updates an entry, only that entry is marked dirty */
+	void SetItem(const FPrimaryAssetId& ItemId, const FRPGItemData& ItemData);
+
+	/** Removes an entry if present */
+	void RemoveItem(const FPrimaryAssetId& ItemId);
+
+	/** Removes all entries */
+	void Reset();
+
+	const TArray<FRPGReplicatedInventoryEntry>& GetEntries() const
+	{
+		return Entries;
+	}
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+	{
+		return FFastArraySerializer::FastArrayDeltaSerialize<FRPGReplicatedInventoryEntry, FRPGReplicatedInventory>(Entries, DeltaParms, *this);
+	}
+
+	/** 接收回调的控制器，不会被复制 */
+	/** Controller receiving the client callbacks, not replicated */
+	ARPGPlayerControllerBase* Owner = nullptr;
+
+private:
+	UPROPERTY()
+	TArray<FRPGReplicatedInventoryEntry> Entries;
+
+	/** 服务器上从道具到条目下标的映射 */
+	/** Server side lookup from item id to entry index */
+	TMap<FPrimaryAssetId, int32> EntryIndices;
+};
+
+template<>
+struct TStructOpsTypeTraits<FRPGReplicatedInventory> : public TStructOpsTypeTraitsBase2<FRPGReplicatedInventory>
+{
+	enum
+	{
+		WithNetDeltaSerializer = true,
+	};
+};
+
+/** 一个装备插槽，空插槽的 ItemId 无效 */
+/** One item slot, ItemId is invalid for an empty slot */
+USTRUCT()
+struct ACTIONRPG_API FRPGReplicatedSlotEntry : public FFastArraySerializerItem
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FRPGItemSlot ItemSlot;
+
+	UPROPERTY()
+	FPrimaryAssetId ItemId;
+
+	// FFastArraySerializerItem callbacks, called on clients only
+	void PreReplicatedRemove(const FRPGReplicatedSlots& InArraySerializer) const;
+	void PostReplicatedAdd(const FRPGReplicatedSlots& InArraySerializer) const;
+	void PostReplicatedChange(const FRPGReplicatedSlots& InArraySerializer) const;
+};
+
+/** 复制的 SlottedItems ，插槽布局由双方的 ItemSlotsPerType 决定，所以只有装备过道具的插槽才有条目 */
+/** Replicated SlottedItems. Both sides share the layout from ItemSlotsPerType, so only slots that held an item get an entry */
+USTRUCT()
+struct ACTIONRPG_API FRPGReplicatedSlots : public FFastArraySerializer
+{
+	GENERATED_BODY()
+
+	/** 设置插槽中的道具，只会标记这个条目 */
+	/** Sets the item id of a slot, only that entry is marked dirty */
+	void SetSlot(const FRPGItemSlot& ItemSlot, const FPrimaryAssetId& ItemId);
+
+	/** Removes all entries */
+	void Reset();
+
+	const TArray<FRPGReplicatedSlotEntry>& GetEntries() const
+	{
+		return Entries;
+	}
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+	{
+		return FFastArraySerializer::FastArrayDeltaSerialize<FRPGReplicatedSlotEntry, FRPGReplicatedSlots>(Entries, DeltaParms, *this);
+	}
+
+	/** Controller receiving the client callbacks, not replicated */
+	ARPGPlayerControllerBase* Owner = nullptr;
+
+private:
+	UPROPERTY()
+	TArray<FRPGReplicatedSlotEntry> Entries;
+
+	/** Server side lookup from slot to entry index */
+	TMap<FRPGItemSlot, int32> EntryIndices;
+};
+
+template<>
+struct TStructOpsTypeTraits<FRPGReplicatedSlots> : public TStructOpsTypeTraitsBase2<FRPGReplicatedSlots>
+{
+	enum
+	{
+		WithNetDeltaSerializer = true,
+	};
+};
@@ -0,0 +1,328 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+// ----------------------------------------------------------------------------------------------------------------
+// 背包的实现中使用的容器，和 RPGTypes.h 不同，这些类型不会暴露给蓝图
+// ----------------------------------------------------------------------------------------------------------------
+
+// ----------------------------------------------------------------------------------------------------------------
+// Containers used by the inventory implementation in RPGPlayerControllerBase
+// Unlike RPGTypes.h these are native only and never exposed to blueprints
+// ----------------------------------------------------------------------------------------------------------------
+
+#include "ActionRPG.h"
+#include "UObject/GCObject.h"
+
+class URPGItem;
+
+/**
+ * 全局的道具目录，每个背包中的道具在这里分配一个下标，背包只需要保存下标。
+ * 条目按持有道具的背包计数，目录统一引用计数大于 0 的道具，所以 GC 只需要遍历这一个数组，不需要遍历每个背包的每个条目。
+ * 道具离开所有背包后引用被释放，可以被垃圾回收，下标会被之后的道具重用。
+ */
+/**
+ * Global catalog interning every item held by an inventory into an index, so inventories store plain indices
+ * Entries are reference counted by the inventories holding the item. The catalog holds the strong references while the count is above zero,
+ * so GC traces this one array instead of every entry of every inventory. Once an item left every inventory its reference is dropped and it
+ * can be garbage collected again, its index is recycled for the next interned item
+ */
+class ACTIONRPG_API FRPGItemCatalog : public FGCObject
+{
+public:
+	static FRPGItemCatalog& Get();
+
+	/** 增加道具的引用计数并返回下标，第一次使用时分配 */
+	/** Adds a reference to an item and returns its index, assigning one if the item holds none */
+	int32 AddRef(URPGItem* Item);
+
+	/** 减少引用计数，最后一个引用释放时释放道具和下标 */
+	/** Drops a reference taken by AddRef, the last one releases the item and its index */
+	void Release(int32 CatalogIndex);
+
+	/** Returns the index of an item, or INDEX_NONE if no inventory holds it */
+	int32 Find(const URPGItem* Item) const;
+
+	/** Returns the item at an index */
+	URPGItem* GetItem(int32 CatalogIndex) const
+	{
+		return Entries[CatalogIndex].Item;
+	}
+
+	/** Returns the number of items held by at least one inventory */
+	int32 Num() const
+	{
+		return Entries.Num() - FreeIndices.Num();
+	}
+
+	// FGCObject interface
+	virtual void AddReferencedObjects(FReferenceCollector& Collector) override;
+	virtual FString GetReferencerName() const override;
+
+private:
+	struct FEntry
+	{
+		TObjectPtr<URPGItem> Item;
+		int32 RefCount = 0;
+	};
+
+	TArray<FEntry> Entries;
+
+	/** 释放的下标，之后的道具重用 */
+	/** Released indices, reused before the array grows */
+	TArray<int32> FreeIndices;
+};
+
+/**
+ * 紧凑的背包存储，条目是连续的 {目录下标, 数量, 等级} ，通过目录下标直接找到条目，不需要哈希 UObject 指针。
+ * 移除时用最后一个条目填补，所以遍历顺序不是固定的。
+ */
+/**
+ * Compact inventory storage: a dense array of {catalog index, count, level} and a table from catalog index to entry index
+ * Lookups go item -> catalog index -> entry without hashing UObject pointers, and entries hold no object references for GC to trace
+ * Removal swaps the last entry into the hole, so iteration order is not stable
+ */
+struct ACTIONRPG_API FRPGCompactInventory
+{
+	FRPGCompactInventory() = default;
+
+	/** 释放在目录中的引用 */
+	/** Releases the catalog references of the stored items */
+	~FRPGCompactInventory()
+	{
+		Reset();
+	}
+
+	/** 每个条目持有一个目录引用，不能复制 */
+	/** Every entry holds a catalog reference, so the storage is not copyable */
+	UE_NONCOPYABLE(FRPGCompactInventory);
+
+	/** Returns the data of an item, or null if it is not in the inventory */
+	const FRPGItemData* Find(const URPGItem* Item) const;
+
+	/** Returns true if the item is in the inventory */
+	bool Contains(const URPGItem* Item) const
+	{
+		return Find(Item) != nullptr;
+	}
+
+	/** 添加或更新一个道具，返回道具之前是否不在背包中 */
+	/** Adds or updates an item, returns true if it was not in the inventory before */
+	bool Set(URPGItem* Item, const FRPGItemData& ItemData);
+
+	/** Removes an item, returns true if it was in the inventory */
+	bool Remove(const URPGItem* Item);
+
+	/** Removes all items and releases their catalog references */
+	void Reset();
+
+	/** Returns the number of items */
+	int32 Num() const
+	{
+		return Entries.Num();
+	}
+
+	/** Returns the memory used by the storage, not counting the shared catalog */
+	SIZE_T GetAllocatedSize() const;
+
+	/** 遍历背包中的道具，不需要构造 TMap */
+	/** Iterates the inventory without materialising a map */
+	class FConstIterator
+	{
+	public:
+		explicit FConstIterator(const FRPGCompactInventory& InInventory)
+			: Inventory(InInventory)
+		{}
+
+		FConstIterator& operator++()
+		{
+			++EntryIndex;
+			return *this;
+		}
+
+		explicit operator bool() const
+		{
+			return Inventory.Entries.IsValidIndex(EntryIndex);
+		}
+
+		URPGItem* GetItem() const
+		{
+			return FRPGItemCatalog::Get().GetItem(Inventory.Entries[EntryIndex].CatalogIndex);
+		}
+
+		const FRPGItemData& GetItemData() const
+		{
+			return Inventory.Entries[EntryIndex].ItemData;
+		}
+
+	private:
+		const FRPGCompactInventory& Inventory;
+		int32 EntryIndex = 0;
+	};
+
+	FConstIterator CreateConstIterator() const
+	{
+		return FConstIterator(*this);
+	}
+
+private:
+	struct FEntry
+	{
+		int32 CatalogIndex;
+		FRPGItemData ItemData;
+	};
+
+	/** Items in the inventory */
+	TArray<FEntry> Entries;
+
+	/** 从目录下标到条目下标的表，不在背包中时是 INDEX_NONE ，只增长到用到的最大下标 */
+	/** Entry index per catalog index, INDEX_NONE if not in this inventory. Only grows up to the highest catalog index used */
+	TArray<int32> EntryIndices;
+};
+
+/**
+ * 装备插槽的稠密表，布局在加载背包时由 URPGGameInstanceBase::ItemSlotsPerType 决定。
+ * 同一类型的插槽在数组中是连续的，每种类型有一个空插槽的位图，所以查找编号最小的空插槽和判断道具是否已经装备都是 O(1) 的。
+ */
+/**
+ * Dense table of item slots, laid out once from URPGGameInstanceBase::ItemSlotsPerType when the inventory loads
+ * Slots of one type are contiguous and each type keeps a free-slot bitmap, so finding the lowest empty slot and checking if an item is slotted are O(1)
+ * A reverse index from item to the slots holding it lets unslotting touch only the affected slots
+ */
+struct ACTIONRPG_API FRPGItemSlotTable
+{
+	/** 根据每种类型的插槽数量重建布局，所有插槽都是空的 */
+	/** Rebuilds the layout from the number of slots per type, all slots start empty */
+	void Initialize(const TMap<FPrimaryAssetType, int32>& SlotsPerType);
+
+	/** Removes all slots */
+	void Reset();
+
+	/** Returns the number of slots in the table */
+	int32 Num() const
+	{
+		return Items.Num();
+	}
+
+	/** 返回插槽在稠密数组中的下标，不存在时返回 INDEX_NONE */
+	/** Returns the dense index of a slot, or INDEX_NONE if the table does not have it */
+	int32 GetSlotIndex(const FRPGItemSlot& ItemSlot) const;
+
+	/** Returns item in slot, or null if empty or not a valid slot */
+	URPGItem* GetItem(const FRPGItemSlot& ItemSlot) const;
+
+	/** 设置插槽中的道具，返回之前的道具，插槽必须存在 */
+	/** Sets the item in a slot and returns the previous one, the slot must exist */
+	URPGItem* SetItem(const FRPGItemSlot& ItemSlot, URPGItem* Item);
+
+	/** 返回这个类型中编号最小的空插槽，没有时返回无效的插槽 */
+	/** Returns the lowest numbered empty slot of a type, or an invalid slot if all are full */
+	FRPGItemSlot FindFreeSlot(const FPrimaryAssetType& ItemType) const;
+
+	/** Returns true if the item is in at least one slot */
+	bool IsItemSlotted(const URPGItem* Item) const
+	{
+		return Item != nullptr && ItemSlots.Contains(Item);
+	}
+
+	/** 通过反向索引找到所有装备了这个道具的插槽 */
+	/** Finds every slot holding the item from the reverse index */
+	void FindSlotsWithItem(const URPGItem* Item, TArray<FRPGItemSlot>& OutSlots) const;
+
+	/** 检查插槽表、空位图和反向索引是否和 SlottedItems 一致，用于调试 */
+	/** Checks the table, free-slot bitmaps and reverse index against SlottedItems, for debugging */
+	bool IsConsistentWith(const TMap<FRPGItemSlot, URPGItem*>& SlottedItems) const;
+
+	/** 按插槽编号输出一个类型的全部道具，类型无效时输出全部，空插槽输出 null */
+	/** Appends the items of every slot of a type in slot order, all types if the type is invalid. Empty slots append null */
+	void GetItems(const FPrimaryAssetType& ItemType, TArray<URPGItem*>& OutItems) const;
+
+private:
+	/** 一种类型的插槽在稠密数组中的范围 */
+	/** Range of one type's slots inside the dense array */
+	struct FTypeRange
+	{
+		int32 FirstIndex = 0;
+		int32 NumSlots = 0;
+
+		/** 为 true 的位代表空插槽 */
+		/** Bits set to true are empty slots */
+		TBitArray<> FreeSlots;
+	};
+
+	/** Per-type ranges, there are only a handful of types */
+	TMap<FPrimaryAssetType, FTypeRange> TypeRanges;
+
+	/** Item in each slot, null if empty */
+	TArray<URPGItem*> Items;
+
+	/** 从道具到装备了它的插槽的反向索引，一个道具通常只在一个插槽中 */
+	/** Reverse index from item to the slots holding it, an item is usually in a single slot */
+	TMap<const URPGItem*, TArray<FRPGItemSlot, TInlineAllocator<1>>> ItemSlots;
+};
+
+/**
+ * 背包中道具按类型分桶的二级索引，每个桶同时维护按价格和名称排序的数组，在添加 / 移除道具时增量更新。
+ * 按类型和排序方式查询的代价和结果的数量成正比。
+ */
+/**
+ * Secondary index of inventory items bucketed by item type. Each bucket also keeps stable price and name orders,
+ * updated incrementally on add/remove, so filtered and sorted queries cost time proportional to the result size
+ */
+struct ACTIONRPG_API FRPGInventoryItemIndex
+{
+	/** 道具进入背包时调用 */
+	/** Call when an item enters the inventory */
+	void Add(URPGItem* Item);
+
+	/** 道具离开背包时调用 */
+	/** Call when an item leaves the inventory */
+	void Remove(URPGItem* Item);
+
+	/** Removes all items */
+	void Reset();
+
+	/** 按排序方式输出一个类型的全部道具，类型无效时输出全部 */
+	/** Appends every item of a type in the requested order, all types if the type is invalid */
+	void GetItems(const FPrimaryAssetType& ItemType, ERPGInventorySortOrder SortOrder, TArray<URPGItem*>& OutItems) const;
+
+	/** Returns the number of items of a type, all types if the type is invalid */
+	int32 Num(const FPrimaryAssetType& ItemType) const;
+
+private:
+	/** 一种类型的道具 */
+	/** Items of one type */
+	struct FBucket
+	{
+		/** 一个道具在 Items 中的位置和加入时的排序数据 */
+		/** Position of an item in Items and the sort keys it was inserted with */
+		struct FEntry
+		{
+			int32 Position = INDEX_NONE;
+			int32 Price = 0;
+			FText ItemName;
+		};
+
+		/** 加入的顺序，移除时最后一个道具补到空位 */
+		/** Insertion order, a removal moves the last item into the gap */
+		TArray<URPGItem*> Items;
+
+		/** Sorted by price, then asset name */
+		TArray<URPGItem*> ByPrice;
+
+		/** Sorted by item name, then asset name */
+		TArray<URPGItem*> ByName;
+
+		TMap<const URPGItem*, FEntry> Entries;
+
+		const TArray<URPGItem*>& GetOrder(ERPGInventorySortOrder SortOrder) const;
+
+		/** 用加入时记录的数据比较 */
+		/** Compare with the keys recorded on insertion */
+		bool PriceLess(const URPGItem* A, const URPGItem* B) const;
+		bool NameLess(const URPGItem* A, const URPGItem* B) const;
+	};
+
+	/** Buckets keyed by item type, there are only a handful of types */
+	TMap<FPrimaryAssetType, FBucket> Buckets;
+};
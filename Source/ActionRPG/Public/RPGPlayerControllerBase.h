@@ -4,9 +4,39 @@
 
 #include "ActionRPG.h"
 #include "GameFramework/PlayerController.h"
+#include "Engine/StreamableManager.h"
 #include "RPGInventoryInterface.h"
+#include "RPGInventoryTypes.h"
+#include "RPGInventoryReplication.h"
 #include "RPGPlayerControllerBase.generated.h"
 
+/** 异步加载背包期间请求的修改，加载完成后按顺序应用到加载的背包上 */
+/** An inventory change requested while the async inventory load was in flight, applied in order on top of the loaded inventory */
+USTRUCT()
+struct FRPGQueuedInventoryChange
+{
+	GENERATED_BODY()
+
+	enum class EType : uint8
+	{
+		Add,
+		Remove,
+		SetSlot
+	};
+
+	EType Type = EType::Add;
+
+	/** 队列中的道具还不在背包中，需要在这里引用 */
+	/** Queued items are not in the inventory yet, so they are referenced here */
+	UPROPERTY()
+	URPGItem* Item = nullptr;
+
+	FRPGItemSlot ItemSlot;
+	int32 ItemCount = 0;
+	int32 ItemLevel = 0;
+	bool bAutoSlot = false;
+};
+
 /** 几乎所有游戏都需要继承 PlayerController ，本项目中主要处理 inventory */
 /** Base class for PlayerController, should be blueprinted */
 UCLASS()
@@ -18,11 +48,16 @@ public:
 	// Constructor and overrides
 	ARPGPlayerControllerBase() {}
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void PostInitializeComponents() override;
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
 
-	/** 从 item 定义到 item 数据的映射，保存 player 拥有的全部 item */
-	/** Map of all items owned by this player, from definition to data */
-	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Inventory)
-	TMap<URPGItem*, FRPGItemData> InventoryData;
+	/**
+	 * player 拥有的全部 item 及其数据，使用紧凑的存储，道具由 FRPGItemCatalog 统一引用。
+	 * 遍历使用 CreateInventoryIterator ，只读访问使用 GetInventoryItemData 。
+	 */
+	/** All items owned by this player with their data, in compact storage. Items are referenced through FRPGItemCatalog */
+	FRPGCompactInventory InventoryStore;
 
 	/**
 	 * 从类型/数量到 Item 定义的映射，保存装备的道具
@@ -59,6 +94,45 @@ public:
 	/** Native version above, called before BP delegate */
 	FOnInventoryLoadedNative OnInventoryLoadedNative;
 
+	/** 背包事务提交时的 BP 委托，包含事务中全部改变的汇总 */
+	/** Delegate called once when an inventory transaction commits, with all changes it made */
+	UPROPERTY(BlueprintAssignable, Category = Inventory)
+	FOnInventoryChangeSet OnInventoryChangeSet;
+
+	/** 背包事务提交时的 Native 委托，在 ARPGCharacterBase::PossessedBy 中绑定 */
+	/** Native version above, called before BP delegate */
+	FOnInventoryChangeSetNative OnInventoryChangeSetNative;
+
+	/**
+	 * 事务提交时是否对每个改变过的道具 / 插槽补发一次 BP 的委托和事件，这样只监听单个改变的蓝图（比如 UI）也能更新。
+	 * Native 的单个改变委托在事务中不会触发，Native 代码应该监听 OnInventoryChangeSetNative 。
+	 */
+	/**
+	 * If true, committing a transaction also fires the per-change BP delegates and events once per distinct item and slot, so blueprints that only listen to single changes still update.
+	 * Native per-change delegates are never fired for changes made inside a transaction, native listeners should use OnInventoryChangeSetNative
+	 */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Inventory)
+	bool bReplayBlueprintNotificationsOnCommit = true;
+
+	/** 帧末尾的 BP 委托，包含这一帧中背包的全部改变，需要开启 bDeferInventoryChangeSets */
+	/** Delegate called once at the end of a frame with every inventory change made during it, requires bDeferInventoryChangeSets */
+	UPROPERTY(BlueprintAssignable, Category = Inventory)
+	FOnInventoryChangeSet OnDeferredInventoryChangeSet;
+
+	/** Native version above, called before BP delegate */
+	FOnInventoryChangeSetNative OnDeferredInventoryChangeSetNative;
+
+	/**
+	 * 为 true 时记录每一帧中背包的改变，在帧末尾通过 OnDeferredInventoryChangeSet 一次性通知，适合需要重建 UI 的监听者。
+	 * 单个改变的委托仍然会立即触发。
+	 */
+	/**
+	 * If true, inventory changes are accumulated over the frame and delivered once at end of frame through OnDeferredInventoryChangeSet,
+	 * so listeners that rebuild widgets do it once per frame. The immediate per-change delegates still fire as before
+	 */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = Inventory)
+	bool bDeferInventoryChangeSets = false;
+
 	/** 在通知了所有的委托之后调用，在蓝图的实现中负责处理 UI 的逻辑，可能是为了先保证更新数据再更新 UI */
 	/** Called after the inventory was changed and we notified all delegates */
 	UFUNCTION(BlueprintImplementableEvent, Category = Inventory)
@@ -69,22 +143,66 @@ public:
 	UFUNCTION(BlueprintImplementableEvent, Category = Inventory)
 	void SlottedItemChanged(FRPGItemSlot ItemSlot, URPGItem* Item);
 
-	/** 向背包中添加一个新道具，默认自动装备 */
-	/** Adds a new inventory item, will add it to an empty slot if possible. If the item supports count you can add more than one count. It will also update the level when adding if required */
+	/** 事务提交并通知了所有的委托之后调用 */
+	/** Called after an inventory transaction committed and we notified all delegates */
+	UFUNCTION(BlueprintImplementableEvent, Category = Inventory)
+	void InventoryChangeSetCommitted(const FRPGInventoryChangeSet& ChangeSet);
+
+	/** 帧末尾通知了所有的委托之后调用 */
+	/** Called at end of frame after the deferred change set was broadcast to all delegates */
+	UFUNCTION(BlueprintImplementableEvent, Category = Inventory)
+	void DeferredInventoryChangeSet(const FRPGInventoryChangeSet& ChangeSet);
+
+	/** 立即发送这一帧中还没有通知的改变，不需要等到帧末尾。返回是否有改变 */
+	/** Delivers the changes accumulated so far in this frame without waiting for its end. Returns true if anything was pending */
+	UFUNCTION(BlueprintCallable, Category = Inventory)
+	bool FlushDeferredInventoryChanges();
+
+	/**
+	 * 开始一个背包事务，在提交之前所有的改变只会被记录，不会通知也不会保存，可以嵌套，最外层的提交才会生效。
+	 * 在 C++ 中推荐使用 FRPGScopedInventoryTransaction 。
+	 */
+	/**
+	 * Starts an inventory transaction. Until the matching commit, changes are recorded but not broadcast or saved.
+	 * Transactions nest, only the outermost commit takes effect. From native code prefer FRPGScopedInventoryTransaction
+	 */
+	UFUNCTION(BlueprintCallable, Category = Inventory)
+	void BeginInventoryTransaction();
+
+	/** 提交背包事务，最外层的提交会广播一次改变的汇总，并且最多保存一次。返回是否有改变 */
+	/** Commits an inventory transaction. The outermost commit broadcasts one change set and saves at most once. Returns true if anything changed */
+	UFUNCTION(BlueprintCallable, Category = Inventory)
+	bool CommitInventoryTransaction();
+
+	/** Returns true if an inventory transaction is open */
+	UFUNCTION(BlueprintPure, Category = Inventory)
+	bool IsInInventoryTransaction() const;
+
+	/** 向背包中添加一个新道具，默认自动装备。异步加载背包期间会排队，加载完成后应用 */
+	/**
+	 * Adds a new inventory item, will add it to an empty slot if possible. If the item supports count you can add more than one count. It will also update the level when adding if required
+	 * While an async inventory load is in flight the change is queued and applied once the load completes, this returns true
+	 * On clients the change is sent to the server and this returns true, see CanModifyInventory
+	 */
 	UFUNCTION(BlueprintCallable, Category = Inventory)
 	bool AddInventoryItem(URPGItem* NewItem, int32 ItemCount = 1, int32 ItemLevel = 1, bool bAutoSlot = true);
 
-	/** 移除背包中的一个物品，同时也会移除装备的道具 */
-	/** Remove an inventory item, will also remove from slots. A remove count of <= 0 means to remove all copies */
+	/** 移除背包中的一个物品，同时也会移除装备的道具。异步加载背包期间会排队 */
+	/** Remove an inventory item, will also remove from slots. A remove count of <= 0 means to remove all copies. Queued during an async load and sent to the server on clients like AddInventoryItem */
 	UFUNCTION(BlueprintCallable, Category = Inventory)
 	bool RemoveInventoryItem(URPGItem* RemovedItem, int32 RemoveCount = 1);
 
-	/** 从 InventoryData 中查找所有 ItemType 的 URPGItem 并放到 Items 中，如果 ItemType 无效则会返回全部 */
+	/** 从按类型分桶的索引中获得所有 ItemType 的 URPGItem 并放到 Items 中，如果 ItemType 无效则会返回全部 */
 	/** Returns all inventory items of a given type. If none is passed as type it will return all */
 	UFUNCTION(BlueprintCallable, Category = Inventory)
 	void GetInventoryItems(TArray<URPGItem*>& Items, FPrimaryAssetType ItemType);
 
-	/** 从 InventoryData 中查找 Item 的数量 */
+	/** 按类型过滤并按指定方式排序背包中的道具，使用增量维护的索引，代价和结果数量成正比 */
+	/** Returns inventory items of a given type in the requested order. If none is passed as type it will return all. Served from incrementally maintained indices */
+	UFUNCTION(BlueprintCallable, Category = Inventory)
+	void GetSortedInventoryItems(TArray<URPGItem*>& Items, FPrimaryAssetType ItemType, ERPGInventorySortOrder SortOrder);
+
+	/** 从 InventoryStore 中查找 Item 的数量 */
 	/** Returns number of instances of this item found in the inventory. This uses count from GetItemData */
 	UFUNCTION(BlueprintPure, Category = Inventory)
 	int32 GetInventoryItemCount(const URPGItem* Item) const;
@@ -94,8 +212,13 @@ public:
 	UFUNCTION(BlueprintPure, Category = Inventory)
 	bool GetInventoryItemData(const URPGItem* Item, FRPGItemData& ItemData) const;
 
-	/** 把 Item 放到 ItemSlot 中，会移除其他 ItemSlot 中的此 Item */
-	/** Sets slot to item, will remove from other slots if necessary. If passing null this will empty the slot */
+	/** 返回背包中的全部道具和数据，代替之前蓝图可读的 InventoryData 属性，每次调用都会复制 */
+	/** Returns every inventory item with its data. Blueprint replacement for the former InventoryData property, returns a copy */
+	UFUNCTION(BlueprintPure, Category = Inventory, meta = (DisplayName = "Get Inventory Data Map", ScriptName = "GetInventoryDataMap"))
+	TMap<URPGItem*, FRPGItemData> K2_GetInventoryDataMap() const;
+
+	/** 把 Item 放到 ItemSlot 中，会移除其他 ItemSlot 中的此 Item 。异步加载背包期间会排队 */
+	/** Sets slot to item, will remove from other slots if necessary. If passing null this will empty the slot. Queued during an async load and sent to the server on clients like AddInventoryItem */
 	UFUNCTION(BlueprintCallable, Category = Inventory)
 	bool SetSlottedItem(const FRPGItemSlot& ItemSlot, URPGItem* Item);
 
@@ -114,20 +237,79 @@ public:
 	UFUNCTION(BlueprintCallable, Category = Inventory)
 	void FillEmptySlots();
 
-	/** 更新存档，会写入硬盘 */
-	/** Manually save the inventory, this is called from add/remove functions automatically */
+	/** 更新存档，会写入硬盘。只会把上次保存后改变的道具和插槽写入存档，存档对象被替换时才会完整重建。异步加载背包期间不会保存 */
+	/**
+	 * Manually save the inventory, this is called from add/remove functions automatically. Only entries changed since the last save are patched into the save game
+	 * Does nothing and returns false while an async inventory load is in flight, the partial inventory would overwrite the saved one
+	 */
 	UFUNCTION(BlueprintCallable, Category = Inventory)
 	bool SaveInventory();
 
-	/** 从存档中加载背包 */
-	/** Loads inventory from save game on game instance, this will replace arrays */
+	/** 从存档中加载背包，服务器上的远程玩家的背包会被清空 */
+	/**
+	 * Loads inventory from save game on game instance, this will replace arrays. In async mode the arrays are filled later and OnInventoryLoaded fires when done
+	 * Remote players on a server get an empty inventory, see UsesLocalSaveGame
+	 */
 	UFUNCTION(BlueprintCallable, Category = Inventory)
 	bool LoadInventory();
 
+	/** 背包是否正在异步加载 */
+	/** Returns true while an async inventory load is in flight */
+	UFUNCTION(BlueprintPure, Category = Inventory)
+	bool IsInventoryLoading() const;
+
+	/**
+	 * 为 true 时 LoadInventory 会用一次 URPGAssetManager::LoadItemsAsync 异步加载存档中的全部道具，加载完成后才填充背包并通知 OnInventoryLoaded ，
+	 * 避免逐个同步加载道具导致的卡顿。加载期间对背包的修改会排队，在加载的背包上应用。
+	 */
+	/**
+	 * If true, LoadInventory streams every saved item with a single URPGAssetManager::LoadItemsAsync batch and fills the inventory when it completes,
+	 * instead of synchronously loading items one by one. Changes requested while the load is in flight are queued and applied on top of the loaded inventory
+	 */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = Inventory)
+	bool bLoadInventoryAsync = false;
+
+	/**
+	 * 网络游戏中背包由服务器负责，客户端的背包只会通过复制修改。
+	 * 返回这个控制器是否可以直接修改背包，客户端上返回 false ，这时修改背包的函数会把请求发给服务器并返回 true ，结果通过复制返回。
+	 */
+	/**
+	 * Returns true if this controller may modify the inventory. In a networked game only the server can, clients receive it through replication
+	 * On clients AddInventoryItem, RemoveInventoryItem, SetSlottedItem and FillEmptySlots send a request to the server and return true,
+	 * the change shows up once it replicates back. Blueprints reading the inventory right after the call on a client still see the old state
+	 */
+	UFUNCTION(BlueprintPure, Category = Inventory)
+	bool CanModifyInventory() const;
+
+	/** 客户端修改背包的请求，服务器检查之后用普通的函数应用 */
+	/** Client requests to modify the inventory, validated on the server and applied through the regular functions */
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerAddInventoryItem(const FPrimaryAssetId& ItemId, int32 ItemCount, int32 ItemLevel, bool bAutoSlot);
+
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerRemoveInventoryItem(const FPrimaryAssetId& ItemId, int32 RemoveCount);
+
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerSetSlottedItem(const FRPGItemSlot& ItemSlot, const FPrimaryAssetId& ItemId);
+
+	UFUNCTION(Server, Reliable)
+	void ServerFillEmptySlots();
+
+	/** 复制回调，只在客户端调用 */
+	/** Replication callbacks, called on clients from FRPGReplicatedInventory and FRPGReplicatedSlots */
+	void HandleReplicatedItemChanged(const FPrimaryAssetId& ItemId, const FRPGItemData& ItemData);
+	void HandleReplicatedItemRemoved(const FPrimaryAssetId& ItemId);
+	void HandleReplicatedSlotChanged(const FRPGItemSlot& ItemSlot, const FPrimaryAssetId& ItemId);
+
 	// Implement IRPGInventoryInterface
-	virtual const TMap<URPGItem*, FRPGItemData>& GetInventoryDataMap() const override
+	virtual const TMap<URPGItem*, FRPGItemData>& GetInventoryDataMap() const override;
+	virtual FRPGCompactInventory::FConstIterator CreateInventoryIterator() const override
+	{
+		return InventoryStore.CreateConstIterator();
+	}
+	virtual int32 GetInventoryItemNum() const override
 	{
-		return InventoryData;
+		return InventoryStore.Num();
 	}
 	virtual const TMap<FRPGItemSlot, URPGItem*>& GetSlottedItemMap() const override
 	{
@@ -145,6 +327,10 @@ public:
 	{
 		return OnInventoryLoadedNative;
 	}
+	virtual FOnInventoryChangeSetNative& GetInventoryChangeSetDelegate() override
+	{
+		return OnInventoryChangeSetNative;
+	}
 
 protected:
 	/** 自动装备一个道具，如果发生了改变则返回 true */
@@ -156,8 +342,177 @@ protected:
 	void NotifyInventoryItemChanged(bool bAdded, URPGItem* Item);
 	void NotifySlottedItemChanged(FRPGItemSlot ItemSlot, URPGItem* Item);
 	void NotifyInventoryLoaded() const;
+	void NotifyInventoryChangeSet(const FRPGInventoryChangeSet& ChangeSet);
+
+	/** 记录到帧末尾的改变中，第一次记录时绑定 FCoreDelegates::OnEndFrame */
+	/** Records into the end-of-frame change set, binding FCoreDelegates::OnEndFrame on first use */
+	void RecordDeferredItemChange(URPGItem* Item, bool bWasInInventory, bool bIsInInventory);
+	void RecordDeferredSlotChange(const FRPGItemSlot& ItemSlot);
+	void BindEndOfFrame();
+
+	/** 帧末尾调用 */
+	/** Called from FCoreDelegates::OnEndFrame */
+	void HandleEndOfFrame();
+
+	/** 修改 InventoryStore 和 SlottedItems 的唯一入口，会记录脏数据供 SaveInventory 增量更新存档 */
+	/** Storage writers, all changes to InventoryStore and SlottedItems go through these so the dirty sets stay accurate */
+	void SetInventoryItemData(URPGItem* Item, const FRPGItemData& ItemData);
+	void RemoveInventoryItemData(URPGItem* Item);
+	void SetSlottedItemData(const FRPGItemSlot& ItemSlot, URPGItem* Item);
+
+	/** 是否需要维护复制的背包，只有网络游戏中的服务器需要 */
+	/** Returns true if the replicated inventory has to be maintained, only servers of networked games need it */
+	bool ShouldReplicateInventory() const;
+
+	/**
+	 * 存档只属于本地玩家，服务器上的远程玩家不读写存档，背包从空开始，否则所有玩家会共用并互相覆盖同一个存档。
+	 */
+	/**
+	 * Returns true if this controller's inventory is persisted in the game instance's save game
+	 * The save game belongs to the local player, so remote players on a server start empty and never read or write it,
+	 * otherwise every player would share and overwrite the same slot. Clients never touch it either, the server owns their inventory
+	 */
+	bool UsesLocalSaveGame() const;
+
+	/** 客户端加载背包时使用已经复制过来的数据 */
+	/** Fills the local inventory from the replicated arrays, used by LoadInventory on clients */
+	void FillInventoryFromReplicatedData();
+
+	/** 检查插槽表、反向索引和类型索引是否和 InventoryStore / SlottedItems 一致，用于调试 */
+	/** Returns true if the slot table, its reverse index and the type index agree with InventoryStore and SlottedItems, for debugging */
+	bool ValidateInventoryIndices() const;
+
+	/** 标记下一次 SaveInventory 需要完整重建存档中的背包 */
+	/** Forces the next SaveInventory to rebuild the save game inventory from scratch */
+	void MarkInventoryFullyDirty();
+
+	/** 用存档中的数据填充背包，PreloadedItems 不为空时只使用其中的道具，不需要同步加载 */
+	/** Fills the inventory from the save game. If PreloadedItems is set the items are taken from it instead of being force loaded, ids missing from it are skipped */
+	void FillInventoryFromSaveGame(URPGGameInstanceBase* GameInstance, URPGSaveGame* SaveGame, const TArray<URPGItem*>* PreloadedItems);
+
+	/** 在异步加载期间记录一个修改 */
+	/** Queues a change requested while the async load is in flight */
+	void QueueInventoryChange(const FRPGQueuedInventoryChange& Change);
+
+	/** 应用异步加载期间排队的修改，在一个事务中完成，最多保存一次 */
+	/** Applies the changes queued during the async load inside one transaction, so they save at most once */
+	void ApplyQueuedInventoryChanges();
+
+	/** 异步加载存档中的道具完成后调用 */
+	/** Called when the async load started by LoadInventory completes */
+	void HandleInventoryItemsLoaded(const TArray<URPGItem*>& LoadedItems, int32 LoadSerial, TWeakObjectPtr<URPGSaveGame> SaveGame);
 
 	/** 加载存档后根据存档加载背包 */
 	/** Called when a global save game as been loaded */
 	void HandleSaveGameLoaded(URPGSaveGame* NewSaveGame);
+
+	/** InventoryStore 中道具按类型分桶的索引，带有按价格和名称的排序 */
+	/** Items of InventoryStore bucketed by type with price and name orders, kept in sync by the storage writers */
+	FRPGInventoryItemIndex InventoryIndex;
+
+	/** SlottedItems 的稠密表，按 (类型, 编号) 索引，带有空插槽位图 */
+	/** Dense copy of SlottedItems indexed by (type, slot number) with a free-slot bitmap, kept in sync by SetSlottedItemData */
+	FRPGItemSlotTable SlotTable;
+
+	/** 复制给拥有者的背包，按道具增量发送 */
+	/** Inventory replicated to the owning client, sent per changed entry */
+	UPROPERTY(Replicated)
+	FRPGReplicatedInventory ReplicatedInventory;
+
+	/** 复制给拥有者的装备插槽 */
+	/** Item slots replicated to the owning client */
+	UPROPERTY(Replicated)
+	FRPGReplicatedSlots ReplicatedSlots;
+
+	/** GetInventoryDataMap 按需构造的 TMap ，不会被 GC 遍历，道具由 FRPGItemCatalog 引用 */
+	/** Map built on demand by GetInventoryDataMap, not traced by GC since FRPGItemCatalog references the items */
+	mutable TMap<URPGItem*, FRPGItemData> InventoryDataView;
+
+	/** True if InventoryDataView has to be rebuilt */
+	mutable bool bInventoryDataViewStale = true;
+
+	/** 上次保存后改变过的道具，移除的道具也会保留在这里直到下次保存 */
+	/** Items whose entry changed since the last save, removed items stay here until the next save */
+	UPROPERTY(Transient)
+	TSet<URPGItem*> DirtyInventoryItems;
+
+	/** 上次保存后改变过的插槽 */
+	/** Slots whose item changed since the last save */
+	TSet<FRPGItemSlot> DirtySlots;
+
+	/** 为 true 时下一次保存会完整重建，比如刚刚加载了背包 */
+	/** If true the next save rebuilds the whole inventory, for instance right after a load */
+	bool bInventoryFullyDirty = true;
+
+	/** 上次写入的存档对象，如果 GameInstance 替换了存档就需要完整重建 */
+	/** Save game object that was last written to, a full rebuild is needed if the game instance replaced it */
+	TWeakObjectPtr<URPGSaveGame> LastSavedSaveGame;
+
+	/** 正在进行的异步加载，为空代表没有 */
+	/** Handle of the in-flight async inventory load, null if none */
+	TSharedPtr<FStreamableHandle> InventoryLoadHandle;
+
+	/** 每次加载递增，用来忽略被新的加载替代的旧回调 */
+	/** Incremented per load so callbacks from superseded loads are ignored */
+	int32 InventoryLoadSerial = 0;
+
+	/** 是否正在异步加载 */
+	/** True while an async inventory load is in flight */
+	bool bInventoryLoading = false;
+
+	/** 异步加载期间请求的修改 */
+	/** Changes requested while the async load was in flight, applied after the fill */
+	UPROPERTY(Transient)
+	TArray<FRPGQueuedInventoryChange> QueuedInventoryChanges;
+
+	/** 嵌套的事务层数，0 代表不在事务中 */
+	/** Depth of nested inventory transactions, 0 means none is open */
+	int32 InventoryTransactionDepth = 0;
+
+	/** 当前事务中记录的改变 */
+	/** Changes recorded by the open transaction */
+	UPROPERTY(Transient)
+	FRPGInventoryChangeRecorder PendingTransactionChanges;
+
+	/** 事务中是否请求过保存 */
+	/** True if a save was requested while a transaction was open */
+	bool bTransactionSaveRequested = false;
+
+	/** 这一帧中还没有通知的改变 */
+	/** Changes made this frame that have not been delivered yet */
+	UPROPERTY(Transient)
+	FRPGInventoryChangeRecorder DeferredChanges;
+
+	/** FCoreDelegates::OnEndFrame 的绑定，从第一次记录改变到 EndPlay 期间有效 */
+	/** Binding to FCoreDelegates::OnEndFrame, valid from the first recorded change until EndPlay */
+	FDelegateHandle EndOfFrameHandle;
+
+	friend struct FRPGPlayerControllerTestAccess;
+};
+
+/** 在作用域内开启一个背包事务，离开作用域时提交 */
+/** Opens an inventory transaction for the lifetime of this object and commits it on destruction */
+struct ACTIONRPG_API FRPGScopedInventoryTransaction
+{
+	explicit FRPGScopedInventoryTransaction(ARPGPlayerControllerBase* InController)
+		: Controller(InController)
+	{
+		if (Controller.IsValid())
+		{
+			Controller->BeginInventoryTransaction();
+		}
+	}
+
+	~FRPGScopedInventoryTransaction()
+	{
+		if (Controller.IsValid())
+		{
+			Controller->CommitInventoryTransaction();
+		}
+	}
+
+	UE_NONCOPYABLE(FRPGScopedInventoryTransaction);
+
+private:
+	TWeakObjectPtr<ARPGPlayerControllerBase> Controller;
 };
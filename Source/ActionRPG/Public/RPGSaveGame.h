@@ -21,6 +21,8 @@ namespace ERPGSaveGameVersion
 		AddedInventory,
 		// Added ItemData to store count/level
 		AddedItemData,
+		// Inventory and slots are stored as indices into a dictionary of item ids
+		AddedItemDictionary,
 
 		// -----<new versions must be added before this line>-------------------------------------------------
 		VersionPlusOne,
@@ -58,12 +60,41 @@ public:
 	UPROPERTY(VisibleAnywhere, BlueprintReadWrite, Category = SaveGame)
 	FString UserId;
 
+	/** 加载时从哪个版本升级，已经是最新版本时为 INDEX_NONE */
+	/** Version this save game was migrated from when it was loaded, INDEX_NONE if it already was the latest version */
+	int32 GetMigratedFromVersion() const
+	{
+		return MigratedFromVersion;
+	}
+
+	/** 加载时升级花费的时间 */
+	/** Time the migration took when this save game was loaded, in seconds */
+	double GetMigrationSeconds() const
+	{
+		return MigrationSeconds;
+	}
+
 protected:
+	/** 性能测试需要构造旧版本的存档 */
+	/** The save benchmark builds saves of older versions */
+	friend class URPGSaveBenchmarkCommandlet;
+
 	/** 这是一个示例，代表旧版本的游戏需要保存的数据，但现在已经不需要了 */
 	/** Deprecated way of storing items, this is read in but not saved out */
 	UPROPERTY()
 	TArray<FPrimaryAssetId> InventoryItems_DEPRECATED;
 
+	/**
+	 * 存档文件中的背包和 slot ，每个道具 Id 只在字典中保存一次，条目只保存字典的下标。
+	 * 只在 SaveGame 序列化期间有数据，读取后展开到 InventoryData 和 SlottedItems 中。
+	 */
+	/**
+	 * Inventory and slots as written to the save archive: every item id is stored once in a dictionary and entries only hold packed indices into it
+	 * Only filled during save game serialization, loading expands it back into InventoryData and SlottedItems
+	 */
+	UPROPERTY()
+	TArray<uint8> PackedInventory;
+
 	/** 上次保存的版本 */
 	/** What LatestVersion was when the archive was saved */
 	UPROPERTY()
@@ -72,4 +103,33 @@ protected:
 	/** 重写这个函数来解决旧版本保存的游戏数据 */
 	/** Overridden to allow version fix-ups */
 	virtual void Serialize(FArchive& Ar) override;
+
+	/**
+	 * 检测读取的数据的版本。 SavedDataVersion 和默认值相同时不会被写入，所以旧的存档按数据的格式判断。
+	 */
+	/**
+	 * Returns the version of the data just loaded. SavedDataVersion is skipped by delta serialization while it matches the class default
+	 * of the build that wrote it, so old saves are recognized by which fields hold data. PackedVersion is the version stored in the dictionary, if any
+	 */
+	int32 DetectLoadedVersion(int32 PackedVersion) const;
+
+	/**
+	 * 按顺序执行从 FromVersion 到 LatestVersion 的每一步升级，并记录花费的时间。
+	 * 升级后的存档由 URPGGameInstanceBase::ApplySaveGame 写回 slot ，之后的加载不再需要升级。
+	 */
+	/**
+	 * Runs the migration steps from FromVersion up to LatestVersion in order and records the time they took
+	 * URPGGameInstanceBase::ApplySaveGame writes the migrated save back to its slot, so later loads do not migrate again
+	 */
+	void Migrate(int32 FromVersion);
+
+	/** AddedInventory -> AddedItemData: the item list becomes item data entries of count 1 and level 1 */
+	static void MigrateInventoryList(URPGSaveGame& SaveGame);
+
+	/** 加载时升级前的版本，不保存 */
+	/** Version migrated from on load, not saved */
+	int32 MigratedFromVersion = INDEX_NONE;
+
+	/** Time spent in Migrate on load, not saved */
+	double MigrationSeconds = 0.0;
 };
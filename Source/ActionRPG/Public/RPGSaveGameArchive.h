@@ -0,0 +1,135 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "ActionRPG.h"
+
+class URPGSaveGame;
+
+/**
+ * 存档数据的不可变快照，只包含普通的结构体，不引用 UObject ，可以在工作线程上序列化。
+ * 在游戏线程上捕获快照的代价只是拷贝几个容器。
+ */
+/**
+ * Immutable copy of the data in a URPGSaveGame, plain structs only so it can be serialized on a worker thread
+ * Capturing one on the game thread costs a few container copies
+ */
+struct ACTIONRPG_API FRPGSaveGameSnapshot
+{
+	/** 在游戏线程上从存档捕获快照 */
+	/** Captures the data of a save game, game thread only */
+	static TSharedRef<const FRPGSaveGameSnapshot> Capture(const URPGSaveGame& SaveGame);
+
+	/** 把快照中的数据写入存档对象 */
+	/** Copies the snapshot into a save game object, game thread only */
+	void ApplyTo(URPGSaveGame& SaveGame) const;
+
+	/** 读写快照的数据，不包含文件头 */
+	/** Serializes the snapshot payload, without the archive header */
+	void Serialize(FArchive& Ar);
+
+	int32 SaveGameVersion = 0;
+	FString UserId;
+	TMap<FPrimaryAssetId, FRPGItemData> InventoryData;
+	TMap<FRPGItemSlot, FPrimaryAssetId> SlottedItems;
+};
+
+/** 存档文件中保存的数据的种类 */
+/** Kind of data held by a save archive */
+enum class ERPGSaveArchivePayload : uint8
+{
+	/** FRPGSaveGameSnapshot::Serialize 的输出 */
+	/** Output of FRPGSaveGameSnapshot::Serialize */
+	Snapshot,
+	/** UGameplayStatics::SaveGameToMemory 的输出 */
+	/** Tagged property data from UGameplayStatics::SaveGameToMemory */
+	SaveGame
+};
+
+/** 存档文件头 */
+/** Header in front of every save archive */
+struct FRPGSaveArchiveHeader
+{
+	uint32 FormatVersion = 0;
+	ERPGSaveCompression Compression = ERPGSaveCompression::None;
+	ERPGSaveArchivePayload Payload = ERPGSaveArchivePayload::Snapshot;
+	int32 UncompressedSize = 0;
+	int32 CompressedSize = 0;
+};
+
+/** 从 slot 读取并解码的存档数据，还没有创建存档对象，可以在工作线程上产生 */
+/** Save data read and decoded from a slot before any save game object exists, can be produced on a worker thread */
+struct FRPGSaveGameLoadResult
+{
+	/** 读取到了数据并且格式有效 */
+	/** True if data was read and decoded */
+	bool bValid = false;
+
+	ERPGSaveArchivePayload Payload = ERPGSaveArchivePayload::SaveGame;
+
+	/** Payload 为 SaveGame 时的 USaveGame 数据，需要在游戏线程上反序列化 */
+	/** Tagged property data for SaveGame payloads, which has to be deserialized on the game thread */
+	TArray<uint8> SaveGameData;
+
+	/** Payload 为 Snapshot 时已经读取的快照 */
+	/** Fully parsed snapshot for Snapshot payloads */
+	FRPGSaveGameSnapshot Snapshot;
+};
+
+/**
+ * 存档格式：文件头（标识、格式版本、压缩方式、数据种类、未压缩大小、压缩后大小）加上可选压缩的数据。
+ * 没有文件头的数据是旧的 USaveGame 格式，读取时同样支持。
+ * 使用文件头的存档需要通过 LoadFromSlot / LoadFromMemory 读取，蓝图的 Load Game From Slot 不能读取。
+ */
+/**
+ * Save archive format: a header (magic, format version, compression, payload kind, uncompressed and compressed size) followed by the optionally compressed payload
+ * Data without the header is a legacy USaveGame save and is read as well
+ * Archives with the header have to be read through LoadFromSlot or LoadFromMemory, blueprint Load Game From Slot cannot read them
+ */
+class ACTIONRPG_API FRPGSaveGameArchive
+{
+public:
+	/** 序列化并压缩快照，可以在任何线程上调用 */
+	/** Serializes and compresses a snapshot, safe on any thread */
+	static bool Write(const FRPGSaveGameSnapshot& Snapshot, ERPGSaveCompression Compression, TArray<uint8>& OutBytes);
+
+	/** 给 SaveGameToMemory 的输出加上文件头并压缩，可以在任何线程上调用 */
+	/** Wraps and compresses the output of SaveGameToMemory, safe on any thread */
+	static bool WriteSaveGameData(const TArray<uint8>& SaveGameData, ERPGSaveCompression Compression, TArray<uint8>& OutBytes);
+
+	/** 解压并读取快照，可以在任何线程上调用 */
+	/** Decompresses and reads a snapshot, safe on any thread. Returns false if the data is not a valid snapshot archive */
+	static bool Read(const TArray<uint8>& Bytes, FRPGSaveGameSnapshot& OutSnapshot);
+
+	/** 读取文件头并解压数据，可以在任何线程上调用 */
+	/** Reads the header and decompresses the payload, safe on any thread. Returns false for legacy or damaged data */
+	static bool Decode(const TArray<uint8>& Bytes, FRPGSaveArchiveHeader& OutHeader, TArray<uint8>& OutPayload);
+
+	/** Returns true if the data starts with the save archive header, false for legacy saves */
+	static bool IsSaveArchive(const TArray<uint8>& Bytes);
+
+	/** 解码内存中的存档，快照格式会直接读取成快照，可以在任何线程上调用 */
+	/** Decodes save data in either format, parsing snapshots right away. Safe on any thread */
+	static bool ReadFromMemory(const TArray<uint8>& Bytes, FRPGSaveGameLoadResult& OutResult);
+
+	/** 从 slot 中读取并解码存档，不存在时返回 false ，可以在任何线程上调用 */
+	/** Reads and decodes a slot, returns false if there is none. Safe on any thread */
+	static bool ReadFromSlot(const FString& SlotName, int32 UserIndex, FRPGSaveGameLoadResult& OutResult);
+
+	/** 用解码的数据创建存档对象 */
+	/** Creates the save game object from decoded data, returns null if the data is invalid. Game thread only */
+	static URPGSaveGame* CreateSaveGame(const FRPGSaveGameLoadResult& Result);
+
+	/** 从内存中读取存档，同时支持有文件头的格式和旧的 USaveGame 格式 */
+	/** Creates a save game from memory, reading both save archives and legacy USaveGame data. Game thread only */
+	static URPGSaveGame* LoadFromMemory(const TArray<uint8>& Bytes);
+
+	/** 从 slot 中同步读取存档，同时支持两种格式，不存在时返回 null */
+	/** Synchronously reads a save game from a slot in either format, returns null if there is none. Game thread only */
+	static URPGSaveGame* LoadFromSlot(const FString& SlotName, int32 UserIndex);
+
+private:
+	/** 压缩数据并在前面写入文件头 */
+	/** Compresses the payload and writes it behind the header */
+	static bool WriteArchive(const TArray<uint8>& Payload, ERPGSaveArchivePayload PayloadKind, ERPGSaveCompression Compression, TArray<uint8>& OutBytes);
+};
@@ -0,0 +1,155 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "ActionRPG.h"
+#include "Tasks/Task.h"
+
+class URPGSaveGame;
+
+/**
+ * 存档的追加日志，保存在存档 slot 旁边。背包的每个改变写成一条很小的二进制记录追加到日志中，
+ * 不需要每次都重写整个存档。完整的存档只会在压缩时写入，加载时先读存档再重放日志。
+ *
+ * 记录的值都是绝对值（设置 / 移除），重放多次和重放一次的结果相同，所以压缩期间的记录可以安全地保留。
+ */
+/**
+ * Append-only journal of inventory changes stored next to a save slot as <Slot>.journal
+ * Each change is a small binary record appended to the file instead of rewriting the whole save game. The full snapshot is only
+ * written when compacting, and loading replays the snapshot plus the journal
+ *
+ * Records hold absolute values (set/remove), so replaying one twice is harmless. Compaction renames the journal to
+ * <Slot>.journal.compacting before the snapshot is written and deletes it once the snapshot is on disk, new records go to a fresh journal
+ * Each record is framed as [uint32 size][uint32 crc][payload], a torn record at the end of the file is ignored on replay
+ *
+ * 文件操作在工作线程上按调用的顺序进行，游戏线程上的 Flush 只把记录交给工作线程。
+ * File operations run on a worker task in call order, Flush on the game thread only hands the records over
+ */
+class ACTIONRPG_API FRPGSaveJournal
+{
+public:
+	explicit FRPGSaveJournal(const FString& InSlotName);
+	~FRPGSaveJournal();
+
+	UE_NONCOPYABLE(FRPGSaveJournal);
+
+	/** Returns the slot this journal belongs to */
+	const FString& GetSlotName() const
+	{
+		return SlotName;
+	}
+
+	/** 记录一个道具的数据，ItemData 为空代表移除 */
+	/** Records the data of an item, a null ItemData records its removal */
+	void RecordItem(const FPrimaryAssetId& ItemId, const FRPGItemData* ItemData);
+
+	/** 记录一个插槽中的道具，无效的 ItemId 代表空插槽 */
+	/** Records the item in a slot, an invalid ItemId records an empty slot */
+	void RecordSlot(const FRPGItemSlot& ItemSlot, const FPrimaryAssetId& ItemId);
+
+	/** Returns true if records are waiting for Flush */
+	bool HasPendingRecords() const
+	{
+		return NumPendingRecords > 0;
+	}
+
+	/**
+	 * 把等待的记录交给工作线程追加到日志文件中。之前的追加失败时返回 false ，调用者应该写入完整存档。
+	 */
+	/**
+	 * Queues the pending records to be appended to the journal file on a worker
+	 * Returns false if an earlier append failed, the caller should then write a snapshot as those records never reached the disk
+	 */
+	bool Flush();
+
+	/** 返回最后一个文件操作的任务，需要排在日志写入之后的操作以它为前置 */
+	/** Returns the task of the last queued file operation, for work that has to follow the journal writes */
+	UE::Tasks::FTask GetWriteTask() const
+	{
+		return WriteTask;
+	}
+
+	/** 等待所有文件操作完成 */
+	/** Blocks until every queued file operation completed */
+	void WaitForWrites();
+
+	/** 丢弃等待的记录，在写入完整存档之前调用，存档已经包含了它们 */
+	/** Drops the pending records, called before a snapshot that already contains them */
+	void DiscardPending();
+
+	/** 日志文件中上次压缩之后的记录数 */
+	/** Number of records flushed since the last compaction started */
+	int32 GetNumRecords() const
+	{
+		return NumRecords;
+	}
+
+	/** 开始压缩，之后的记录写入新的日志 */
+	/** Starts a compaction before a snapshot is written, later records go to a fresh journal */
+	void BeginCompaction();
+
+	/** 完整存档写入之后调用，成功时删除被压缩的日志，失败时保留以便重放 */
+	/** Call when the snapshot write finished. On success the compacted journal is deleted, on failure it is kept for replay */
+	void EndCompaction(bool bSnapshotWritten);
+
+	/** 把日志重放到存档中，返回重放的记录数 */
+	/** Replays the compacting and current journals onto a save game, returns the number of records applied */
+	int32 Replay(URPGSaveGame* SaveGame);
+
+	/** Deletes both journal files */
+	void DeleteFiles();
+
+private:
+	/** 日志中的操作 */
+	/** Record operations */
+	enum class EOp : uint8
+	{
+		SetItem,
+		RemoveItem,
+		SetSlot,
+	};
+
+	/** 只在工作线程上访问的文件状态 */
+	/** File state only touched by the worker tasks */
+	struct FFileState
+	{
+		FString JournalPath;
+		FString CompactingPath;
+
+		/** 打开的日志文件，第一次追加时打开 */
+		/** Open journal file, opened on the first append */
+		TUniquePtr<FArchive> Writer;
+
+		/** Set by a failed append, read and cleared by the next Flush */
+		std::atomic<bool> bAppendFailed = false;
+
+		void Append(const TArray<uint8>& Bytes);
+		void BeginCompaction();
+		void CloseWriter();
+	};
+
+	/** 把一个文件操作排在之前的操作之后 */
+	/** Queues a file operation after the previous ones */
+	void EnqueueFileOperation(TUniqueFunction<void(FFileState&)> Operation);
+
+	/** Frames a serialized record into PendingBytes */
+	void AppendRecord(const TArray<uint8>& Payload);
+
+	/** Applies every valid record of one file, returns the number applied */
+	static int32 ReplayFile(const FString& Path, URPGSaveGame* SaveGame);
+
+	FString SlotName;
+	FString JournalPath;
+	FString CompactingPath;
+
+	TSharedRef<FFileState, ESPMode::ThreadSafe> FileState;
+
+	/** Last queued file operation, each one waits for the previous */
+	UE::Tasks::FTask WriteTask;
+
+	/** Framed records waiting for Flush */
+	TArray<uint8> PendingBytes;
+	int32 NumPendingRecords = 0;
+
+	int32 NumRecords = 0;
+};
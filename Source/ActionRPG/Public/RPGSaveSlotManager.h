@@ -0,0 +1,118 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "ActionRPG.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "Tasks/Task.h"
+#include "RPGSaveSlotManager.generated.h"
+
+class URPGGameInstanceBase;
+
+/**
+ * 多个存档 slot 的管理器，维护一个很小的索引文件，保存每个 slot 的时间、角色等级、道具数量、版本和大小。
+ * 列出所有的 slot 只需要读取索引文件，不需要反序列化每个存档。
+ * 索引只在 slot 成功写入之后在游戏线程上更新，索引文件按更新的顺序在工作线程上写入临时文件再替换，
+ * 所以索引中的信息不会比 slot 中的数据更新，崩溃时最多留下上一次的索引。
+ * 第一次读取索引时会和存档目录对照，所以索引之外写入或删除的 slot 也会出现在列表中。
+ */
+/**
+ * Manages multiple save slots through a small index file holding per-slot metadata: timestamp, character level, item count, version and byte size
+ * Listing the slots reads the index once instead of deserializing every save
+ * An entry is only updated on the game thread after its slot write succeeded, and index writes run on a worker in update order,
+ * writing a temporary file that replaces the index. The index therefore never describes data that is not on disk, and a crash leaves the previous index
+ * The index is reconciled with the save directory when first read, so slots written or deleted outside of it still show up correctly
+ */
+UCLASS()
+class ACTIONRPG_API URPGSaveSlotManager : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// USubsystem interface
+	virtual void Deinitialize() override;
+
+	/** 返回索引中的所有 slot ，按时间从新到旧排列 */
+	/** Returns every indexed slot, most recently written first */
+	UFUNCTION(BlueprintCallable, Category = Save)
+	TArray<FRPGSaveSlotInfo> GetSaveSlots();
+
+	/** 查找一个 slot 的信息 */
+	/** Finds the metadata of a slot, returns false if it is not indexed */
+	UFUNCTION(BlueprintCallable, Category = Save)
+	bool FindSaveSlot(const FString& SlotName, int32 UserIndex, FRPGSaveSlotInfo& OutInfo);
+
+	/**
+	 * 切换当前使用的 slot 。先写完旧 slot 等待的保存，然后异步加载新的 slot 。
+	 */
+	/** Makes a slot the active one. Pending saves of the old slot are written first, then the new slot is loaded asynchronously */
+	UFUNCTION(BlueprintCallable, Category = Save)
+	void SelectSaveSlot(const FString& SlotName, int32 UserIndex);
+
+	/** 删除一个 slot 和它的日志，并从索引中移除 */
+	/** Deletes a slot and its journal and removes it from the index. The active slot cannot be deleted */
+	UFUNCTION(BlueprintCallable, Category = Save)
+	bool DeleteSaveSlot(const FString& SlotName, int32 UserIndex);
+
+	/** URPGSaveSubsystem 在 slot 成功写入之后调用 */
+	/** Called by URPGSaveSubsystem on the game thread once a slot write succeeded */
+	void HandleSlotWritten(const FRPGSaveSlotInfo& Info);
+
+	/** 日志记录交给工作线程之后调用，更新索引中的道具数量，索引在 JournalWriteTask 之后写入 */
+	/**
+	 * Called by the game instance once journal records were queued, keeps the indexed item count current between snapshots
+	 * The index is written after JournalWriteTask so it never describes records that are not on disk yet
+	 */
+	void HandleJournalAppended(const FString& SlotName, int32 UserIndex, int32 ItemCount, const UE::Tasks::FTask& JournalWriteTask);
+
+	/** 等待正在进行的索引写入 */
+	/** Blocks until queued index writes are on disk */
+	void FlushIndex();
+
+protected:
+	/** 第一次使用时读取索引文件，并和存档目录对照，之后合并工作线程读取的结果 */
+	/** Reads the index file on first use and reconciles it with the save directory, later calls merge the worker reads ReconcileIndex queued */
+	void LoadIndex();
+
+	void ReadIndexFile();
+
+	/**
+	 * 移除已经不存在的 slot ，加入索引中没有的存档。没有索引的存档先只记录文件的时间和大小，
+	 * 道具数量和版本在工作线程上读取，角色等级未知，记为 0 。
+	 */
+	/**
+	 * Removes entries whose slot no longer exists and indexes .sav files the index does not know about. Returns true if the index changed
+	 * An unindexed slot is first recorded with its file time and size only, its item count and version are read once on a worker
+	 * and merged by a later LoadIndex. The character level is unknown and recorded as 0
+	 */
+	bool ReconcileIndex();
+
+	/** 合并 ReconcileIndex 在工作线程上读取的结果 */
+	/** Merges the results of the worker read queued by ReconcileIndex once it completed */
+	void MergeReconciledSlots();
+
+	/** 把当前的索引交给工作线程写入，排在之前的写入之后 */
+	/** Queues a write of the current index on a worker, ordered after previous index writes and the optional Prerequisite */
+	void WriteIndex(const UE::Tasks::FTask& Prerequisite = UE::Tasks::FTask());
+
+	FRPGSaveSlotInfo* FindEntry(const FString& SlotName, int32 UserIndex);
+
+	URPGGameInstanceBase* GetRPGGameInstance() const;
+
+	/** Returns the path of the index file */
+	static FString GetIndexPath();
+
+	/** Returns the directory holding the slots, the journals and the index */
+	static FString GetSaveGamesDir();
+
+	TArray<FRPGSaveSlotInfo> Entries;
+
+	bool bIndexLoaded = false;
+
+	/** Last queued index write, each write waits for the previous one */
+	UE::Tasks::FTask IndexWriteTask;
+
+	/** 在工作线程上读取没有索引的存档 */
+	/** Worker read of the slots ReconcileIndex found unindexed, returns their item count and version */
+	UE::Tasks::TTask<TArray<FRPGSaveSlotInfo>> ReconcileReadTask;
+};
@@ -0,0 +1,164 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "ActionRPG.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "Containers/Ticker.h"
+#include "Tasks/Task.h"
+#include "RPGSaveGameArchive.h"
+#include "RPGSaveSubsystem.generated.h"
+
+class URPGGameInstanceBase;
+
+/**
+ * 存档的调度器，替代 URPGGameInstanceBase 中只能排队一次的保存。
+ * 保存请求按优先级在时间窗口内合并成一次写入，存档点和切换关卡立即写入，退出和切换地图前保证写入完成。
+ */
+/**
+ * Save scheduler for URPGGameInstanceBase, replacing the one-deep save queue
+ * Requests are coalesced into a single write within a window that depends on their priority. Immediate requests write right away,
+ * and pending saves are flushed and waited for before map travel and on shutdown
+ * The save game is serialized on the game thread and written to the slot on a worker task, or with
+ * URPGGameInstanceBase::bSerializeSaveOffGameThread only a snapshot is captured on the game thread and everything else runs on the worker
+ * Also runs the asynchronous load of the save slot, reading and decoding on a worker and creating the save game on the game thread
+ */
+UCLASS(Config = Game)
+class ACTIONRPG_API URPGSaveSubsystem : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// USubsystem interface
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	/** 请求保存当前的存档，返回是否接受了请求 */
+	/** Requests a write of the current save game, returns false if saving is disabled */
+	UFUNCTION(BlueprintCallable, Category = Save)
+	bool RequestSave(ERPGSavePriority Priority = ERPGSavePriority::Normal);
+
+	/** 如果有等待的保存，立即开始写入 */
+	/** Starts the pending write now instead of waiting for its window */
+	UFUNCTION(BlueprintCallable, Category = Save)
+	void Flush();
+
+	/** 写入等待的保存并等待写入完成，用于退出和切换地图 */
+	/** Writes any pending save and blocks until it is on disk, used on shutdown and map travel */
+	void FlushBlocking();
+
+	/** Returns true if a save is waiting for its window */
+	UFUNCTION(BlueprintPure, Category = Save)
+	bool HasPendingSave() const;
+
+	/** Returns true while a write is in flight */
+	UFUNCTION(BlueprintPure, Category = Save)
+	bool IsWriting() const;
+
+	/**
+	 * 开始异步读取存档，在工作线程上读取和解码，完成后在游戏线程上调用 URPGGameInstanceBase::ApplySaveGame 。
+	 * 正在写入时读取会排在写入之后。
+	 */
+	/**
+	 * Starts reading the save slot on a worker, the save game is created and passed to URPGGameInstanceBase::ApplySaveGame on the game thread
+	 * A load started while a write is in flight runs after the write. Returns false if a load is already running
+	 */
+	bool StartLoad();
+
+	/** 最多等待 TimeoutSeconds 秒让读取完成，完成时立即应用，返回是否完成 */
+	/** Blocks up to TimeoutSeconds for the load and applies it right away if it finished. Returns false on timeout, the load keeps running */
+	bool WaitForLoad(float TimeoutSeconds);
+
+	/** 放弃正在进行的读取，读取的结果不会被应用 */
+	/** Drops the running load, its result will not be applied */
+	void CancelLoad();
+
+	/** Returns true while a load has not been applied */
+	UFUNCTION(BlueprintPure, Category = Save)
+	bool IsLoading() const;
+
+	/** 记录一次加载时的升级，由 URPGGameInstanceBase::ApplySaveGame 调用 */
+	/** Records the migration of a loaded save, called by URPGGameInstanceBase::ApplySaveGame */
+	void RecordMigration(double Seconds);
+
+	/** Returns the scheduler counters */
+	UFUNCTION(BlueprintPure, Category = Save)
+	FRPGSaveStats GetStats() const;
+
+	/** Normal 优先级的请求合并的时间窗口 */
+	/** Window over which Normal priority requests are coalesced, in seconds */
+	UPROPERTY(Config, EditAnywhere, Category = Save, meta = (ClampMin = 0))
+	float DebounceSeconds = 1.0f;
+
+	/** Background 优先级的请求最多等待的时间 */
+	/** Longest a Background priority request may wait, in seconds */
+	UPROPERTY(Config, EditAnywhere, Category = Save, meta = (ClampMin = 0))
+	float BackgroundDeferralSeconds = 10.0f;
+
+protected:
+	/** 每帧检查是否需要开始写入或写入是否完成 */
+	/** Starts due writes and completes finished ones */
+	bool Tick(float DeltaTime);
+
+	/** 在游戏线程上序列化存档或捕获快照，然后在工作线程上写入 */
+	/** Serializes the save game or captures its snapshot on the game thread, and writes it on a worker task */
+	void StartWrite();
+
+	/** Called on the game thread once the write task finished */
+	void FinishWrite();
+
+	/** 在游戏线程上用读取的数据创建存档 */
+	/** Creates the save game from the loaded data on the game thread and hands it to the game instance */
+	void FinishLoad();
+
+	/** 切换地图前保证写入 */
+	/** Flushes before a map is loaded */
+	void HandlePreLoadMap(const FString& MapName);
+
+	URPGGameInstanceBase* GetRPGGameInstance() const;
+
+	/** 有请求还没写入 */
+	/** True if a request is waiting to be written */
+	bool bSavePending = false;
+
+	/** 等待的保存最晚开始的时间 */
+	/** Time by which the pending save has to start */
+	double PendingDeadline = 0.0;
+
+	/** 等待的保存中第一个请求的时间，用于计算延迟 */
+	/** Time of the first request coalesced into the pending save, for latency */
+	double PendingSince = 0.0;
+
+	/** 正在进行的写入，返回写入的字节数，失败时返回 INDEX_NONE */
+	/** In-flight write, returns the number of bytes written or INDEX_NONE on failure */
+	UE::Tasks::TTask<int64> WriteTask;
+
+	/** True while WriteTask has not been completed on the game thread */
+	bool bWriting = false;
+
+	/** First request time and slot of the in-flight write */
+	double WriteRequestedAt = 0.0;
+	FString WriteSlotName;
+	int32 WriteUserIndex = 0;
+
+	/** 这次写入在存档索引中的信息 */
+	/** Slot index metadata of the in-flight write */
+	FRPGSaveSlotInfo WriteSlotInfo;
+
+	/** 正在进行的读取 */
+	/** In-flight load */
+	UE::Tasks::TTask<FRPGSaveGameLoadResult> LoadTask;
+
+	/** True while LoadTask has not been applied on the game thread */
+	bool bLoading = false;
+
+	/** Start time and slot of the in-flight load */
+	double LoadStartedAt = 0.0;
+	FString LoadSlotName;
+	int32 LoadUserIndex = 0;
+
+	FRPGSaveStats Stats;
+
+	FTSTicker::FDelegateHandle TickerHandle;
+	FDelegateHandle PreLoadMapHandle;
+};
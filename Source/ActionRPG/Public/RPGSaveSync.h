@@ -0,0 +1,90 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "ActionRPG.h"
+
+/** 上传的结果 */
+/** Outcome of an upload */
+enum class ERPGSaveSyncResult : uint8
+{
+	/** 服务器已经保存了这一批改变 */
+	/** The backend stored the batch */
+	Success,
+	/** 暂时失败，退避之后重试 */
+	/** Transient failure, the batch is retried after a backoff */
+	Retry,
+	/** 服务器的版本和 BaseRevision 不一致，需要上传完整的存档 */
+	/** The backend does not hold BaseRevision, the next batch has to carry the whole save */
+	NeedsFullUpload
+};
+
+/**
+ * 一批上传的改变。增量是 zlib 压缩的道具条目（Id 、是否移除、数量、等级）和插槽条目（类型、编号、Id ），
+ * 完整上传是 zlib 压缩的 FRPGSaveGameArchive 快照。
+ */
+/**
+ * One upload. Data is either a zlib compressed delta of item entries (id, removed, count, level) and slot entries (type, number, id),
+ * or the whole save as a zlib FRPGSaveGameArchive snapshot
+ */
+struct FRPGSaveSyncBatch
+{
+	FString UserId;
+	FString SlotName;
+
+	/** True if the batch carries the whole save */
+	bool bFull = false;
+
+	/** 增量基于的版本，完整上传时忽略 */
+	/** Revision the delta applies on top of, ignored for full uploads */
+	int64 BaseRevision = 0;
+
+	/** Revision of the backend once this batch is applied */
+	int64 Revision = 0;
+
+	/** Number of coalesced changes in a delta */
+	int32 NumChanges = 0;
+
+	/** 增量压缩前的大小，完整上传的大小在 FRPGSaveGameArchive 的文件头中 */
+	/** Size of a delta before compression, a full upload carries its sizes in the FRPGSaveGameArchive header */
+	int32 UncompressedSize = 0;
+
+	TArray<uint8> Data;
+};
+
+/**
+ * 远程存档的后端接口，由 URPGGameInstanceBase::SetSaveSyncBackend 设置。
+ * 同一时间只会有一个上传，OnComplete 必须在游戏线程上调用。
+ */
+/**
+ * Pluggable remote save backend, installed with URPGGameInstanceBase::SetSaveSyncBackend
+ * At most one upload is in flight at a time, and OnComplete must be called on the game thread
+ */
+class ACTIONRPG_API IRPGSaveSyncBackend
+{
+public:
+	virtual ~IRPGSaveSyncBackend() {}
+
+	virtual void Upload(const FRPGSaveSyncBatch& Batch, TFunction<void(ERPGSaveSyncResult)> OnComplete) = 0;
+};
+
+/**
+ * 通过 HTTP 上传的后端，POST 到 <BaseUrl>/saves/<UserId>/<SlotName> 。
+ * 200 代表成功，409 代表需要完整上传，其他的都会重试。本地测试使用 RPGSaveSyncServer commandlet 作为服务器。
+ */
+/**
+ * HTTP backend, POSTs every batch to <BaseUrl>/saves/<UserId>/<SlotName> with the batch description in X-RPG-Sync-* headers
+ * 200 is success, 409 asks for a full upload and anything else is retried. The RPGSaveSyncServer commandlet is a loopback stand-in for local testing
+ */
+class ACTIONRPG_API FRPGHttpSaveSyncBackend : public IRPGSaveSyncBackend
+{
+public:
+	explicit FRPGHttpSaveSyncBackend(const FString& InBaseUrl, float InTimeoutSeconds = 30.0f);
+
+	// IRPGSaveSyncBackend interface
+	virtual void Upload(const FRPGSaveSyncBatch& Batch, TFunction<void(ERPGSaveSyncResult)> OnComplete) override;
+
+private:
+	FString BaseUrl;
+	float TimeoutSeconds;
+};
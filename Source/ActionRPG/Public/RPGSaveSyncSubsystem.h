@@ -0,0 +1,157 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "ActionRPG.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "Containers/Ticker.h"
+#include "Tasks/Task.h"
+#include "RPGSaveSync.h"
+#include "RPGSaveSyncSubsystem.generated.h"
+
+class URPGGameInstanceBase;
+
+/**
+ * 把存档同步到远程后端。背包的改变在游戏线程上只是记录到两个 map 中，同一个道具 / 插槽的改变会合并，
+ * 每隔 SyncIntervalSeconds 秒或改变数超过 MaxPendingChanges 时，在工作线程上序列化和压缩成一批增量上传。
+ * 同一时间只有一个上传，失败时按指数退避重试，后端没有增量的基础版本时上传完整的存档。
+ */
+/**
+ * Syncs the save game to a remote IRPGSaveSyncBackend in the background
+ * Inventory changes are only recorded into two maps on the game thread, coalescing repeated changes to the same item or slot
+ * Every SyncIntervalSeconds, or once MaxPendingChanges are waiting, the maps are moved to a worker task that serializes and
+ * zlib compresses them into one delta batch, so game thread cost and traffic stay flat no matter how many small changes happen
+ * One batch is in flight at a time. Failed uploads are retried with exponential backoff, and a backend that lost the base
+ * revision of a delta gets the whole save instead. Changes still pending on shutdown are not uploaded, the full upload of the next session resyncs them
+ */
+UCLASS(Config = Game)
+class ACTIONRPG_API URPGSaveSyncSubsystem : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// USubsystem interface
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	/** 设置后端，为空时停止同步并丢弃等待的改变 */
+	/** Installs the backend, a null backend stops syncing and drops pending changes. A new backend starts with a full upload */
+	void SetBackend(TSharedPtr<IRPGSaveSyncBackend> InBackend);
+
+	/** Returns true if a backend is installed */
+	bool IsEnabled() const
+	{
+		return Backend.IsValid();
+	}
+
+	/** 记录一个道具的改变，ItemData 为空代表移除 */
+	/** Records an item change for the next delta, a null ItemData records a removal */
+	void RecordItem(const FPrimaryAssetId& ItemId, const FRPGItemData* ItemData);
+
+	/** 记录一个插槽的改变，无效的 ItemId 代表空插槽 */
+	/** Records a slot change for the next delta, an invalid ItemId records an empty slot */
+	void RecordSlot(const FRPGItemSlot& ItemSlot, const FPrimaryAssetId& ItemId);
+
+	/** 下一批上传完整的存档，用于存档被加载或整体替换之后 */
+	/** Makes the next batch carry the whole save game, used after it was loaded or rebuilt */
+	void RequestFullUpload();
+
+	/** 不等待同步间隔，立即上传等待的改变，重试的退避仍然有效 */
+	/** Uploads pending changes without waiting for the sync interval, a retry backoff still applies */
+	UFUNCTION(BlueprintCallable, Category = Save)
+	void Flush();
+
+	/** Returns true if changes are waiting or a batch is being built or uploaded */
+	UFUNCTION(BlueprintPure, Category = Save)
+	bool IsSyncPending() const;
+
+	/** Returns the sync counters */
+	UFUNCTION(BlueprintPure, Category = Save)
+	FRPGSaveSyncStats GetStats() const;
+
+	/** 两次上传之间的最短时间 */
+	/** Time changes are coalesced before they are uploaded, in seconds */
+	UPROPERTY(Config, EditAnywhere, Category = Save, meta = (ClampMin = 0))
+	float SyncIntervalSeconds = 30.0f;
+
+	/** 等待的改变超过这个数时不等待同步间隔 */
+	/** Number of pending changes that starts an upload before the interval is over */
+	UPROPERTY(Config, EditAnywhere, Category = Save, meta = (ClampMin = 1))
+	int32 MaxPendingChanges = 512;
+
+	/** 第一次重试之前等待的时间，之后每次加倍 */
+	/** Delay before the first retry, doubled on every further failure */
+	UPROPERTY(Config, EditAnywhere, Category = Save, meta = (ClampMin = 0))
+	float InitialRetrySeconds = 2.0f;
+
+	/** Upper bound of the retry delay, in seconds */
+	UPROPERTY(Config, EditAnywhere, Category = Save, meta = (ClampMin = 0))
+	float MaxRetrySeconds = 300.0f;
+
+protected:
+	/** 开始构建到期的批次，发送构建完成的批次 */
+	/** Starts due batches and sends the ones that finished building */
+	bool Tick(float DeltaTime);
+
+	/** 把等待的改变或存档的快照交给工作线程序列化和压缩 */
+	/** Moves the pending changes, or a snapshot of the save game, to a worker task that serializes and compresses them */
+	void StartBatch();
+
+	/** Hands the built batch to the backend */
+	void SendBatch();
+
+	/** Called on the game thread when the backend finished an upload */
+	void HandleUploadComplete(uint32 UploadSerial, ERPGSaveSyncResult Result);
+
+	/** Returns the number of pending changes */
+	int32 GetNumPendingChanges() const
+	{
+		return PendingItems.Num() + PendingSlots.Num();
+	}
+
+	URPGGameInstanceBase* GetRPGGameInstance() const;
+
+	TSharedPtr<IRPGSaveSyncBackend> Backend;
+
+	/** 合并后等待上传的改变，没有值代表移除 */
+	/** Coalesced changes waiting for the next delta, an unset value is a removal */
+	TMap<FPrimaryAssetId, TOptional<FRPGItemData>> PendingItems;
+	TMap<FRPGItemSlot, FPrimaryAssetId> PendingSlots;
+
+	/** 第一个等待的改变的时间 */
+	/** Time of the first pending change */
+	double PendingSince = 0.0;
+
+	/** Set by RequestFullUpload, the next batch carries the whole save */
+	bool bFullUploadPending = false;
+
+	/** Set by Flush, the next batch does not wait for the interval */
+	bool bFlushRequested = false;
+
+	/** 正在构建的批次 */
+	/** Batch being serialized and compressed on a worker */
+	UE::Tasks::TTask<FRPGSaveSyncBatch> BuildTask;
+	bool bBuilding = false;
+
+	/** 正在上传或等待重试的批次，重试时原样重新发送 */
+	/** Batch being uploaded or waiting for its retry, a retry resends it unchanged */
+	FRPGSaveSyncBatch InFlightBatch;
+	bool bBatchInFlight = false;
+	bool bUploading = false;
+
+	/** 后端确认的版本，只在这次运行中有效，每次运行从完整上传开始 */
+	/** Last revision the backend acknowledged. Revisions are per session, every session starts with a full upload */
+	int64 AckedRevision = 0;
+
+	/** Identifies the current upload, completions of older uploads are ignored */
+	uint32 UploadSerial = 0;
+
+	/** 下一次上传最早的时间和当前的重试间隔 */
+	/** Earliest time of the next upload and the current retry delay */
+	double NextAttemptTime = 0.0;
+	float RetryDelay = 0.0f;
+
+	FRPGSaveSyncStats Stats;
+
+	FTSTicker::FDelegateHandle TickerHandle;
+};
@@ -0,0 +1,100 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "ActionRPG.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+
+/** 启动过程中被计时的阶段 */
+/** Startup phases timed by FRPGStartupProfiler */
+enum class ERPGStartupPhase : uint8
+{
+	/** 从进程启动到 ActionRPG 模块的 StartupModule 结束 */
+	/** From process start until the ActionRPG module finished StartupModule */
+	ModuleLoad,
+	/** 加载界面模块的 StartupModule ，这个模块在 PreLoadingScreen 阶段加载，服务器上不加载 */
+	/** StartupModule of the loading screen module, loaded at PreLoadingScreen and not on servers */
+	LoadingScreenModule,
+	/** URPGAssetManager::StartInitialLoading 中的 primary asset 扫描 */
+	/** Primary asset scan in URPGAssetManager::StartInitialLoading */
+	AssetManagerScan,
+	/** UAbilitySystemGlobals::InitGlobalData ，包含下面三个阶段 */
+	/** UAbilitySystemGlobals::InitGlobalData, contains the three phases below */
+	GlobalData,
+	GlobalTags,
+	AttributeDefaults,
+	GameplayCueManager,
+	/** 从开始读取存档到 ApplySaveGame */
+	/** From the start of the save game read until ApplySaveGame */
+	SaveLoad,
+	/** 从第一个世界的 StartPlay 到这一帧结束 */
+	/** From StartPlay of the first world until the end of that frame */
+	FirstPlayableFrame,
+
+	Num
+};
+
+/**
+ * 记录启动阶段的时间，用于查看和控制冷启动的时间（包括无界面的服务器）。
+ * 每个阶段只记录第一次，开始和结束时输出 trace bookmark ，同步的阶段还输出 cpu trace scope 。
+ * 第一个可以游戏的帧结束时输出一行汇总的日志。
+ */
+/**
+ * Records the wall time of the startup phases so cold start can be budgeted, including on headless servers
+ * Only the first occurrence of a phase is recorded. Its begin and end are emitted as trace bookmarks, synchronous
+ * phases timed with RPG_STARTUP_PHASE_SCOPE are also emitted as cpu trace scopes
+ * A single summary line is logged at the end of the first playable frame, phases that end later are logged on their own
+ * Game thread only
+ */
+class ACTIONRPG_API FRPGStartupProfiler
+{
+public:
+	/** 开始一个阶段，已经开始的阶段会被忽略 */
+	/** Begins a phase now. Ignored if the phase already began */
+	static void BeginPhase(ERPGStartupPhase Phase);
+
+	/** 结束一个阶段，没有开始或已经结束的阶段会被忽略 */
+	/** Ends a phase now. Ignored if the phase did not begin or already ended */
+	static void EndPhase(ERPGStartupPhase Phase);
+
+	/** 记录在别处计时的阶段，时间是 FPlatformTime::Seconds() 的值。trace 不能补写过去的时间，所以不输出 bookmark */
+	/** Records a phase timed elsewhere, in FPlatformTime::Seconds(). No bookmarks are emitted as a trace cannot be amended back in time */
+	static void RecordPhase(ERPGStartupPhase Phase, double StartTime, double EndTime);
+
+	/** Returns the duration of a finished phase in seconds, a negative value if it did not finish */
+	static double GetPhaseSeconds(ERPGStartupPhase Phase);
+
+	/** 第一个世界开始游戏时调用，这一帧结束时输出汇总 */
+	/** Called when the first world starts play, the summary is logged at the end of that frame. Ignored in the editor */
+	static void NotifyStartPlay();
+
+	/** Logs the recorded phases */
+	static void LogSummary();
+
+	static const TCHAR* GetPhaseName(ERPGStartupPhase Phase);
+};
+
+/** 在作用域内计时一个阶段 */
+/** Times a phase for the lifetime of the scope */
+struct FRPGStartupPhaseScope
+{
+	explicit FRPGStartupPhaseScope(ERPGStartupPhase InPhase)
+		: Phase(InPhase)
+	{
+		FRPGStartupProfiler::BeginPhase(Phase);
+	}
+
+	~FRPGStartupPhaseScope()
+	{
+		FRPGStartupProfiler::EndPhase(Phase);
+	}
+
+private:
+	ERPGStartupPhase Phase;
+};
+
+/** 计时一个同步的阶段并输出 cpu trace scope */
+/** Times a synchronous phase and emits it as a cpu trace scope named RPGStartup_<Phase> */
+#define RPG_STARTUP_PHASE_SCOPE(PhaseName) \
+	TRACE_CPUPROFILER_EVENT_SCOPE(RPGStartup_##PhaseName); \
+	FRPGStartupPhaseScope ANONYMOUS_VARIABLE(RPGStartupPhaseScope_)(ERPGStartupPhase::PhaseName)
@@ -20,6 +20,250 @@
 class URPGItem;
 class URPGSaveGame;
 
+/** 背包查询结果的排序方式 */
+/** Sort orders supported by inventory queries, maintained incrementally by the controller */
+UENUM(BlueprintType)
+enum class ERPGInventorySortOrder : uint8
+{
+	/** 道具加入背包的顺序，移除道具时最后加入的道具补到它的位置 */
+	/** Order items entered the inventory, removing an item moves the last one into its place */
+	None,
+	/** 价格从低到高 */
+	/** Ascending price */
+	Price,
+	/** 按用户可见的名称 */
+	/** User-visible item name */
+	Name
+};
+
+/** 保存请求的优先级，决定保存调度器等待多久再写入 */
+/** Priority of a save request, decides how long the save scheduler may coalesce it before writing */
+UENUM(BlueprintType)
+enum class ERPGSavePriority : uint8
+{
+	/** 可以等待较长时间，和其他改变一起写入 */
+	/** May wait up to the background deferral window and batch with other changes */
+	Background,
+	/** 在去抖动的时间窗口内合并，比如拾取道具 */
+	/** Coalesced over the debounce window, for instance pickups */
+	Normal,
+	/** 立即写入，比如存档点和切换关卡 */
+	/** Written right away, for checkpoints and level transitions */
+	Immediate
+};
+
+/** 存档的压缩方式 */
+/** Compression applied to save archives */
+UENUM(BlueprintType)
+enum class ERPGSaveCompression : uint8
+{
+	/** 不压缩 */
+	/** Stored as is */
+	None,
+	/** zlib ，所有平台都可以使用 */
+	/** zlib, available everywhere */
+	Zlib,
+	/** Oodle ，压缩率和解压速度都更好，不可用时退回 zlib */
+	/** Oodle, better ratio and decode speed, falls back to zlib if the format is unavailable */
+	Oodle
+};
+
+/** 游戏的阶段，决定道具的哪些 Bundle 保持加载 */
+/** Phase of the game, decides which asset bundles of the loaded items are resident */
+UENUM(BlueprintType)
+enum class ERPGGamePhase : uint8
+{
+	/** 主菜单，只需要菜单的贴图 */
+	/** Main menu, only menu textures are needed */
+	MainMenu,
+	/** 战斗中，只需要游戏中的声音 */
+	/** In game, only in-game sounds are needed */
+	Gameplay,
+	/** 游戏中打开了背包，两者都需要 */
+	/** Inventory open during gameplay, both are needed */
+	InventoryOpen
+};
+
+/** 一个游戏阶段中道具 Bundle 占用的内存 */
+/** Memory held by the item bundles while a game phase was active */
+USTRUCT(BlueprintType)
+struct ACTIONRPG_API FRPGPhaseMemoryReport
+{
+	GENERATED_BODY()
+
+	/** Loaded item assets */
+	UPROPERTY(BlueprintReadOnly, Category = Item)
+	int32 NumItems = 0;
+
+	/** Resident assets of the Menu bundle, the inventory textures */
+	UPROPERTY(BlueprintReadOnly, Category = Item)
+	int32 NumMenuAssets = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = Item)
+	int64 MenuBytes = 0;
+
+	/** Resident assets of the Game bundle, the pickup sounds */
+	UPROPERTY(BlueprintReadOnly, Category = Item)
+	int32 NumGameAssets = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = Item)
+	int64 GameBytes = 0;
+};
+
+/** 道具常驻内存的统计数据 */
+/** Counters of the item residency manager in URPGAssetManager */
+USTRUCT(BlueprintType)
+struct ACTIONRPG_API FRPGItemResidencyStats
+{
+	GENERATED_BODY()
+
+	/** 资产管理器保持加载的道具 */
+	/** Items the asset manager keeps loaded */
+	UPROPERTY(BlueprintReadOnly, Category = Item)
+	int32 ResidentItems = 0;
+
+	/** 这些道具和它们已加载的 Bundle 资产的估计大小，共享的资产只计算一次 */
+	/** Estimated size of these items and their loaded bundle assets, assets shared by several items are counted once */
+	UPROPERTY(BlueprintReadOnly, Category = Item)
+	int64 ResidentBytes = 0;
+
+	/** 在背包、插槽或道具目录中，不能被换出的道具 */
+	/** Resident items held by an inventory, slot or the item catalog, which are never evicted */
+	UPROPERTY(BlueprintReadOnly, Category = Item)
+	int32 ProtectedItems = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = Item)
+	int32 Evictions = 0;
+
+	/** 换出之后在垃圾回收中真正离开内存的大小，仍然被其他代码引用的资产不计算 */
+	/** Bytes of evicted assets that left memory in the following garbage collection, assets other code still references are not counted */
+	UPROPERTY(BlueprintReadOnly, Category = Item)
+	int64 EvictedBytes = 0;
+};
+
+/** 保存调度器的统计数据 */
+/** Counters reported by the save scheduler */
+USTRUCT(BlueprintType)
+struct ACTIONRPG_API FRPGSaveStats
+{
+	GENERATED_BODY()
+
+	/** Number of save requests, including the ones coalesced into another write */
+	UPROPERTY(BlueprintReadOnly, Category = Save)
+	int32 SavesRequested = 0;
+
+	/** Number of writes that reached the disk */
+	UPROPERTY(BlueprintReadOnly, Category = Save)
+	int32 SavesWritten = 0;
+
+	/** Number of writes that failed */
+	UPROPERTY(BlueprintReadOnly, Category = Save)
+	int32 SavesFailed = 0;
+
+	/** Total bytes of save data written */
+	UPROPERTY(BlueprintReadOnly, Category = Save)
+	int64 BytesWritten = 0;
+
+	/** 从第一个被合并的请求到写入完成的时间 */
+	/** Time from the first coalesced request to the end of the write, for the last write */
+	UPROPERTY(BlueprintReadOnly, Category = Save)
+	float LastLatencyMs = 0.0f;
+
+	/** Average latency over every write */
+	UPROPERTY(BlueprintReadOnly, Category = Save)
+	float AverageLatencyMs = 0.0f;
+
+	/** Largest latency of any write */
+	UPROPERTY(BlueprintReadOnly, Category = Save)
+	float MaxLatencyMs = 0.0f;
+
+	/** 上一次写入在游戏线程上花费的时间，序列化或捕获快照 */
+	/** Game thread time spent preparing the last write, serializing the save game or capturing its snapshot */
+	UPROPERTY(BlueprintReadOnly, Category = Save)
+	float LastGameThreadMs = 0.0f;
+
+	/** Largest game thread time of any write */
+	UPROPERTY(BlueprintReadOnly, Category = Save)
+	float MaxGameThreadMs = 0.0f;
+
+	/** 加载时从旧版本升级的存档数 */
+	/** Number of loaded saves that had to be migrated from an older version */
+	UPROPERTY(BlueprintReadOnly, Category = Save)
+	int32 SavesMigrated = 0;
+
+	/** Time the last migration took */
+	UPROPERTY(BlueprintReadOnly, Category = Save)
+	float LastMigrationMs = 0.0f;
+};
+
+/** 远程存档同步的统计数据 */
+/** Counters reported by the remote save sync */
+USTRUCT(BlueprintType)
+struct ACTIONRPG_API FRPGSaveSyncStats
+{
+	GENERATED_BODY()
+
+	/** 记录的改变数，包括被之后的改变覆盖的 */
+	/** Changes recorded, including the ones later overwritten by newer changes */
+	UPROPERTY(BlueprintReadOnly, Category = Save)
+	int32 ChangesRecorded = 0;
+
+	/** 合并之后实际上传的改变数 */
+	/** Changes actually uploaded after coalescing */
+	UPROPERTY(BlueprintReadOnly, Category = Save)
+	int32 ChangesUploaded = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = Save)
+	int32 BatchesUploaded = 0;
+
+	/** Batches that carried the whole save instead of a delta */
+	UPROPERTY(BlueprintReadOnly, Category = Save)
+	int32 FullUploads = 0;
+
+	/** Failed attempts that were scheduled for a retry */
+	UPROPERTY(BlueprintReadOnly, Category = Save)
+	int32 Retries = 0;
+
+	/** Compressed bytes sent */
+	UPROPERTY(BlueprintReadOnly, Category = Save)
+	int64 BytesUploaded = 0;
+};
+
+/** 存档索引中一个 slot 的信息，不需要读取存档就可以显示在存档选择界面中 */
+/** Metadata of one save slot kept in the save slot index, enough for a save select screen without reading the save */
+USTRUCT(BlueprintType)
+struct ACTIONRPG_API FRPGSaveSlotInfo
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = Save)
+	FString SlotName;
+
+	UPROPERTY(BlueprintReadOnly, Category = Save)
+	int32 UserIndex = 0;
+
+	/** 最后一次成功写入的时间（UTC） */
+	/** UTC time of the last successful write */
+	UPROPERTY(BlueprintReadOnly, Category = Save)
+	FDateTime Timestamp;
+
+	UPROPERTY(BlueprintReadOnly, Category = Save)
+	int32 CharacterLevel = 0;
+
+	/** 背包中道具的种类数 */
+	/** Number of distinct items in the inventory */
+	UPROPERTY(BlueprintReadOnly, Category = Save)
+	int32 ItemCount = 0;
+
+	/** ERPGSaveGameVersion of the written save */
+	UPROPERTY(BlueprintReadOnly, Category = Save)
+	int32 SaveVersion = 0;
+
+	/** Size of the slot on disk */
+	UPROPERTY(BlueprintReadOnly, Category = Save)
+	int64 ByteSize = 0;
+};
+
 /** 道具的 slot ，显示在 UI 中 */
 /** Struct representing a slot for an item, shown in the UI */
 USTRUCT(BlueprintType)
@@ -144,6 +388,140 @@ struct ACTIONRPG_API FRPGItemData
 	}
 };
 
+/** 一组背包改变的汇总，用于在事务结束时一次性通知，而不是每次改变都通知 */
+/** Aggregated set of inventory changes, broadcast once for a batch instead of once per change */
+USTRUCT(BlueprintType)
+struct ACTIONRPG_API FRPGInventoryChangeSet
+{
+	GENERATED_BODY()
+
+	/** 之前不在背包中的道具 */
+	/** Items that were not in the inventory before this change set */
+	UPROPERTY(BlueprintReadOnly, Category = Inventory)
+	TArray<URPGItem*> AddedItems;
+
+	/** 已经不在背包中的道具 */
+	/** Items that are no longer in the inventory */
+	UPROPERTY(BlueprintReadOnly, Category = Inventory)
+	TArray<URPGItem*> RemovedItems;
+
+	/** 仍在背包中，但数量或等级改变的道具 */
+	/** Items that stayed in the inventory but changed count or level */
+	UPROPERTY(BlueprintReadOnly, Category = Inventory)
+	TArray<URPGItem*> ChangedItems;
+
+	/** 内容改变的插槽 */
+	/** Slots whose item changed */
+	UPROPERTY(BlueprintReadOnly, Category = Inventory)
+	TArray<FRPGItemSlot> ChangedSlots;
+
+	/** Returns true if nothing changed */
+	bool IsEmpty() const
+	{
+		return AddedItems.Num() == 0 && RemovedItems.Num() == 0 && ChangedItems.Num() == 0 && ChangedSlots.Num() == 0;
+	}
+
+	/** Clears all recorded changes */
+	void Reset()
+	{
+		AddedItems.Reset();
+		RemovedItems.Reset();
+		ChangedItems.Reset();
+		ChangedSlots.Reset();
+	}
+};
+
+/**
+ * 记录背包改变的集合，每次改变是 O(1) 的，通知时一次性转换成 FRPGInventoryChangeSet 。
+ * 事务和帧末尾的通知用它来记录大量的改变。
+ */
+/**
+ * Accumulates inventory changes in sets so recording a change is O(1), and flattens them into a FRPGInventoryChangeSet once when it is broadcast
+ * Used by transactions and end of frame notifications, which may record many changes
+ */
+USTRUCT()
+struct ACTIONRPG_API FRPGInventoryChangeRecorder
+{
+	GENERATED_BODY()
+
+	/** 记录一个道具的改变，会和之前的改变合并，比如先添加再移除就相当于没有改变 */
+	/** Records an item change, merging with earlier changes so an add followed by a remove cancels out */
+	void AddItemChange(URPGItem* Item, bool bWasInInventory, bool bIsInInventory)
+	{
+		if (bIsInInventory)
+		{
+			if (RemovedItems.Remove(Item) > 0)
+			{
+				ChangedItems.Add(Item);
+			}
+			else if (!AddedItems.Contains(Item))
+			{
+				if (bWasInInventory)
+				{
+					ChangedItems.Add(Item);
+				}
+				else
+				{
+					AddedItems.Add(Item);
+				}
+			}
+		}
+		else if (AddedItems.Remove(Item) == 0)
+		{
+			ChangedItems.Remove(Item);
+			RemovedItems.Add(Item);
+		}
+	}
+
+	/** 记录一个插槽的改变 */
+	/** Records a slot change */
+	void AddSlotChange(const FRPGItemSlot& ItemSlot)
+	{
+		ChangedSlots.Add(ItemSlot);
+	}
+
+	/** Returns true if nothing changed */
+	bool IsEmpty() const
+	{
+		return AddedItems.Num() == 0 && RemovedItems.Num() == 0 && ChangedItems.Num() == 0 && ChangedSlots.Num() == 0;
+	}
+
+	/** 转换成用于通知的数组，并清空记录 */
+	/** Flattens the recorded changes into the arrays that are broadcast and clears the recorder */
+	FRPGInventoryChangeSet Flush()
+	{
+		FRPGInventoryChangeSet ChangeSet;
+		ChangeSet.AddedItems = AddedItems.Array();
+		ChangeSet.RemovedItems = RemovedItems.Array();
+		ChangeSet.ChangedItems = ChangedItems.Array();
+		ChangeSet.ChangedSlots = ChangedSlots.Array();
+		Reset();
+		return ChangeSet;
+	}
+
+	/** Clears all recorded changes */
+	void Reset()
+	{
+		AddedItems.Reset();
+		RemovedItems.Reset();
+		ChangedItems.Reset();
+		ChangedSlots.Reset();
+	}
+
+private:
+	UPROPERTY()
+	TSet<URPGItem*> AddedItems;
+
+	UPROPERTY()
+	TSet<URPGItem*> RemovedItems;
+
+	UPROPERTY()
+	TSet<URPGItem*> ChangedItems;
+
+	UPROPERTY()
+	TSet<FRPGItemSlot> ChangedSlots;
+};
+
 /** 当一个背包中的道具改变时的代理 */
 /** Delegate called when an inventory item changes */
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnInventoryItemChanged, bool, bAdded, URPGItem*, Item);
@@ -154,6 +532,11 @@ DECLARE_MULTICAST_DELEGATE_TwoParams(FOnInventoryItemChangedNative, bool, URPGIt
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnSlottedItemChanged, FRPGItemSlot, ItemSlot, URPGItem*, Item);
 DECLARE_MULTICAST_DELEGATE_TwoParams(FOnSlottedItemChangedNative, FRPGItemSlot, URPGItem*);
 
+/** 当一组背包改变被提交时的代理 */
+/** Delegate called once with the aggregated changes of an inventory transaction */
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnInventoryChangeSet, const FRPGInventoryChangeSet&, ChangeSet);
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnInventoryChangeSetNative, const FRPGInventoryChangeSet&);
+
 /** 当整个背包被加载时的代理 */
 /** Delegate called when the entire inventory has been loaded, all items may have been replaced */
 DECLARE_DYNAMIC_MULTICAST_DELEGATE(FOnInventoryLoaded);
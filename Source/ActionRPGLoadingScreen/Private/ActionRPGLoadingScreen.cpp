@@ -5,6 +5,8 @@
 #include "SlateExtras.h"
 #include "MoviePlayer.h"
 #include "Widgets/Images/SThrobber.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "ProfilingDebugging/MiscTrace.h"
 
 // This module must be loaded "PreLoadingScreen" in the .uproject file, otherwise it will not hook in time!
 struct FRPGLoadingScreenBrush : public FSlateDynamicImageBrush, public FGCObject
@@ -96,6 +98,10 @@ class FActionRPGLoadingScreenModule : public IActionRPGLoadingScreenModule
 public:
 	virtual void StartupModule() override
 	{
+		TRACE_CPUPROFILER_EVENT_SCOPE(RPGStartup_LoadingScreenModule);
+		TRACE_BOOKMARK(TEXT("RPGStartup LoadingScreenModule begin"));
+		StartupStartTime = FPlatformTime::Seconds();
+
 		// Force load for cooker reference
 		LoadObject<UObject>(nullptr, TEXT("/Game/UI/T_ActionRPG_TransparentLogo.T_ActionRPG_TransparentLogo") );
 
@@ -103,6 +109,9 @@ public:
 		{
 			CreateScreen();
 		}
+
+		StartupEndTime = FPlatformTime::Seconds();
+		TRACE_BOOKMARK(TEXT("RPGStartup LoadingScreenModule end"));
 	}
 	
 	virtual bool IsGameModule() const override
@@ -126,6 +135,12 @@ public:
 		GetMoviePlayer()->StopMovie();
 	}
 
+	virtual void GetStartupTiming(double& OutStartTime, double& OutEndTime) const override
+	{
+		OutStartTime = StartupStartTime;
+		OutEndTime = StartupEndTime;
+	}
+
 	virtual void CreateScreen()
 	{
 		FLoadingScreenAttributes LoadingScreen;
@@ -135,6 +150,10 @@ public:
 		GetMoviePlayer()->SetupLoadingScreen(LoadingScreen);
 	}
 
+private:
+	/** When StartupModule began and ended */
+	double StartupStartTime = 0.0;
+	double StartupEndTime = 0.0;
 };
 
 IMPLEMENT_GAME_MODULE(FActionRPGLoadingScreenModule, ActionRPGLoadingScreen);
@@ -24,4 +24,8 @@ public:
 
 	/** Stops the loading screen */
 	virtual void StopInGameLoadingScreen() = 0;
+
+	/** 返回 StartupModule 开始和结束的时间，用于启动时间的统计 */
+	/** Returns when StartupModule began and ended, in FPlatformTime::Seconds(), for the startup profiler */
+	virtual void GetStartupTiming(double& OutStartTime, double& OutEndTime) const = 0;
 };